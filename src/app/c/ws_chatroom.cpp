@@ -30,7 +30,6 @@
 #include "seasocks/StringUtil.h"
 
 #include <memory>
-#include <set>
 #include <string>
 
 // Simple chatroom server, showing how one might use authentication.
@@ -40,25 +39,18 @@ using namespace seasocks;
 namespace {
 
 struct Handler : WebSocket::Handler {
-    std::set<WebSocket*> _cons;
-
     void onConnect(WebSocket* con) override {
-        _cons.insert(con);
-        send(con->credentials()->username + " has joined");
+        // Publishing to a topic encodes each message once for everyone in the room.
+        con->server().subscribe(con, "chat");
+        con->server().publish("chat", con->credentials()->username + " has joined");
     }
     void onDisconnect(WebSocket* con) override {
-        _cons.erase(con);
-        send(con->credentials()->username + " has left");
+        con->server().unsubscribe(con, "chat");
+        con->server().publish("chat", con->credentials()->username + " has left");
     }
 
     void onData(WebSocket* con, const char* data) override {
-        send(con->credentials()->username + ": " + data);
-    }
-
-    void send(const std::string& msg) {
-        for (auto* con : _cons) {
-            con->send(msg);
-        }
+        con->server().publish("chat", con->credentials()->username + ": " + data);
     }
 };
 
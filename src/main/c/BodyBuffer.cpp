@@ -0,0 +1,118 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/BodyBuffer.h"
+
+#include "internal/FileMapping.h"
+
+#include <fcntl.h>
+#include <linux/memfd.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+
+namespace seasocks {
+
+namespace {
+
+int createSpillFile() {
+    const char* directory = getenv("TMPDIR");
+    if (directory == nullptr || *directory == 0) {
+        directory = "/tmp";
+    }
+    auto fd = ::open(directory, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        // Not every filesystem supports O_TMPFILE.
+        fd = static_cast<int>(::syscall(SYS_memfd_create, "seasocks-request-body", MFD_CLOEXEC));
+    }
+    return fd;
+}
+
+}
+
+BodyBuffer::BodyBuffer(size_t spillThreshold)
+        : _spillThreshold(spillThreshold) {
+}
+
+BodyBuffer::~BodyBuffer() {
+    if (_fd != -1) {
+        ::close(_fd);
+    }
+}
+
+bool BodyBuffer::append(const uint8_t* data, size_t size) {
+    _size += size;
+    if (spilled()) {
+        return writeToFile(data, size);
+    }
+    _memory.insert(_memory.end(), data, data + size);
+    if (_spillThreshold != 0 && _size > _spillThreshold) {
+        return spill();
+    }
+    return true;
+}
+
+bool BodyBuffer::spill() {
+    _fd = createSpillFile();
+    if (_fd == -1) {
+        return false;
+    }
+    if (!writeToFile(_memory.data(), _memory.size())) {
+        return false;
+    }
+    std::vector<uint8_t>().swap(_memory);
+    return true;
+}
+
+bool BodyBuffer::writeToFile(const uint8_t* data, size_t size) {
+    while (size > 0) {
+        auto written = ::write(_fd, data, size);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+bool BodyBuffer::finish(const uint8_t*& data, std::shared_ptr<const void>& owner) {
+    if (!spilled()) {
+        auto memory = std::make_shared<std::vector<uint8_t>>(std::move(_memory));
+        data = memory->data();
+        owner = std::move(memory);
+        return true;
+    }
+    owner = mapFile(_fd, _size);
+    data = static_cast<const uint8_t*>(owner.get());
+    return owner != nullptr;
+}
+
+}
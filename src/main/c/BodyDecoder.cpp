@@ -0,0 +1,122 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/BodyDecoder.h"
+
+#include "internal/ByteScan.h"
+
+#include <string>
+
+namespace seasocks {
+
+constexpr size_t BodyDecoder::MaxLineSize;
+
+namespace {
+
+int hexDigit(uint8_t c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+}
+
+size_t BodyDecoder::lineLength(const InputBuffer& input) {
+    auto first = input.data();
+    auto last = first + std::min(input.size(), MaxLineSize + 2);
+    auto lineEnd = findCrLf(first, last);
+    if (lineEnd == last) {
+        if (input.size() >= MaxLineSize + 2) {
+            _state = State::Malformed;
+        }
+        return std::string::npos;
+    }
+    return lineEnd - first;
+}
+
+bool BodyDecoder::readFraming(InputBuffer& input) {
+    switch (_framing) {
+        case Framing::ChunkEnd:
+            if (input.size() < 2) {
+                return false;
+            }
+            if (input[0] != '\r' || input[1] != '\n') {
+                _state = State::Malformed;
+                return false;
+            }
+            input.consume(2);
+            _framing = Framing::ChunkSize;
+            return true;
+        case Framing::ChunkSize: {
+            auto length = lineLength(input);
+            if (length == std::string::npos) {
+                return false;
+            }
+            size_t chunkSize = 0;
+            size_t digits = 0;
+            for (; digits < length && hexDigit(input[digits]) >= 0; ++digits) {
+                if (chunkSize > (_limit - _bodySize) / 16) {
+                    _state = State::TooLarge;
+                    return false;
+                }
+                chunkSize = chunkSize * 16 + hexDigit(input[digits]);
+            }
+            // Anything after the size must be a chunk extension, which we ignore.
+            if (digits == 0 || (digits < length && input[digits] != ';' && input[digits] != ' ' && input[digits] != '\t')) {
+                _state = State::Malformed;
+                return false;
+            }
+            if (chunkSize > _limit - _bodySize) {
+                _state = State::TooLarge;
+                return false;
+            }
+            input.consume(length + 2);
+            _remaining = chunkSize;
+            _framing = chunkSize == 0 ? Framing::Trailers : Framing::ChunkEnd;
+            return true;
+        }
+        case Framing::Trailers: {
+            auto length = lineLength(input);
+            if (length == std::string::npos) {
+                return false;
+            }
+            input.consume(length + 2);
+            if (length == 0) {
+                _state = State::Done;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+}
@@ -0,0 +1,119 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/ByteScan.h"
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+namespace seasocks {
+
+namespace {
+
+const uint8_t* findByteScalar(const uint8_t* first, const uint8_t* last, uint8_t byte) {
+    while (first < last && *first != byte) {
+        ++first;
+    }
+    return first;
+}
+
+#ifdef __SSE2__
+
+const uint8_t* findByteSse2(const uint8_t* first, const uint8_t* last, uint8_t byte) {
+    const auto needle = _mm_set1_epi8(static_cast<char>(byte));
+    while (last - first >= 16) {
+        auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+        auto matches = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        if (matches != 0) {
+            return first + __builtin_ctz(static_cast<unsigned>(matches));
+        }
+        first += 16;
+    }
+    return findByteScalar(first, last, byte);
+}
+
+__attribute__((target("avx2")))
+const uint8_t* findByteAvx2(const uint8_t* first, const uint8_t* last, uint8_t byte) {
+    const auto needle = _mm256_set1_epi8(static_cast<char>(byte));
+    while (last - first >= 32) {
+        auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+        auto matches = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+        if (matches != 0) {
+            return first + __builtin_ctz(static_cast<unsigned>(matches));
+        }
+        first += 32;
+    }
+    return findByteSse2(first, last, byte);
+}
+
+using FindByte = const uint8_t* (*) (const uint8_t*, const uint8_t*, uint8_t);
+
+FindByte chooseFindByte() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? findByteAvx2 : findByteSse2;
+}
+
+const FindByte findByteImpl = chooseFindByte();
+
+#else
+
+const auto findByteImpl = findByteScalar;
+
+#endif
+
+// Finds the start of the first run of 'length' alternating \r and \n characters.
+const uint8_t* findCrLfs(const uint8_t* first, const uint8_t* last, int length) {
+    while (true) {
+        auto cr = findByteImpl(first, last, '\r');
+        if (last - cr < length) {
+            return last;
+        }
+        int matched = 1;
+        while (matched < length && cr[matched] == (matched % 2 ? '\n' : '\r')) {
+            ++matched;
+        }
+        if (matched == length) {
+            return cr;
+        }
+        first = cr + 1;
+    }
+}
+
+}
+
+const uint8_t* findByte(const uint8_t* first, const uint8_t* last, uint8_t byte) {
+    return findByteImpl(first, last, byte);
+}
+
+const uint8_t* findCrLf(const uint8_t* first, const uint8_t* last) {
+    return findCrLfs(first, last, 2);
+}
+
+const uint8_t* findCrLfCrLf(const uint8_t* first, const uint8_t* last) {
+    return findCrLfs(first, last, 4);
+}
+
+}
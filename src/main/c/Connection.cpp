@@ -24,13 +24,25 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include "internal/Config.h"
+#include "internal/BodyBuffer.h"
+#include "internal/BodyDecoder.h"
 #include "internal/Embedded.h"
-#include "internal/HeaderMap.h"
+#include "internal/HeaderStore.h"
+#include "internal/HybiFrame.h"
+#include "internal/ByteScan.h"
 #include "internal/HybiAccept.h"
 #include "internal/HybiPacketDecoder.h"
 #include "internal/LogStream.h"
+#include "internal/InputBuffer.h"
+#include "internal/OutputChain.h"
+#include "internal/OffloadedResponse.h"
 #include "internal/PageRequest.h"
 #include "internal/RaiiFd.h"
+#include "internal/SendQueue.h"
+#include "internal/Unmask.h"
+#include "internal/Utf8.h"
+#include "internal/WorkerPool.h"
+#include "internal/ZeroCopySends.h"
 
 #include "md5/md5.h"
 
@@ -44,6 +56,9 @@
 #include "seasocks/ResponseWriter.h"
 #include "seasocks/ZlibContext.h"
 
+#include <netinet/in.h>
+
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -59,6 +74,7 @@
 #include <memory>
 #include <sstream>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <unistd.h>
 #include <byteswap.h>
@@ -67,7 +83,7 @@
 
 namespace {
 
-uint32_t parseWebSocketKey(const std::string& key) {
+uint32_t parseWebSocketKey(std::string_view key) {
     uint32_t keyNumber = 0;
     uint32_t numSpaces = 0;
     for (auto c : key) {
@@ -81,18 +97,20 @@ uint32_t parseWebSocketKey(const std::string& key) {
 }
 
 char* extractLine(uint8_t*& first, uint8_t* last, char** colon = nullptr) {
-    for (uint8_t* ptr = first; ptr < last - 1; ++ptr) {
-        if (ptr[0] == '\r' && ptr[1] == '\n') {
-            ptr[0] = 0;
-            uint8_t* result = first;
-            first = ptr + 2;
-            return reinterpret_cast<char*>(result);
-        }
-        if (colon && ptr[0] == ':' && *colon == nullptr) {
-            *colon = reinterpret_cast<char*>(ptr);
+    uint8_t* end = first + (seasocks::findCrLf(first, last) - first);
+    if (end == last) {
+        return nullptr;
+    }
+    if (colon && *colon == nullptr) {
+        auto colonPos = first + (seasocks::findByte(first, end, ':') - first);
+        if (colonPos != end) {
+            *colon = reinterpret_cast<char*>(colonPos);
         }
     }
-    return nullptr;
+    *end = 0;
+    uint8_t* result = first;
+    first = end + 2;
+    return reinterpret_cast<char*>(result);
 }
 
 const std::unordered_map<std::string, std::string> contentTypes = {
@@ -151,8 +169,29 @@ bool isCacheable(const std::string& path) {
 }
 
 constexpr size_t ReadWriteBufferSize = 16 * 1024;
-constexpr size_t MaxWebsocketMessageSize = 16384;
+// Reads sized from the previous burst are capped at this size.
+constexpr size_t MaxReadSize = 1024 * 1024;
+// Most read from an edge-triggered socket before letting other connections have a
+// turn; the rest is read on the loop's next pass.
+constexpr size_t MaxReadPerWakeup = 1024 * 1024;
+// Most input left unconsumed while answering a request before we stop reading.
+constexpr size_t MaxUnconsumedInput = 1024 * 1024;
 constexpr size_t MaxHeadersSize = 64 * 1024;
+// Most pieces of output handed to the kernel in one call.
+constexpr int MaxIovecs = 64;
+// Most of a file handed to sendfile() in one call, well inside what it'll take.
+constexpr size_t MaxSendfileSize = 1024 * 1024 * 1024;
+// How much of each range of a static file is read in before it's sent. The
+// kernel's read-ahead is left to keep up with the rest.
+constexpr size_t StaticFileReadAhead = 1024 * 1024;
+// Messages queued by Senders that are sent per drain, before letting other work run.
+constexpr size_t SendBatchSize = 256;
+// Marks a batched message that's still where it was received.
+constexpr size_t NotCopied = std::numeric_limits<size_t>::max();
+// WebSocket close statuses (RFC 6455 section 7.4.1).
+constexpr uint16_t CloseProtocolError = 1002;
+constexpr uint16_t CloseInvalidPayload = 1007;
+constexpr uint16_t CloseMessageTooBig = 1009;
 
 class PrefixWrapper : public seasocks::Logger {
     std::string _prefix;
@@ -168,8 +207,8 @@ public:
     }
 };
 
-bool hasConnectionType(const std::string& connection, const std::string& type) {
-    for (auto conType : seasocks::split(connection, ',')) {
+bool hasConnectionType(std::string_view connection, const std::string& type) {
+    for (auto conType : seasocks::split(std::string(connection), ',')) {
         while (!conType.empty() && isspace(conType[0]))
             conType = conType.substr(1);
         if (seasocks::caseInsensitiveSame(conType, type))
@@ -182,7 +221,138 @@ bool hasConnectionType(const std::string& connection, const std::string& type) {
 
 namespace seasocks {
 
-struct Connection::Writer : ResponseWriter {
+namespace {
+
+// A request's first line, or why it can't be handled.
+struct RequestLine {
+    const char* verbText = nullptr;
+    Request::Verb verb = Request::Verb::Invalid;
+    const char* requestUri = nullptr;
+    const char* httpVersion = nullptr;
+    ResponseCode errorCode = ResponseCode::Ok;
+    const char* error = nullptr;
+};
+
+// Parses the request line and headers in place in 'headers', add()ing each
+// header. Logs them unless 'logger' is null.
+RequestLine parseRequest(Logger* logger, HeaderStore& headers) {
+    RequestLine result;
+    auto fail = [&result](ResponseCode errorCode, const char* error) {
+        result.errorCode = errorCode;
+        result.error = error;
+        return result;
+    };
+    uint8_t* first = headers.begin();
+    uint8_t* last = headers.end();
+    char* requestLine = extractLine(first, last);
+    assert(requestLine != nullptr);
+
+    if (logger) {
+        LS_ACCESS(logger, "Request: " << requestLine);
+    }
+
+    result.verbText = shift(requestLine);
+    if (!result.verbText) {
+        return fail(ResponseCode::BadRequest, "Malformed request line");
+    }
+    result.verb = Request::verb(result.verbText);
+    if (result.verb == Request::Verb::Invalid) {
+        return fail(ResponseCode::BadRequest, "Malformed request line");
+    }
+    result.requestUri = shift(requestLine);
+    if (result.requestUri == nullptr) {
+        return fail(ResponseCode::BadRequest, "Malformed request line");
+    }
+
+    result.httpVersion = shift(requestLine);
+    if (result.httpVersion == nullptr) {
+        return fail(ResponseCode::BadRequest, "Malformed request line");
+    }
+    if (strcmp(result.httpVersion, "HTTP/1.1") != 0) {
+        return fail(ResponseCode::NotImplemented, "Unsupported HTTP version");
+    }
+    if (*requestLine != 0) {
+        return fail(ResponseCode::BadRequest, "Trailing crap after http version");
+    }
+
+    while (first < last) {
+        char* colonPos = nullptr;
+        char* headerLine = extractLine(first, last, &colonPos);
+        assert(headerLine != nullptr);
+        if (colonPos == nullptr) {
+            return fail(ResponseCode::BadRequest, "Malformed header");
+        }
+        *colonPos = 0;
+        std::string_view key(headerLine, colonPos - headerLine);
+        std::string_view value(skipWhitespace(colonPos + 1));
+        if (logger) {
+            LS_DEBUG(logger, "Key: " << key << " || " << value);
+        }
+        headers.add(key, value);
+    }
+    return result;
+}
+
+bool isWebSocketUpgrade(const HeaderStore& headers) {
+    return headers.has(KnownHeader::Connection) && headers.has(KnownHeader::Upgrade)
+           && hasConnectionType(headers.get(KnownHeader::Connection), "Upgrade")
+           && caseInsensitiveSame(std::string(headers.get(KnownHeader::Upgrade)), "websocket");
+}
+
+// Composes a frame's payload straight onto the end of a connection's output,
+// after space for its header, checking text is UTF-8 as it goes if asked to.
+class OutputComposer : public WebSocket::Composer {
+public:
+    OutputComposer(OutputChain& output, size_t sizeHint, bool checkUtf8)
+            : _output(output),
+              _header(output.reserveHeader(HybiFrameHeader::MaxSize)),
+              _payloadStart(output.size()),
+              _checkUtf8(checkUtf8) {
+        makeRoom(std::min(std::max<size_t>(sizeHint, 1), MaxReserve));
+    }
+
+    // Takes the rest of the payload, returning its size.
+    size_t finish() {
+        take();
+        _next = _end = nullptr;
+        return _output.size() - _payloadStart;
+    }
+    void setHeader(const HybiFrameHeader& header) {
+        _output.setHeader(_header, HybiFrameHeader::MaxSize, header.bytes, header.size);
+    }
+    bool validUtf8() const {
+        return !_checkUtf8 || _utf8.complete();
+    }
+
+private:
+    void more(size_t size) override {
+        take();
+        makeRoom(size);
+    }
+    void take() {
+        auto written = static_cast<size_t>(_next - _reserved);
+        if (_checkUtf8) {
+            _utf8.feed(_reserved, written);
+        }
+        _output.commit(written);
+    }
+    void makeRoom(size_t size) {
+        size_t room;
+        _reserved = _next = _output.reserve(size, room);
+        _end = _next + room;
+    }
+
+    OutputChain& _output;
+    size_t _header;
+    size_t _payloadStart;
+    bool _checkUtf8;
+    Utf8Validator _utf8;
+    uint8_t* _reserved = nullptr;
+};
+
+}
+
+struct Connection::Writer : HandlerChainWriter {
     Connection* _connection;
     explicit Writer(Connection& connection)
             : _connection(&connection) {
@@ -204,6 +374,10 @@ struct Connection::Writer : ResponseWriter {
         if (_connection)
             _connection->payload(data, size, flush);
     }
+    void payloadFile(int fd, uint64_t offset, size_t length, bool flush) override {
+        if (_connection)
+            _connection->payloadFile(fd, offset, length, flush);
+    }
     void finish(bool keepConnectionOpen) override {
         if (_connection)
             _connection->finish(keepConnectionOpen);
@@ -216,6 +390,11 @@ struct Connection::Writer : ResponseWriter {
     bool isActive() const override {
         return _connection;
     }
+
+    void continueHandling(size_t nextHandler) override {
+        if (_connection)
+            _connection->continuePageRequest(nextHandler);
+    }
 };
 
 Connection::Connection(
@@ -223,23 +402,44 @@ Connection::Connection(
     ServerImpl& server,
     int fd,
     const sockaddr_in& address)
-        : _logger(std::make_shared<PrefixWrapper>(formatAddress(address) + " : ", logger)),
+        : _serverLogger(std::move(logger)),
           _server(server),
           _fd(fd),
           _shutdown(false),
           _hadSendError(false),
           _closeOnEmpty(false),
           _registeredForWriteEvents(false),
+          _corks(server.autoCork()),
+          _flushDeferred(false),
+          _readPaused(false),
+          _zeroCopyThreshold(server.zeroCopyThreshold()),
           _address(address),
           _bytesSent(0),
+          _sendCalls(0),
           _bytesReceived(0),
+          _lastBurstSize(0),
+          _input(std::make_unique<InputBuffer>()),
+          _tableSlot(std::numeric_limits<uint32_t>::max()),
+          _headerScanOffset(0),
+          _pipelineStalled(false),
+          _handlingInput(false),
+          _moreInput(false),
+          _output(std::make_unique<OutputChain>()),
           _shutdownByUser(false),
           _transferEncoding(TransferEncoding::Raw),
           _chunk(0u),
-          _writer(std::make_shared<Writer>(*this)),
+          _utf8(std::make_unique<Utf8Validator>()),
           _state(State::READING_HEADERS) {
 }
 
+Logger* Connection::logger() const {
+    // Most connections never log, so only pay for formatting the address if we do.
+    if (!_logger) {
+        _logger = std::make_unique<PrefixWrapper>(formatAddress(_address) + " : ", _serverLogger);
+    }
+    return _logger.get();
+}
+
 Connection::~Connection() {
     _server.checkThread();
     finalise();
@@ -252,7 +452,7 @@ void Connection::close() {
 }
 
 void Connection::closeWhenEmpty() {
-    if (_outBuf.empty()) {
+    if (_output->empty()) {
         closeInternal();
     } else {
         _closeOnEmpty = true;
@@ -264,27 +464,63 @@ void Connection::closeInternal() {
     // leaving the close of the FD and the cleanup until the destructor runs.
     _server.checkThread();
     if (_fd != -1 && !_shutdown && ::shutdown(_fd, SHUT_RDWR) == -1) {
-        LS_WARNING(_logger, "Unable to shutdown socket : " << getLastError());
+        LS_WARNING(logger(), "Unable to shutdown socket : " << getLastError());
     }
     _shutdown = true;
 }
 
 
+int Connection::releaseFd(std::unique_ptr<ZeroCopySends>& zeroCopySends) {
+    _webSocketHandler.reset();
+    zeroCopySends = std::move(_zeroCopySends);
+    auto fd = _fd;
+    _fd = -1;
+    return fd;
+}
+
+void Connection::replayInput(std::vector<uint8_t>&& input, std::unique_ptr<ZeroCopySends> zeroCopySends) {
+    _zeroCopySends = std::move(zeroCopySends);
+    _bytesReceived += input.size();
+    _input->assign(input.data(), input.data() + input.size());
+    _headerScanOffset = 0;
+    handleNewData();
+}
+
 void Connection::finalise() {
     if (_response) {
         _response->cancel();
         _response.reset();
+    }
+    if (_writer) {
         _writer->detach();
         _writer.reset();
     }
+    if (_sendQueue) {
+        _sendQueue->detach();
+        _sendQueue.reset();
+    }
+    if (_flushDeferred) {
+        _server.cancelDeferredFlush(this);
+        _flushDeferred = false;
+    }
+    _server.cancelDeferredRead(this);
     if (_webSocketHandler) {
         _webSocketHandler->onDisconnect(this);
         _webSocketHandler.reset();
     }
     if (_fd != -1) {
         _server.remove(this);
-        LS_DEBUG(_logger, "Closing socket");
-        ::close(_fd);
+        if (_zeroCopySends) {
+            _zeroCopySends->reap(_fd);
+        }
+        if (_zeroCopySends && !_zeroCopySends->empty()) {
+            // The kernel may still be sending from buffers only we keep alive.
+            LS_DEBUG(logger(), "Leaving socket to finish its zero-copy sends");
+            _server.lingerZeroCopy(_fd, std::move(_zeroCopySends));
+        } else {
+            LS_DEBUG(logger(), "Closing socket");
+            ::close(_fd);
+        }
     }
     _fd = -1;
 }
@@ -300,21 +536,100 @@ ssize_t Connection::safeSend(const void* data, size_t size) {
             // Treat this as if zero bytes were written.
             return 0;
         }
-        LS_WARNING(_logger, "Unable to write to socket : " << getLastError() << " - disabling further writes");
+        LS_WARNING(logger(), "Unable to write to socket : " << getLastError() << " - disabling further writes");
+        closeInternal();
+    } else {
+        _bytesSent += sendResult;
+        ++_sendCalls;
+    }
+    return sendResult;
+}
+
+ssize_t Connection::safeSendv(const iovec* iov, int count, bool moreToCome) {
+    if (_fd == -1 || _hadSendError || _shutdown) {
+        return -1;
+    }
+    msghdr message{};
+    message.msg_iov = const_cast<iovec*>(iov);
+    message.msg_iovlen = count;
+    auto sendResult = ::sendmsg(_fd, &message, MSG_NOSIGNAL | (moreToCome ? MSG_MORE : 0));
+    if (sendResult == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        }
+        LS_WARNING(logger(), "Unable to write to socket : " << getLastError() << " - disabling further writes");
         closeInternal();
     } else {
         _bytesSent += sendResult;
+        ++_sendCalls;
     }
     return sendResult;
 }
 
+ssize_t Connection::sendZeroCopy(const iovec& iov, std::shared_ptr<const void> owner, bool moreToCome) {
+    if (_fd == -1 || _hadSendError || _shutdown) {
+        return -1;
+    }
+    msghdr message{};
+    message.msg_iov = const_cast<iovec*>(&iov);
+    message.msg_iovlen = 1;
+    auto sendResult = ::sendmsg(_fd, &message, MSG_NOSIGNAL | MSG_ZEROCOPY | (moreToCome ? MSG_MORE : 0));
+    if (sendResult == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        }
+        if (errno == ENOBUFS) {
+            // Too many sends are waiting to complete, so copy this one.
+            return safeSendv(&iov, 1, moreToCome);
+        }
+        LS_WARNING(logger(), "Unable to write to socket : " << getLastError() << " - disabling further writes");
+        closeInternal();
+        return -1;
+    }
+    _zeroCopySends->sent(std::move(owner));
+    _bytesSent += sendResult;
+    ++_sendCalls;
+    return sendResult;
+}
+
+bool Connection::enableZeroCopy() {
+    if (_zeroCopySends) {
+        return true;
+    }
+    int one = 1;
+    if (::setsockopt(_fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == -1) {
+        LS_DEBUG(logger(), "Unable to enable zero-copy sends: " << getLastError());
+        _zeroCopyThreshold = 0;
+        return false;
+    }
+    _zeroCopySends = std::make_unique<ZeroCopySends>();
+    return true;
+}
+
+bool Connection::handleErrorQueue() {
+    if (!_zeroCopySends || _fd == -1) {
+        return false;
+    }
+    if (_zeroCopySends->reap(_fd) && _zeroCopyThreshold) {
+        LS_DEBUG(logger(), "Kernel copied zero-copy sends; no longer using them");
+        _zeroCopyThreshold = 0;
+    }
+    int error = 0;
+    socklen_t length = sizeof(error);
+    return ::getsockopt(_fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0;
+}
+
 bool Connection::write(const void* data, size_t size, bool flushIt) {
     if (closed() || _closeOnEmpty) {
         return false;
     }
+    if (_composing) {
+        LS_ERROR(logger(), "Can't write to a connection while composing a message on it");
+        return false;
+    }
     if (size) {
         ssize_t bytesSent = 0;
-        if (_outBuf.empty() && flushIt) {
+        if (_output->empty() && flushIt && !_corks) {
             // Attempt fast path, send directly.
             bytesSent = safeSend(data, size);
             if (bytesSent == static_cast<int>(size)) {
@@ -326,16 +641,10 @@ bool Connection::write(const void* data, size_t size, bool flushIt) {
             }
         }
         size_t bytesToBuffer = size - bytesSent;
-        size_t endOfBuffer = _outBuf.size();
-        size_t newBufferSize = endOfBuffer + bytesToBuffer;
-        if (newBufferSize >= _server.clientBufferSize()) {
-            LS_WARNING(_logger, "Closing connection: buffer size too large ("
-                                    << newBufferSize << " >= " << _server.clientBufferSize() << ")");
-            closeInternal();
+        if (!roomToBuffer(bytesToBuffer)) {
             return false;
         }
-        _outBuf.resize(newBufferSize);
-        memcpy(&_outBuf[endOfBuffer], reinterpret_cast<const uint8_t*>(data) + bytesSent, bytesToBuffer);
+        _output->append(reinterpret_cast<const uint8_t*>(data) + bytesSent, bytesToBuffer);
     }
     if (flushIt) {
         return flush();
@@ -343,6 +652,77 @@ bool Connection::write(const void* data, size_t size, bool flushIt) {
     return true;
 }
 
+bool Connection::writeBorrowed(const void* data, size_t size, std::shared_ptr<const void> owner) {
+    if (closed() || _closeOnEmpty) {
+        return false;
+    }
+    if (_composing) {
+        LS_ERROR(logger(), "Can't write to a connection while composing a message on it");
+        return false;
+    }
+    if (!roomToBuffer(size)) {
+        return false;
+    }
+    _output->appendBorrowed(data, size, std::move(owner));
+    return flush();
+}
+
+bool Connection::roomToBuffer(size_t size) {
+    auto newBufferSize = _output->memoryBytes() + size;
+    if (newBufferSize >= _server.clientBufferSize()) {
+        LS_WARNING(logger(), "Closing connection: buffer size too large ("
+                                 << newBufferSize << " >= " << _server.clientBufferSize() << ")");
+        closeInternal();
+        return false;
+    }
+    return true;
+}
+
+bool Connection::writeFile(int fd, uint64_t offset, size_t size, std::shared_ptr<const void> owner, bool flushIt) {
+    if (closed() || _closeOnEmpty) {
+        return false;
+    }
+    if (_composing) {
+        LS_ERROR(logger(), "Can't write to a connection while composing a message on it");
+        return false;
+    }
+    _output->appendFile(fd, offset, size, std::move(owner));
+    return !flushIt || flush();
+}
+
+ssize_t Connection::safeSendfile(int fd, uint64_t offset, size_t size) {
+    if (_fd == -1 || _hadSendError || _shutdown) {
+        return -1;
+    }
+    auto position = static_cast<off_t>(offset);
+    auto sendResult = ::sendfile(_fd, fd, &position, size);
+    if (sendResult == -1 && (errno == EINVAL || errno == ENOSYS)) {
+        // Not something sendfile() can read from: copy a piece of it instead.
+        uint8_t buffer[ReadWriteBufferSize];
+        auto bytesRead = ::pread(fd, buffer, std::min(size, sizeof(buffer)), position);
+        if (bytesRead > 0) {
+            return safeSend(buffer, bytesRead);
+        }
+        sendResult = bytesRead;
+    }
+    if (sendResult == 0) {
+        LS_ERROR(logger(), "Unexpected EOF sending file");
+        closeInternal();
+        return -1;
+    }
+    if (sendResult == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        }
+        LS_WARNING(logger(), "Unable to send file : " << getLastError() << " - disabling further writes");
+        closeInternal();
+        return -1;
+    }
+    _bytesSent += sendResult;
+    ++_sendCalls;
+    return sendResult;
+}
+
 bool Connection::bufferLine(const char* line) {
     static const char crlf[] = {'\r', '\n'};
     if (!write(line, strlen(line), false))
@@ -356,55 +736,167 @@ bool Connection::bufferLine(const std::string& line) {
 }
 
 void Connection::handleDataReadyForRead() {
-    if (closed()) {
+    if (closed() || _readPaused) {
         return;
     }
-    size_t curSize = _inBuf.size();
-    _inBuf.resize(curSize + ReadWriteBufferSize);
-    auto result = ::read(_fd, &_inBuf[curSize], ReadWriteBufferSize);
-    if (result == -1) {
-        LS_WARNING(_logger, "Unable to read from socket : " << getLastError());
+    if (_server.edgeTriggered()) {
+        drainSocket();
         return;
     }
+    auto result = readSome(ReadWriteBufferSize);
     if (result == 0) {
-        LS_DEBUG(_logger, "Remote end closed connection");
+        LS_DEBUG(logger(), "Remote end closed connection");
         closeInternal();
         return;
     }
+    if (result > 0) {
+        handleNewData();
+    }
+}
+
+// Reads up to size bytes onto the end of the input buffer. Returns the number of
+// bytes read, 0 at end of file, or -1 if nothing could be read.
+ssize_t Connection::readSome(size_t size) {
+    auto result = ::read(_fd, _input->prepare(size), size);
+    if (result == -1) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            LS_WARNING(logger(), "Unable to read from socket : " << getLastError());
+        }
+        return -1;
+    }
     _bytesReceived += result;
-    _inBuf.resize(curSize + result);
-    handleNewData();
+    _input->commit(result);
+    return result;
+}
+
+void Connection::drainSocket() {
+    // We won't be told about this data again, so read until the socket would block,
+    // starting with a read the size of the last burst and doubling while reads fill up.
+    // So one busy client can't hold up the rest, stop at a budget, and carry on next pass.
+    auto readSize = std::min(std::max(_lastBurstSize, ReadWriteBufferSize), MaxReadSize);
+    size_t burstSize = 0;
+    bool drained = false;
+    bool remoteClosed = false;
+    while (burstSize < MaxReadPerWakeup) {
+        auto result = readSome(std::min(readSize, MaxReadPerWakeup - burstSize));
+        if (result <= 0) {
+            drained = true;
+            remoteClosed = result == 0;
+            break;
+        }
+        burstSize += result;
+        if (static_cast<size_t>(result) == readSize) {
+            readSize = std::min(readSize * 2, MaxReadSize);
+        }
+    }
+    _lastBurstSize = burstSize;
+    if (!drained) {
+        _server.deferRead(this);
+    }
+    if (burstSize) {
+        handleNewData();
+    }
+    if (remoteClosed && !closed()) {
+        LS_DEBUG(logger(), "Remote end closed connection");
+        closeInternal();
+    }
 }
 
 void Connection::handleDataReadyForWrite() {
     if (closed()) {
         return;
     }
-    flush();
+    flushNow(false);
+}
+
+void Connection::flushDeferred() {
+    _flushDeferred = false;
+    flushNow(false);
 }
 
 bool Connection::flush() {
-    if (_outBuf.empty()) {
-        return true;
+    if (_corks && !_output->empty()) {
+        if (!_flushDeferred) {
+            _flushDeferred = true;
+            _server.deferFlush(this);
+        }
+        return _output->size() < Server::AutoCorkFlushBytes || flushNow(true);
     }
-    auto numSent = safeSend(&_outBuf[0], _outBuf.size());
-    if (numSent == -1) {
-        return false;
+    return flushNow(false);
+}
+
+bool Connection::flushNow(bool moreToCome) {
+    if (_output->empty()) {
+        return true;
     }
-    _outBuf.erase(_outBuf.begin(), _outBuf.begin() + numSent);
-    if (!_outBuf.empty() && !_registeredForWriteEvents) {
-        if (!_server.subscribeToWriteEvents(this)) {
+    // Send until the socket is full, a batch of segments at a time.
+    while (!_output->empty()) {
+        int file;
+        uint64_t fileOffset;
+        if (auto fileBytes = _output->file(0, file, fileOffset)) {
+            auto toSend = std::min(fileBytes, MaxSendfileSize);
+            auto numSent = safeSendfile(file, fileOffset, toSend);
+            if (numSent == -1) {
+                return false;
+            }
+            _output->consume(numSent);
+            if (static_cast<size_t>(numSent) < toSend) {
+                break;
+            }
+            continue;
+        }
+        iovec iov[MaxIovecs];
+        auto count = _output->gather(iov, MaxIovecs);
+        // Big enough borrowed segments are sent on their own without being copied.
+        std::shared_ptr<const void> zeroCopyOwner;
+        bool zeroCopy = false;
+        for (int i = 0; _zeroCopyThreshold && i < count; ++i) {
+            if (iov[i].iov_len >= _zeroCopyThreshold && _output->borrowed(i, zeroCopyOwner)) {
+                if (i > 0) {
+                    count = i;
+                } else if (enableZeroCopy()) {
+                    zeroCopy = true;
+                    count = 1;
+                }
+                break;
+            }
+        }
+        size_t gathered = 0;
+        for (int i = 0; i < count; ++i) {
+            gathered += iov[i].iov_len;
+        }
+        if (moreToCome && gathered == _output->size()) {
+            // The deferred flush sends the last segment without MSG_MORE, pushing
+            // out anything the kernel's holding back.
+            gathered -= iov[--count].iov_len;
+            if (!count) {
+                break;
+            }
+        }
+        // Whatever precedes part of a file is sent along with its start.
+        auto more = moreToCome || (gathered < _output->size() && _output->file(count, file, fileOffset));
+        auto numSent = zeroCopy ? sendZeroCopy(iov[0], std::move(zeroCopyOwner), more)
+                                : safeSendv(iov, count, more);
+        if (numSent == -1) {
             return false;
         }
-        _registeredForWriteEvents = true;
-    } else if (_outBuf.empty() && _registeredForWriteEvents) {
-        if (!_server.unsubscribeFromWriteEvents(this)) {
+        _output->consume(numSent);
+        if (static_cast<size_t>(numSent) < gathered) {
+            break;
+        }
+    }
+    if (moreToCome) {
+        // The deferred flush sorts out write events.
+        return true;
+    }
+    if (_output->empty() == _registeredForWriteEvents) {
+        if (!_server.setInterest(this, !_readPaused, !_output->empty())) {
             return false;
         }
-        _registeredForWriteEvents = false;
+        _registeredForWriteEvents = !_output->empty();
     }
-    if (_outBuf.empty() && !closed() && _closeOnEmpty) {
-        LS_DEBUG(_logger, "Ready for close, now empty");
+    if (_output->empty() && !closed() && _closeOnEmpty) {
+        LS_DEBUG(logger(), "Ready for close, now empty");
         closeInternal();
     }
     return true;
@@ -415,9 +907,52 @@ bool Connection::closed() const {
 }
 
 void Connection::handleNewData() {
+    if (_handlingInput) {
+        // Called back from further down the stack: let the outer call go round again.
+        _moreInput = true;
+        return;
+    }
+    _handlingInput = true;
+    do {
+        _moreInput = false;
+        processInput();
+    } while (_moreInput && !closed());
+    _handlingInput = false;
+    updateReadInterest();
+}
+
+void Connection::updateReadInterest() {
+    if (closed()) {
+        return;
+    }
+    bool answering = _state == State::AWAITING_RESPONSE_BEGIN
+                     || _state == State::SENDING_RESPONSE_HEADERS
+                     || _state == State::SENDING_RESPONSE_BODY;
+    bool pause = answering && (_pipelineStalled || _input->size() >= MaxUnconsumedInput);
+    if (pause == _readPaused) {
+        return;
+    }
+    _readPaused = pause;
+    if (!_server.setInterest(this, !_readPaused, _registeredForWriteEvents)) {
+        closeInternal();
+        return;
+    }
+    if (!_readPaused && _server.edgeTriggered()) {
+        // What arrived while paused won't be signalled again.
+        _server.deferRead(this);
+    }
+}
+
+void Connection::processInput() {
     switch (_state) {
         case State::READING_HEADERS:
-            handleHeaders();
+            if (_closeOnEmpty) {
+                // Nothing more will be answered.
+            } else if (!_pipeline.empty()) {
+                handlePipelinedRequest();
+            } else {
+                handleHeaders();
+            }
             break;
         case State::READING_WEBSOCKET_KEY3:
             handleWebSocketKey3();
@@ -434,6 +969,7 @@ void Connection::handleNewData() {
         case State::AWAITING_RESPONSE_BEGIN:
         case State::SENDING_RESPONSE_BODY:
         case State::SENDING_RESPONSE_HEADERS:
+            pipelineRequests();
             break;
         default:
             assert(false);
@@ -441,32 +977,88 @@ void Connection::handleNewData() {
     }
 }
 
+size_t Connection::findEndOfHeaders() {
+    auto& input = *_input;
+    // Carry on from where the last scan stopped, backing up in case the
+    // terminator straddles the old and new data.
+    auto scanFrom = _headerScanOffset > 3 ? _headerScanOffset - 3 : 0;
+    auto endOfInput = input.data() + input.size();
+    auto terminator = findCrLfCrLf(input.data() + scanFrom, endOfInput);
+    _headerScanOffset = terminator - input.data();
+    return terminator == endOfInput ? std::string::npos : _headerScanOffset;
+}
+
 void Connection::handleHeaders() {
-    if (_inBuf.size() < 4) {
+    auto headersSize = findEndOfHeaders();
+    if (headersSize == std::string::npos) {
+        if (_input->size() > MaxHeadersSize) {
+            sendUnsupportedError("Headers too big");
+        }
         return;
     }
-    for (size_t i = 0; i <= _inBuf.size() - 4; ++i) {
-        if (_inBuf[i] == '\r' &&
-            _inBuf[i + 1] == '\n' &&
-            _inBuf[i + 2] == '\r' &&
-            _inBuf[i + 3] == '\n') {
-            if (!processHeaders(&_inBuf[0], &_inBuf[i + 2])) {
-                closeInternal();
-                return;
-            }
-            _inBuf.erase(_inBuf.begin(), _inBuf.begin() + i + 4);
-            handleNewData();
+    // The request keeps its own copy of the headers, so they're finished with
+    // here before handling it (which might go on to read the next request).
+    HeaderStore headers(_input->data(), _input->data() + headersSize + 2);
+    _input->consume(headersSize + 4);
+    _headerScanOffset = 0;
+    if (!processHeaders(std::move(headers))) {
+        closeInternal();
+        return;
+    }
+    if (closed()) {
+        return;
+    }
+    handleNewData();
+}
+
+void Connection::pipelineRequests() {
+    _pipelineStalled = false;
+    if (_closeOnEmpty) {
+        return;
+    }
+    while (_pipeline.size() < _server.pipelineDepth()) {
+        auto headersSize = findEndOfHeaders();
+        if (headersSize == std::string::npos) {
+            // Rejected when it's this one's turn; until then, there's no point reading more.
+            _pipelineStalled = _input->size() > MaxHeadersSize;
+            return;
+        }
+        HeaderStore headers(_input->data(), _input->data() + headersSize + 2);
+        // Parsed quietly, as this may well happen again before it's complete.
+        auto line = parseRequest(nullptr, headers);
+        // Anything but a plain request is left until it's this one's turn, to be
+        // rejected or upgraded then.
+        if (line.error || isWebSocketUpgrade(headers)) {
+            return;
+        }
+        auto request = std::make_shared<PageRequest>(_address, line.requestUri, _server.server(),
+                                                     line.verb, std::move(headers));
+        // As are those with bodies, which are read as they're answered.
+        if (request->contentLength() > 0 || request->hasHeader(KnownHeader::TransferEncoding)) {
             return;
         }
+        LS_ACCESS(logger(), "Pipelined request: " << line.verbText << " " << line.requestUri << " " << line.httpVersion);
+        _input->consume(headersSize + 4);
+        _headerScanOffset = 0;
+        _pipeline.push_back(std::move(request));
     }
-    if (_inBuf.size() > MaxHeadersSize) {
-        sendUnsupportedError("Headers too big");
+    // Full: leave anything more in the socket until there's room for it.
+    _pipelineStalled = !_input->empty();
+}
+
+void Connection::handlePipelinedRequest() {
+    _request = std::move(_pipeline.front());
+    _pipeline.pop_front();
+    if (!dispatchRequest()) {
+        closeInternal();
+        return;
     }
+    handleNewData();
 }
 
 void Connection::handleWebSocketKey3() {
     constexpr auto WebSocketKeyLen = 8u;
-    if (_inBuf.size() < WebSocketKeyLen) {
+    if (_input->size() < WebSocketKeyLen) {
         return;
     }
 
@@ -476,14 +1068,14 @@ void Connection::handleWebSocketKey3() {
         char key3[WebSocketKeyLen];
     } md5Source;
 
-    auto key1 = parseWebSocketKey(_request->getHeader("Sec-WebSocket-Key1"));
-    auto key2 = parseWebSocketKey(_request->getHeader("Sec-WebSocket-Key2"));
+    auto key1 = parseWebSocketKey(_request->getHeader(KnownHeader::SecWebSocketKey1));
+    auto key2 = parseWebSocketKey(_request->getHeader(KnownHeader::SecWebSocketKey2));
 
-    LS_DEBUG(_logger, "Got a hixie websocket with key1=0x" << std::hex << key1 << ", key2=0x" << key2);
+    LS_DEBUG(logger(), "Got a hixie websocket with key1=0x" << std::hex << key1 << ", key2=0x" << key2);
 
     md5Source.key1 = htonl(key1);
     md5Source.key2 = htonl(key2);
-    memcpy(&md5Source.key3, &_inBuf[0], WebSocketKeyLen);
+    memcpy(&md5Source.key3, _input->data(), WebSocketKeyLen);
 
     uint8_t digest[16];
     md5_state_t md5state;
@@ -491,17 +1083,17 @@ void Connection::handleWebSocketKey3() {
     md5_append(&md5state, reinterpret_cast<const uint8_t*>(&md5Source), sizeof(md5Source));
     md5_finish(&md5state, digest);
 
-    LS_DEBUG(_logger, "Attempting websocket upgrade");
+    LS_DEBUG(logger(), "Attempting websocket upgrade");
 
     bufferResponseAndCommonHeaders(ResponseCode::WebSocketProtocolHandshake);
     bufferLine("Upgrade: websocket");
     bufferLine("Connection: Upgrade");
     bool allowCrossOrigin = _server.isCrossOriginAllowed(_request->getRequestUri());
-    if (_request->hasHeader("Origin") && allowCrossOrigin) {
-        bufferLine("Sec-WebSocket-Origin: " + _request->getHeader("Origin"));
+    if (_request->hasHeader(KnownHeader::Origin) && allowCrossOrigin) {
+        bufferLine("Sec-WebSocket-Origin: " + std::string(_request->getHeader(KnownHeader::Origin)));
     }
-    if (_request->hasHeader("Host")) {
-        auto host = _request->getHeader("Host");
+    if (_request->hasHeader(KnownHeader::Host)) {
+        auto host = std::string(_request->getHeader(KnownHeader::Host));
         if (!allowCrossOrigin) {
             bufferLine("Sec-WebSocket-Origin: http://" + host);
         }
@@ -513,7 +1105,7 @@ void Connection::handleWebSocketKey3() {
     write(&digest, 16, true);
 
     _state = State::HANDLING_HIXIE_WEBSOCKET;
-    _inBuf.erase(_inBuf.begin(), _inBuf.begin() + 8);
+    _input->consume(WebSocketKeyLen);
     if (_webSocketHandler) {
         _webSocketHandler->onConnect(this);
     }
@@ -521,109 +1113,276 @@ void Connection::handleWebSocketKey3() {
 
 void Connection::pickProtocol() {
     static std::string protocolHeader = "Sec-WebSocket-Protocol";
-    if (!_request->hasHeader(protocolHeader) || !_webSocketHandler)
+    if (!_request->hasHeader(KnownHeader::SecWebSocketProtocol) || !_webSocketHandler)
         return;
     // Ideally we need o support this header being set multiple times...but the headers don't support that.
-    auto protocols = split(_request->getHeader(protocolHeader), ',');
-    LS_DEBUG(_logger, "Requested protocols:");
+    auto protocols = split(std::string(_request->getHeader(KnownHeader::SecWebSocketProtocol)), ',');
+    LS_DEBUG(logger(), "Requested protocols:");
     std::transform(protocols.begin(), protocols.end(), protocols.begin(), trimWhitespace);
     for (auto&& p : protocols) {
-        LS_DEBUG(_logger, "  " + p);
+        LS_DEBUG(logger(), "  " + p);
     }
     auto choice = _webSocketHandler->chooseProtocol(protocols);
     if (choice >= 0 && choice < static_cast<ssize_t>(protocols.size())) {
-        LS_DEBUG(_logger, "Chose protocol " + protocols[choice]);
+        LS_DEBUG(logger(), "Chose protocol " + protocols[choice]);
         bufferLine(protocolHeader + ": " + protocols[choice]);
     }
 }
 
 void Connection::handleBufferingPostData() {
-    if (_request->consumeContent(_inBuf)) {
-        _state = State::READING_HEADERS;
-        if (!handlePageRequest()) {
-            closeInternal();
+    auto state = BodyDecoder::State::Reading;
+    std::string error;
+    try {
+        state = _bodyDecoder->decode(*_input, [this](const uint8_t* data, size_t size) {
+            if (_bodyHandler) {
+                _bodyHandler->onBodyChunk(data, size);
+                return true;
+            }
+            return _bodyBuffer->append(data, size);
+        });
+    } catch (const std::exception& e) {
+        error = e.what();
+    } catch (...) {
+        error = "(unknown)";
+    }
+    if (state == BodyDecoder::State::Reading && error.empty()) {
+        return;
+    }
+    // Whatever happens next, this request's body is done with.
+    _state = State::READING_HEADERS;
+    bool ok;
+    if (!error.empty()) {
+        LS_ERROR(logger(), "body handler error: " << error);
+        ok = sendISE(error);
+    } else if (state == BodyDecoder::State::Malformed) {
+        ok = sendBadRequest("Malformed chunked encoding");
+    } else if (state == BodyDecoder::State::TooLarge) {
+        ok = sendError(ResponseCode::PayloadTooLarge, "Request body too long");
+    } else if (state == BodyDecoder::State::Rejected) {
+        LS_ERROR(logger(), "Unable to store request body: " << getLastError());
+        ok = sendISE("Unable to store request body");
+    } else {
+        ok = finishRequestBody();
+    }
+    _bodyDecoder.reset();
+    _bodyHandler.reset();
+    _bodyBuffer.reset();
+    if (!ok) {
+        closeInternal();
+        return;
+    }
+    handleNewData();
+}
+
+bool Connection::finishRequestBody() {
+    if (_bodyHandler) {
+        std::shared_ptr<Response> response;
+        try {
+            response = _bodyHandler->onBodyEnd();
+        } catch (const std::exception& e) {
+            LS_ERROR(logger(), "body handler error: " << e.what());
+            return sendISE(e.what());
+        } catch (...) {
+            LS_ERROR(logger(), "body handler error: (unknown)");
+            return sendISE("(unknown)");
         }
+        return sendResponse(response ? response : Response::unhandled());
+    }
+    const uint8_t* content;
+    std::shared_ptr<const void> owner;
+    if (!_bodyBuffer->finish(content, owner)) {
+        LS_ERROR(logger(), "Unable to map request body: " << getLastError());
+        return sendISE("Unable to read request body");
     }
+    _request->setContent(content, _bodyBuffer->size(), std::move(owner));
+    return dispatchRequest();
 }
 
 void Connection::send(const char* webSocketResponse) {
     _server.checkThread();
     if (_shutdown) {
         if (_shutdownByUser) {
-            LS_ERROR(_logger, "Server wrote to connection after closing it");
+            LS_ERROR(logger(), "Server wrote to connection after closing it");
         }
         return;
     }
-    auto messageLength = strlen(webSocketResponse);
+    sendText(webSocketResponse, strlen(webSocketResponse), true);
+}
+
+void Connection::compose(Opcode opcode, size_t sizeHint, const std::function<void(Composer&)>& write) {
+    _server.checkThread();
+    if (_shutdown) {
+        if (_shutdownByUser) {
+            LS_ERROR(logger(), "Server wrote to connection after closing it");
+        }
+        return;
+    }
+    if (_state != State::HANDLING_HYBI_WEBSOCKET || _perMessageDeflate) {
+        // Frames that must be encoded as a whole are put together first.
+        WebSocket::compose(opcode, sizeHint, write);
+        return;
+    }
+    if (closed() || _closeOnEmpty) {
+        return;
+    }
+    if (_composing) {
+        LS_ERROR(logger(), "Can't compose a message while composing another");
+        return;
+    }
+    auto messageStart = _output->size();
+    OutputComposer composer(*_output, sizeHint, opcode == Opcode::Text && validatesSentUtf8());
+    _composing = true;
+    try {
+        write(composer);
+    } catch (...) {
+        _composing = false;
+        _output->truncate(messageStart);
+        throw;
+    }
+    _composing = false;
+    auto payloadSize = composer.finish();
+    if (!composer.validUtf8()) {
+        LS_ERROR(logger(), "Not sending text message that isn't valid UTF-8");
+        _output->truncate(messageStart);
+        return;
+    }
+    composer.setHeader(HybiFrameHeader(0x80 | static_cast<uint8_t>(opcode), payloadSize));
+    if (!roomToBuffer(0)) {
+        _output->truncate(messageStart);
+        return;
+    }
+    flush();
+}
+
+void Connection::sendText(const char* webSocketResponse, size_t messageLength, bool flush) {
+    if (validatesSentUtf8() && !isValidUtf8(reinterpret_cast<const uint8_t*>(webSocketResponse), messageLength)) {
+        LS_ERROR(logger(), "Not sending text message that isn't valid UTF-8");
+        return;
+    }
     if (_state == State::HANDLING_HIXIE_WEBSOCKET) {
-        uint8_t zero = 0;
-        if (!write(&zero, 1, false))
-            return;
-        if (!write(webSocketResponse, messageLength, false))
-            return;
-        uint8_t effeff = 0xff;
-        write(&effeff, 1, true);
+        sendHixieText(webSocketResponse, messageLength, flush);
         return;
     }
     sendHybi(static_cast<uint8_t>(HybiPacketDecoder::Opcode::Text),
-             reinterpret_cast<const uint8_t*>(webSocketResponse), messageLength);
+             reinterpret_cast<const uint8_t*>(webSocketResponse), messageLength, flush);
+}
+
+void Connection::sendHixieText(const char* text, size_t length, bool flush) {
+    uint8_t zero = 0;
+    if (!write(&zero, 1, false))
+        return;
+    if (!write(text, length, false))
+        return;
+    uint8_t effeff = 0xff;
+    write(&effeff, 1, flush);
 }
 
 void Connection::send(const uint8_t* webSocketResponse, size_t length) {
     _server.checkThread();
     if (_shutdown) {
         if (_shutdownByUser) {
-            LS_ERROR(_logger, "Client wrote to connection after closing it");
+            LS_ERROR(logger(), "Client wrote to connection after closing it");
+        }
+        return;
+    }
+    if (_state == State::HANDLING_HIXIE_WEBSOCKET) {
+        LS_ERROR(logger(), "Hixie does not support binary");
+        return;
+    }
+    sendHybi(static_cast<uint8_t>(HybiPacketDecoder::Opcode::Binary), webSocketResponse, length);
+}
+
+void Connection::sendHybi(uint8_t opcode, const uint8_t* webSocketResponse, size_t messageLength, bool flush) {
+    uint8_t firstByte = 0x80 | opcode;
+    if (_perMessageDeflate) {
+        firstByte |= 0x40;
+        _deflated.clear();
+
+        zlibContext.deflate(webSocketResponse, messageLength, _deflated);
+
+        LS_DEBUG(logger(), "Compression result: " << messageLength << " bytes -> " << _deflated.size() << " bytes");
+        sendHybiData(firstByte, _deflated.data(), _deflated.size(), flush);
+    } else {
+        sendHybiData(firstByte, webSocketResponse, messageLength, flush);
+    }
+}
+
+void Connection::sendHybiData(uint8_t firstByte, const uint8_t* webSocketResponse, size_t messageLength, bool flush) {
+    HybiFrameHeader header(firstByte, messageLength);
+    if (!write(header.bytes, header.size, false))
+        return;
+    write(webSocketResponse, messageLength, flush);
+}
+
+void Connection::sendShared(const std::shared_ptr<const SharedFrame>& frame) {
+    if (_shutdown || closed() || _closeOnEmpty) {
+        return;
+    }
+    if (_composing) {
+        LS_ERROR(logger(), "Can't write to a connection while composing a message on it");
+        return;
+    }
+    if (_state == State::HANDLING_HIXIE_WEBSOCKET) {
+        if (frame->opcode == static_cast<uint8_t>(HybiPacketDecoder::Opcode::Text)) {
+            // Unchecked, as it is for Hybi subscribers.
+            sendHixieText(reinterpret_cast<const char*>(frame->payload()), frame->payloadSize(), true);
+        } else {
+            LS_ERROR(logger(), "Hixie does not support binary");
+        }
+        return;
+    }
+    if (_state != State::HANDLING_HYBI_WEBSOCKET) {
+        return;
+    }
+    if (_perMessageDeflate) {
+        // Compressed frames depend on this connection's deflate state.
+        sendHybi(frame->opcode, frame->payload(), frame->payloadSize());
+        return;
+    }
+    size_t sent = 0;
+    // Frames big enough to go zero-copy are queued, so flushNow() can send them that way.
+    auto zeroCopy = _zeroCopyThreshold && frame->bytes.size() >= _zeroCopyThreshold;
+    if (_output->empty() && !_corks && !zeroCopy) {
+        auto result = safeSend(frame->bytes.data(), frame->bytes.size());
+        if (result == -1 || static_cast<size_t>(result) == frame->bytes.size()) {
+            return;
         }
-        return;
+        sent = result;
     }
-    if (_state == State::HANDLING_HIXIE_WEBSOCKET) {
-        LS_ERROR(_logger, "Hixie does not support binary");
+    auto remaining = frame->bytes.size() - sent;
+    if (!roomToBuffer(remaining)) {
         return;
     }
-    sendHybi(static_cast<uint8_t>(HybiPacketDecoder::Opcode::Binary), webSocketResponse, length);
+    _output->appendBorrowed(frame->bytes.data() + sent, remaining, frame);
+    flush();
 }
 
-void Connection::sendHybi(uint8_t opcode, const uint8_t* webSocketResponse, size_t messageLength) {
-    uint8_t firstByte = 0x80 | opcode;
-    if (_perMessageDeflate)
-        firstByte |= 0x40;
-    if (!write(&firstByte, 1, false))
-        return;
-
-    if (_perMessageDeflate) {
-        std::vector<uint8_t> compressed;
-
-        zlibContext.deflate(webSocketResponse, messageLength, compressed);
-
-        LS_DEBUG(_logger, "Compression result: " << messageLength << " bytes -> " << compressed.size() << " bytes");
-        sendHybiData(compressed.data(), compressed.size());
-    } else {
-        sendHybiData(webSocketResponse, messageLength);
+WebSocket::Sender Connection::sender() {
+    _server.checkThread();
+    if (!_sendQueue) {
+        _sendQueue = std::make_shared<SendQueue>(_server, *this);
     }
+    return Sender(_sendQueue);
 }
 
-void Connection::sendHybiData(const uint8_t* webSocketResponse, size_t messageLength) {
-    if (messageLength < 126) {
-        uint8_t nextByte = messageLength; // No MASK bit set.
-        if (!write(&nextByte, 1, false))
-            return;
-    } else if (messageLength < 65536) {
-        uint8_t nextByte = 126; // No MASK bit set.
-        if (!write(&nextByte, 1, false))
-            return;
-        auto lengthBytes = htons(messageLength);
-        if (!write(&lengthBytes, 2, false))
-            return;
-    } else {
-        uint8_t nextByte = 127; // No MASK bit set.
-        if (!write(&nextByte, 1, false))
-            return;
-        uint64_t lengthBytes = __bswap_64(messageLength);
-        if (!write(&lengthBytes, 8, false))
+void Connection::drainSendQueue() {
+    // Everything in the batch goes out with a single flush.
+    _sendQueue->consume(SendBatchSize, [this](SendQueue::Message& message) {
+        if (_shutdown || (_state != State::HANDLING_HYBI_WEBSOCKET && _state != State::HANDLING_HIXIE_WEBSOCKET)) {
             return;
+        }
+        if (!message.isBinary) {
+            sendText(message.text.data(), message.text.size(), false);
+        } else if (_state == State::HANDLING_HYBI_WEBSOCKET) {
+            sendHybi(static_cast<uint8_t>(HybiPacketDecoder::Opcode::Binary),
+                     message.binary.data(), message.binary.size(), false);
+        } else {
+            LS_ERROR(logger(), "Hixie does not support binary");
+        }
+    });
+    if (!closed()) {
+        flush();
     }
-    write(webSocketResponse, messageLength, true);
 }
 
 std::shared_ptr<Credentials> Connection::credentials() const {
@@ -632,132 +1391,351 @@ std::shared_ptr<Credentials> Connection::credentials() const {
 }
 
 void Connection::handleHixieWebSocket() {
-    if (_inBuf.empty()) {
+    auto& input = *_input;
+    if (input.empty()) {
         return;
     }
     size_t messageStart = 0;
-    while (messageStart < _inBuf.size()) {
-        if (_inBuf[messageStart] != 0) {
-            LS_WARNING(_logger, "Error in WebSocket input stream (got " << (int) _inBuf[messageStart] << ")");
+    while (messageStart < input.size()) {
+        if (input[messageStart] != 0) {
+            LS_WARNING(logger(), "Error in WebSocket input stream (got " << (int) input[messageStart] << ")");
+            deliverMessageBatch();
             closeInternal();
             return;
         }
-        // TODO: UTF-8
         size_t endOfMessage = 0;
-        for (size_t i = messageStart + 1; i < _inBuf.size(); ++i) {
-            if (_inBuf[i] == 0xff) {
+        for (size_t i = messageStart + 1; i < input.size(); ++i) {
+            if (input[i] == 0xff) {
                 endOfMessage = i;
                 break;
             }
         }
         if (endOfMessage != 0) {
-            _inBuf[endOfMessage] = 0;
-            handleWebSocketTextMessage(reinterpret_cast<const char*>(&_inBuf[messageStart + 1]));
+            input[endOfMessage] = 0;
+            std::string_view text(reinterpret_cast<const char*>(input.data() + messageStart + 1),
+                                  endOfMessage - messageStart - 1);
+            if (validatesUtf8() && !isValidUtf8(input.data() + messageStart + 1, text.size())) {
+                LS_WARNING(logger(), "Received invalid UTF-8 in a text message");
+                deliverMessageBatch();
+                closeInternal();
+                return;
+            }
+            if (_webSocketHandler && _webSocketHandler->batchesMessages()) {
+                // Already NUL terminated, over the end marker.
+                _batch.push_back({true, Span<const uint8_t>(input.data() + messageStart + 1, text.size())});
+                _batchCopies.push_back(NotCopied);
+            } else {
+                handleWebSocketTextMessage(text);
+            }
             messageStart = endOfMessage + 1;
         } else {
             break;
         }
     }
+    deliverMessageBatch();
     if (messageStart != 0) {
-        _inBuf.erase(_inBuf.begin(), _inBuf.begin() + messageStart);
+        input.consume(messageStart);
     }
-    if (_inBuf.size() > MaxWebsocketMessageSize) {
-        LS_WARNING(_logger, "WebSocket message too long");
+    if (input.size() > maxWebSocketMessageSize()) {
+        LS_WARNING(logger(), "WebSocket message too long");
         closeInternal();
     }
 }
 
 void Connection::handleHybiWebSocket() {
-    if (_inBuf.empty()) {
+    if (_input->empty()) {
         return;
     }
-    HybiPacketDecoder decoder(*_logger, _inBuf);
-    bool done = false;
-    while (!done) {
-        std::vector<uint8_t> decodedMessage;
-        bool deflateNeeded = false;
-
-        auto messageState = decoder.decodeNextMessage(decodedMessage, deflateNeeded);
-
-        if (deflateNeeded) {
-            if (!_perMessageDeflate) {
-                LS_WARNING(_logger, "Received deflated hybi frame but deflate wasn't negotiated");
-                closeInternal();
-                return;
-            }
-
-            size_t compressed_size = decodedMessage.size();
-
-            std::vector<uint8_t> decompressed;
-            int zlibError;
-
-            // Note: inflate() alters decodedMessage
-            bool success = zlibContext.inflate(decodedMessage, decompressed, zlibError);
+    if (_streamedFrameRemaining != 0) {
+        continueStreamedFrame();
+        if (_streamedFrameRemaining != 0 || _shutdown || _closeOnEmpty) {
+            return;
+        }
+    }
+    // Payloads are unmasked where they lie and handed over in place. Make sure
+    // there's a byte to spare after the input, so a text message at its very
+    // end can be NUL terminated too.
+    _input->prepare(1);
+    HybiPacketDecoder decoder(*logger(), _input->data(), _input->size());
+    auto streaming = _webSocketHandler && _webSocketHandler->streamsMessages();
+    while (!_shutdown && !_closeOnEmpty) {
+        HybiPacketDecoder::FrameHeader header;
+        auto messageState = decoder.peekNextFrame(header);
+        if (messageState == HybiPacketDecoder::MessageState::NoMessage) {
+            break;
+        }
+        if (messageState == HybiPacketDecoder::MessageState::Error) {
+            deliverMessageBatch();
+            closeWithStatus(CloseProtocolError);
+            return;
+        }
+        auto dataFrame = messageState == HybiPacketDecoder::MessageState::TextMessage
+                         || messageState == HybiPacketDecoder::MessageState::BinaryMessage
+                         || messageState == HybiPacketDecoder::MessageState::Continuation;
+        auto continuation = messageState == HybiPacketDecoder::MessageState::Continuation;
+        if (dataFrame && continuation != _inMessage) {
+            LS_WARNING(logger(), (continuation ? "Received hybi continuation frame outside a message"
+                                               : "Received new hybi message before the last one finished"));
+            deliverMessageBatch();
+            closeWithStatus(CloseProtocolError);
+            return;
+        }
+        if (header.compressed && (!dataFrame || continuation || !_perMessageDeflate)) {
+            LS_WARNING(logger(), "Received deflated hybi frame but deflate wasn't negotiated");
+            deliverMessageBatch();
+            closeWithStatus(CloseProtocolError);
+            return;
+        }
+        if (dataFrame && header.payloadLength > maxWebSocketMessageSize() - _messageSize) {
+            LS_WARNING(logger(), "WebSocket message too long");
+            deliverMessageBatch();
+            closeWithStatus(CloseMessageTooBig);
+            return;
+        }
 
-            if (!success) {
-                LS_WARNING(_logger, "Decompression error from zlib: " << zlibError);
-                closeInternal();
-                return;
+        auto available = _input->size() - decoder.numBytesDecoded() - header.headerSize;
+        auto streamed = dataFrame && streaming && !(continuation ? _messageCompressed : header.compressed);
+        if (header.payloadLength > available && !(streamed && available > 0)) {
+            break;
+        }
+        if (dataFrame && !continuation) {
+            _inMessage = true;
+            _messageIsText = messageState == HybiPacketDecoder::MessageState::TextMessage;
+            _messageCompressed = header.compressed;
+            // Compressed text is checked once it's inflated.
+            _checkingUtf8 = _messageIsText && !_messageCompressed && validatesUtf8();
+            if (_checkingUtf8) {
+                _utf8->reset();
             }
-
-            LS_DEBUG(_logger, "Decompression result: " << compressed_size << " bytes -> " << decodedMessage.size() << " bytes");
-
-            decodedMessage.swap(decompressed);
         }
-
+        auto payload = _input->data() + decoder.numBytesDecoded() + header.headerSize;
+        auto payloadLength = static_cast<size_t>(std::min<uint64_t>(header.payloadLength, available));
+        if (!dataFrame) {
+            unmask(payload, payload, payloadLength, header.mask);
+        } else if (!unmaskPayload(payload, payloadLength, header.mask, header.fin && payloadLength == header.payloadLength)) {
+            LS_WARNING(logger(), "Received invalid UTF-8 in a text message");
+            deliverMessageBatch();
+            closeWithStatus(CloseInvalidPayload);
+            return;
+        }
+        if (header.payloadLength > available) {
+            // Pass on what's arrived of the frame now, and the rest as it comes.
+            decoder.skip(header, available);
+            _messageSize += header.payloadLength;
+            _streamedFrameRemaining = header.payloadLength - available;
+            _streamedFrameMask = advanceMask(header.mask, available);
+            _streamedFrameFin = header.fin;
+            deliverFragment(payload, available, false);
+            break;
+        }
+        decoder.skip(header, payloadLength);
 
         switch (messageState) {
             default:
+                deliverMessageBatch();
                 closeInternal();
-                LS_WARNING(_logger, "Unknown HybiPacketDecoder state");
-                return;
-            case HybiPacketDecoder::MessageState::Error:
-                closeInternal();
+                LS_WARNING(logger(), "Unknown HybiPacketDecoder state");
                 return;
             case HybiPacketDecoder::MessageState::TextMessage:
-                decodedMessage.push_back(0); // avoids a copy
-                handleWebSocketTextMessage(reinterpret_cast<const char*>(&decodedMessage[0]));
-                break;
             case HybiPacketDecoder::MessageState::BinaryMessage:
-                handleWebSocketBinaryMessage(decodedMessage);
+            case HybiPacketDecoder::MessageState::Continuation:
+                _messageSize += payloadLength;
+                if (streamed) {
+                    deliverFragment(payload, payloadLength, header.fin);
+                } else if (header.fin && _fragments.empty()) {
+                    finishMessage(payload, payloadLength, true);
+                } else {
+                    _fragments.insert(_fragments.end(), payload, payload + payloadLength);
+                    if (header.fin) {
+                        _fragments.push_back(0);
+                        finishMessage(_fragments.data(), _fragments.size() - 1, false);
+                        _fragments.clear();
+                    }
+                }
                 break;
             case HybiPacketDecoder::MessageState::Ping:
-                sendHybi(static_cast<uint8_t>(HybiPacketDecoder::Opcode::Pong),
-                         &decodedMessage[0], decodedMessage.size());
+                // Control frames are never compressed.
+                sendHybiData(0x80 | static_cast<uint8_t>(HybiPacketDecoder::Opcode::Pong),
+                             payload, payloadLength, true);
                 break;
             case HybiPacketDecoder::MessageState::Pong:
                 // Pongs can be sent unsolicited (MSIE and Edge do this)
                 // The spec says to ignore them.
                 break;
-            case HybiPacketDecoder::MessageState::NoMessage:
-                done = true;
-                break;
             case HybiPacketDecoder::MessageState::Close:
-                LS_DEBUG(_logger, "Received WebSocket close");
+                LS_DEBUG(logger(), "Received WebSocket close");
+                deliverMessageBatch();
                 closeInternal();
                 return;
         }
     }
+    // Batched messages may point into the input, so go before it's consumed.
+    deliverMessageBatch();
     if (decoder.numBytesDecoded() != 0) {
-        _inBuf.erase(_inBuf.begin(), _inBuf.begin() + decoder.numBytesDecoded());
+        _input->consume(decoder.numBytesDecoded());
     }
-    if (_inBuf.size() > MaxWebsocketMessageSize) {
-        LS_WARNING(_logger, "WebSocket message too long");
-        closeInternal();
+}
+
+void Connection::continueStreamedFrame() {
+    auto length = static_cast<size_t>(std::min<uint64_t>(_streamedFrameRemaining, _input->size()));
+    auto piece = _input->data();
+    auto last = length == _streamedFrameRemaining && _streamedFrameFin;
+    if (!unmaskPayload(piece, length, _streamedFrameMask, last)) {
+        LS_WARNING(logger(), "Received invalid UTF-8 in a text message");
+        closeWithStatus(CloseInvalidPayload);
+        return;
+    }
+    _streamedFrameMask = advanceMask(_streamedFrameMask, length);
+    _streamedFrameRemaining -= length;
+    deliverFragment(piece, length, last);
+    _input->consume(length);
+}
+
+void Connection::deliverFragment(const uint8_t* data, size_t length, bool last) {
+    auto isText = _messageIsText;
+    if (last) {
+        _inMessage = false;
+        _messageSize = 0;
+    }
+    LS_DEBUG(logger(), "Got web socket message fragment (size: " << length << (last ? ", last)" : ")"));
+    if (_webSocketHandler) {
+        _webSocketHandler->onFragment(this, isText, data, length, last);
+    }
+}
+
+void Connection::finishMessage(uint8_t* message, size_t size, bool inInput) {
+    if (_messageCompressed) {
+        int zlibError;
+        _inflated.clear();
+        if (!zlibContext.inflate(message, size, _inflated, zlibError)) {
+            LS_WARNING(logger(), "Decompression error from zlib: " << zlibError);
+            deliverMessageBatch();
+            closeInternal();
+            return;
+        }
+
+        LS_DEBUG(logger(), "Decompression result: " << size << " bytes -> " << _inflated.size() << " bytes");
+
+        if (_inflated.size() > maxWebSocketMessageSize()) {
+            LS_WARNING(logger(), "WebSocket message too long once inflated");
+            deliverMessageBatch();
+            closeWithStatus(CloseMessageTooBig);
+            return;
+        }
+        if (_messageIsText && validatesUtf8() && !isValidUtf8(_inflated.data(), _inflated.size())) {
+            LS_WARNING(logger(), "Received invalid UTF-8 in a text message");
+            deliverMessageBatch();
+            closeWithStatus(CloseInvalidPayload);
+            return;
+        }
+        size = _inflated.size();
+        _inflated.push_back(0);
+        message = _inflated.data();
+        inInput = false;
+    }
+    if (_webSocketHandler && _webSocketHandler->streamsMessages()) {
+        deliverFragment(message, size, true);
+        return;
+    }
+    _inMessage = false;
+    _messageSize = 0;
+    if (_webSocketHandler && _webSocketHandler->batchesMessages()) {
+        batchMessage(_messageIsText, message, size, inInput);
+    } else if (_messageIsText) {
+        // Terminate the text where it lies, putting back whatever follows it afterwards.
+        auto following = message[size];
+        message[size] = 0;
+        handleWebSocketTextMessage(std::string_view(reinterpret_cast<const char*>(message), size));
+        message[size] = following;
+    } else {
+        handleWebSocketBinaryMessage(Span<const uint8_t>(message, size));
+    }
+}
+
+void Connection::batchMessage(bool isText, uint8_t* message, size_t size, bool inInput) {
+    if (inInput) {
+        _batch.push_back({isText, Span<const uint8_t>(message, size)});
+        _batchCopies.push_back(NotCopied);
+        return;
+    }
+    // The message is in scratch space the next one may reuse, so keep a copy
+    // (NUL terminated, like everything else handed over), to be found once
+    // the copies stop moving.
+    _batch.push_back({isText, Span<const uint8_t>(nullptr, size)});
+    _batchCopies.push_back(_batchStorage.size());
+    _batchStorage.insert(_batchStorage.end(), message, message + size);
+    _batchStorage.push_back(0);
+}
+
+void Connection::deliverMessageBatch() {
+    if (_batch.empty()) {
+        return;
+    }
+    // Text in the input is only NUL terminated now the frames following it
+    // have all been decoded; what was there is put back afterwards.
+    _batchFollowing.clear();
+    for (size_t i = 0; i < _batch.size(); ++i) {
+        auto& message = _batch[i];
+        if (_batchCopies[i] != NotCopied) {
+            message.data = Span<const uint8_t>(_batchStorage.data() + _batchCopies[i], message.data.size());
+        } else if (message.isText) {
+            auto end = const_cast<uint8_t*>(message.data.end());
+            _batchFollowing.push_back(*end);
+            *end = 0;
+        }
+    }
+    LS_DEBUG(logger(), "Got batch of " << _batch.size() << " web socket messages");
+    if (_webSocketHandler) {
+        _webSocketHandler->onDataBatch(this, Span<const MessageView>(_batch.data(), _batch.size()));
+    }
+    auto following = _batchFollowing.begin();
+    for (size_t i = 0; i < _batch.size(); ++i) {
+        if (_batchCopies[i] == NotCopied && _batch[i].isText) {
+            *const_cast<uint8_t*>(_batch[i].data.end()) = *following++;
+        }
+    }
+    _batch.clear();
+    _batchCopies.clear();
+    _batchStorage.clear();
+}
+
+bool Connection::unmaskPayload(uint8_t* payload, size_t size, uint32_t mask, bool last) {
+    if (!_checkingUtf8) {
+        unmask(payload, payload, size, mask);
+        return true;
     }
+    return unmaskUtf8(payload, payload, size, mask, *_utf8) && (!last || _utf8->complete());
+}
+
+bool Connection::validatesUtf8() const {
+    return _webSocketHandler && _webSocketHandler->validatesUtf8();
+}
+
+bool Connection::validatesSentUtf8() const {
+    return _webSocketHandler && _webSocketHandler->validatesSentUtf8();
+}
+
+size_t Connection::maxWebSocketMessageSize() const {
+    return _webSocketHandler ? _webSocketHandler->maxMessageSize() : WebSocket::DefaultMaxMessageSize;
+}
+
+void Connection::closeWithStatus(uint16_t status) {
+    uint8_t payload[2] = {static_cast<uint8_t>(status >> 8), static_cast<uint8_t>(status)};
+    sendHybiData(0x80 | static_cast<uint8_t>(HybiPacketDecoder::Opcode::Close), payload, sizeof(payload), true);
+    closeWhenEmpty();
 }
 
-void Connection::handleWebSocketTextMessage(const char* message) {
-    LS_DEBUG(_logger, "Got text web socket message: '" << message << "'");
+void Connection::handleWebSocketTextMessage(std::string_view message) {
+    LS_DEBUG(logger(), "Got text web socket message: '" << message << "'");
     if (_webSocketHandler) {
         _webSocketHandler->onData(this, message);
     }
 }
 
-void Connection::handleWebSocketBinaryMessage(const std::vector<uint8_t>& message) {
-    LS_DEBUG(_logger, "Got binary web socket message (size: " << message.size() << ")");
+void Connection::handleWebSocketBinaryMessage(Span<const uint8_t> message) {
+    LS_DEBUG(logger(), "Got binary web socket message (size: " << message.size() << ")");
     if (_webSocketHandler) {
-        _webSocketHandler->onData(this, &message[0], message.size());
+        _webSocketHandler->onData(this, message);
     }
 }
 
@@ -800,7 +1778,7 @@ bool Connection::send404() {
     auto path = getRequestUri();
     auto embedded = findEmbeddedContent(path);
     if (embedded) {
-        return sendData(getContentType(path), embedded->data, embedded->length);
+        return sendData(getContentType(path), embedded->data, embedded->length, true);
     } else if (strcmp(path.c_str(), "/_livestats.js") == 0) {
         auto stats = _server.getStatsDocument();
         return sendData("text/javascript", stats.c_str(), stats.length());
@@ -817,101 +1795,128 @@ bool Connection::sendISE(const std::string& error) {
     return sendError(ResponseCode::InternalServerError, error);
 }
 
-bool Connection::processHeaders(uint8_t* first, uint8_t* last) {
-    // Ideally we'd copy off [first, last] now into a header structure here.
-    // Be careful about lifetimes though and multiple requests coming in, should
-    // we ever support HTTP pipelining and/or long-lived requests.
-    char* requestLine = extractLine(first, last);
-    assert(requestLine != nullptr);
-
-    LS_ACCESS(_logger, "Request: " << requestLine);
-
-    const char* verbText = shift(requestLine);
-    if (!verbText) {
-        return sendBadRequest("Malformed request line");
-    }
-    auto verb = Request::verb(verbText);
-    if (verb == Request::Verb::Invalid) {
-        return sendBadRequest("Malformed request line");
-    }
-    const char* requestUri = shift(requestLine);
-    if (requestUri == nullptr) {
-        return sendBadRequest("Malformed request line");
-    }
-
-    const char* httpVersion = shift(requestLine);
-    if (httpVersion == nullptr) {
-        return sendBadRequest("Malformed request line");
-    }
-    if (strcmp(httpVersion, "HTTP/1.1") != 0) {
-        return sendUnsupportedError("Unsupported HTTP version");
-    }
-    if (*requestLine != 0) {
-        return sendBadRequest("Trailing crap after http version");
-    }
-
-    HeaderMap headers(31);
-    while (first < last) {
-        char* colonPos = nullptr;
-        char* headerLine = extractLine(first, last, &colonPos);
-        assert(headerLine != nullptr);
-        if (colonPos == nullptr) {
-            return sendBadRequest("Malformed header");
-        }
-        *colonPos = 0;
-        const char* key = headerLine;
-        const char* value = skipWhitespace(colonPos + 1);
-        LS_DEBUG(_logger, "Key: " << key << " || " << value);
-        headers.emplace(key, value);
+bool Connection::processHeaders(HeaderStore&& headers) {
+    // Keep the start of the remaining input, in case we need to hand it to another reactor.
+    const uint8_t* afterHeaders = _input->data();
+    auto line = parseRequest(logger(), headers);
+    if (line.error) {
+        return sendError(line.errorCode, line.error);
     }
+    auto verb = line.verb;
+    auto requestUri = line.requestUri;
 
-    if (headers.count("Connection") && headers.count("Upgrade") && hasConnectionType(headers["Connection"], "Upgrade") && caseInsensitiveSame(headers["Upgrade"], "websocket")) {
-        LS_INFO(_logger, "Websocket request for " << requestUri << "'");
+    if (isWebSocketUpgrade(headers)) {
+        LS_INFO(logger(), "Websocket request for " << requestUri << "'");
         if (verb != Request::Verb::Get) {
             return sendBadRequest("Non-GET WebSocket request");
         }
         _webSocketHandler = _server.getWebSocketHandler(requestUri);
         if (!_webSocketHandler) {
-            LS_WARNING(_logger, "Couldn't find WebSocket end point for '" << requestUri << "'");
+            LS_WARNING(logger(), "Couldn't find WebSocket end point for '" << requestUri << "'");
             return send404();
         }
+        _corks = _corks && _webSocketHandler->corksWrites();
+        if (!_server.runsOnThisReactor(*_webSocketHandler)) {
+            // Rebuild the request so the owning reactor can process it afresh.
+            std::ostringstream request;
+            request << line.verbText << " " << requestUri << " " << line.httpVersion << "\r\n";
+            for (auto& header : headers.headers()) {
+                request << header.first << ": " << header.second << "\r\n";
+            }
+            request << "\r\n";
+            auto requestText = request.str();
+            std::vector<uint8_t> input(requestText.begin(), requestText.end());
+            const uint8_t* endOfInput = _input->data() + _input->size();
+            input.insert(input.end(), afterHeaders, endOfInput);
+            if (!_server.handOff(this, *_webSocketHandler, std::move(input))) {
+                _webSocketHandler.reset();
+                return sendError(ResponseCode::ServiceUnavailable, "No reactor available for this endpoint");
+            }
+            return true;
+        }
         verb = Request::Verb::WebSocket;
 
-        if (_server.server().getPerMessageDeflateEnabled() && headers.count("Sec-WebSocket-Extensions")) {
-            parsePerMessageDeflateHeader(headers["Sec-WebSocket-Extensions"]);
+        if (_server.server().getPerMessageDeflateEnabled() && headers.has(KnownHeader::SecWebSocketExtensions)) {
+            parsePerMessageDeflateHeader(std::string(headers.get(KnownHeader::SecWebSocketExtensions)));
         }
     }
 
-    _request = std::make_unique<PageRequest>(_address, requestUri, _server.server(),
+    _request = std::make_shared<PageRequest>(_address, requestUri, _server.server(),
                                              verb, std::move(headers));
+    return startRequestBody();
+}
 
-    const EmbeddedContent* embedded = findEmbeddedContent(requestUri);
-    if (verb == Request::Verb::Get && embedded) {
-        // MRG: one day, this could be a request handler.
-        return sendData(getContentType(requestUri), embedded->data, embedded->length);
-    } else if (verb == Request::Verb::Head && embedded) {
-        return sendHeader(getContentType(requestUri), embedded->length);
+bool Connection::startRequestBody() {
+    auto chunked = false;
+    if (_request->hasHeader(KnownHeader::TransferEncoding)) {
+        auto encoding = trimWhitespace(std::string(_request->getHeader(KnownHeader::TransferEncoding)));
+        if (strcasecmp(encoding.c_str(), "chunked") != 0) {
+            return sendUnsupportedError("Unsupported transfer encoding: " + encoding);
+        }
+        if (_request->hasHeader(KnownHeader::ContentLength)) {
+            return sendBadRequest("Both Content-Length and Transfer-Encoding given");
+        }
+        chunked = true;
+    }
+    if (!chunked && _request->contentLength() == 0) {
+        return dispatchRequest();
     }
 
-    if (_request->contentLength() > _server.clientBufferSize()) {
-        return sendBadRequest("Content length too long");
+    try {
+        _bodyHandler = _server.bodyHandler(*_request);
+    } catch (const std::exception& e) {
+        LS_ERROR(logger(), "page error: " << e.what());
+        return sendISE(e.what());
+    } catch (...) {
+        LS_ERROR(logger(), "page error: (unknown)");
+        return sendISE("(unknown)");
     }
-    if (_request->contentLength() == 0) {
-        return handlePageRequest();
+    // Only bodies that needn't all sit in memory may exceed the client buffer size.
+    auto spillThreshold = _server.requestBodySpillThreshold();
+    auto limit = _bodyHandler || spillThreshold > 0 ? _server.maxRequestBodySize() : _server.clientBufferSize();
+    if (_request->contentLength() > limit) {
+        _bodyHandler.reset();
+        return sendError(ResponseCode::PayloadTooLarge, "Content length too long");
+    }
+    _bodyDecoder = std::make_unique<BodyDecoder>(chunked ? BodyDecoder::chunked(limit)
+                                                         : BodyDecoder::fixed(_request->contentLength()));
+    if (!_bodyHandler) {
+        _bodyBuffer = std::make_unique<BodyBuffer>(spillThreshold);
+    }
+    // A client that's waiting to be told to go ahead hasn't sent any of the body yet.
+    if (_input->empty() && _request->hasHeader(KnownHeader::Expect)
+        && strcasecmp(trimWhitespace(std::string(_request->getHeader(KnownHeader::Expect))).c_str(), "100-continue") == 0) {
+        bufferLine("HTTP/1.1 100 Continue");
+        bufferLine("");
+        if (!flush()) {
+            return false;
+        }
     }
     _state = State::BUFFERING_POST_DATA;
     return true;
 }
 
-bool Connection::handlePageRequest() {
+bool Connection::dispatchRequest() {
+    auto& requestUri = _request->getRequestUri();
+    const EmbeddedContent* embedded = findEmbeddedContent(requestUri);
+    if (_request->verb() == Request::Verb::Get && embedded) {
+        // MRG: one day, this could be a request handler.
+        return sendData(getContentType(requestUri), embedded->data, embedded->length, true);
+    } else if (_request->verb() == Request::Verb::Head && embedded) {
+        return sendHeader(getContentType(requestUri), embedded->length);
+    }
+    return handlePageRequest();
+}
+
+bool Connection::handlePageRequest(size_t firstHandler) {
     std::shared_ptr<Response> response;
     try {
-        response = _server.handle(*_request);
+        response = _server.handle(_request, firstHandler);
     } catch (const std::exception& e) {
-        LS_ERROR(_logger, "page error: " << e.what());
+        LS_ERROR(logger(), "page error: " << e.what());
         return sendISE(e.what());
     } catch (...) {
-        LS_ERROR(_logger, "page error: (unknown)");
+        LS_ERROR(logger(), "page error: (unknown)");
         return sendISE("(unknown)");
     }
     auto uri = _request->getRequestUri();
@@ -919,26 +1924,40 @@ bool Connection::handlePageRequest() {
         _webSocketHandler = _server.getWebSocketHandler(uri.c_str());
         int webSocketVersion{0};
         try {
-            webSocketVersion = std::stoi(_request->getHeader("Sec-WebSocket-Version"));
+            webSocketVersion = std::stoi(std::string(_request->getHeader(KnownHeader::SecWebSocketVersion)));
         } catch (const std::logic_error& ex) {
-            LS_WARNING(_logger, "Invalid Sec-WebSocket-Version '" << _request->getHeader("Sec-WebSocket-Version") << "'");
+            LS_WARNING(logger(), "Invalid Sec-WebSocket-Version '" << _request->getHeader(KnownHeader::SecWebSocketVersion) << "'");
             return sendError(ResponseCode::UpgradeRequired, "Invalid Sec-WebSocket-Version received");
         }
         if (!_webSocketHandler) {
-            LS_WARNING(_logger, "Couldn't find WebSocket end point for '" << uri << "'");
+            LS_WARNING(logger(), "Couldn't find WebSocket end point for '" << uri << "'");
             return send404();
         }
+        _corks = _corks && _webSocketHandler->corksWrites();
         if (webSocketVersion == 0) {
             // Hixie
             _state = State::READING_WEBSOCKET_KEY3;
             return true;
         }
-        auto hybiKey = _request->getHeader("Sec-WebSocket-Key");
+        auto hybiKey = std::string(_request->getHeader(KnownHeader::SecWebSocketKey));
         return handleHybiHandshake(webSocketVersion, hybiKey);
     }
     return sendResponse(response);
 }
 
+void Connection::continuePageRequest(size_t nextHandler) {
+    _server.checkThread();
+    if (_state != State::AWAITING_RESPONSE_BEGIN) {
+        LS_ERROR(logger(), "continuePageRequest() called when in wrong state");
+        return;
+    }
+    _response.reset();
+    _state = State::READING_HEADERS;
+    if (!handlePageRequest(nextHandler)) {
+        closeInternal();
+    }
+}
+
 bool Connection::sendResponse(std::shared_ptr<Response> response) {
     if (response == Response::unhandled()) {
         return sendStaticData();
@@ -948,18 +1967,30 @@ bool Connection::sendResponse(std::shared_ptr<Response> response) {
     _transferEncoding = TransferEncoding::Raw;
     _chunk = 0;
     _response = response;
+    if (!_writer) {
+        _writer = std::make_shared<Writer>(*this);
+    }
     _response->handle(_writer);
     return true;
 }
 
 void Connection::error(ResponseCode responseCode, const std::string& payload) {
     _server.checkThread();
+    if (_state == State::SENDING_RESPONSE_HEADERS || _state == State::SENDING_RESPONSE_BODY) {
+        // Too late for an error page: cut the response short, so the client can tell.
+        LS_ERROR(logger(), "error() called part way through a response: " << payload);
+        _state = State::READING_HEADERS;
+        _response.reset();
+        flush();
+        closeWhenEmpty();
+        return;
+    }
     if (_state != State::AWAITING_RESPONSE_BEGIN) {
-        LS_ERROR(_logger, "error() called when in wrong state");
+        LS_ERROR(logger(), "error() called when in wrong state");
         return;
     }
     if (isOk(responseCode)) {
-        LS_ERROR(_logger, "error() called with a non-error code");
+        LS_ERROR(logger(), "error() called with a non-error code");
     }
     if (responseCode == ResponseCode::NotFound) {
         // TODO: better here; we use this purely to serve our own embedded content.
@@ -972,7 +2003,7 @@ void Connection::error(ResponseCode responseCode, const std::string& payload) {
 void Connection::begin(ResponseCode responseCode, TransferEncoding encoding) {
     _server.checkThread();
     if (_state != State::AWAITING_RESPONSE_BEGIN) {
-        LS_ERROR(_logger, "begin() called when in wrong state");
+        LS_ERROR(logger(), "begin() called when in wrong state");
         return;
     }
     _state = State::SENDING_RESPONSE_HEADERS;
@@ -986,7 +2017,7 @@ void Connection::begin(ResponseCode responseCode, TransferEncoding encoding) {
 void Connection::header(const std::string& header, const std::string& value) {
     _server.checkThread();
     if (_state != State::SENDING_RESPONSE_HEADERS) {
-        LS_ERROR(_logger, "header() called when in wrong state");
+        LS_ERROR(logger(), "header() called when in wrong state");
         return;
     }
     bufferLine(header + ": " + value);
@@ -997,7 +2028,7 @@ void Connection::payload(const void* data, size_t size, bool flush) {
         bufferLine("");
         _state = State::SENDING_RESPONSE_BODY;
     } else if (_state != State::SENDING_RESPONSE_BODY) {
-        LS_ERROR(_logger, "payload() called when in wrong state");
+        LS_ERROR(logger(), "payload() called when in wrong state");
         return;
     }
     if (size && _transferEncoding == TransferEncoding::Chunked) {
@@ -1006,6 +2037,32 @@ void Connection::payload(const void* data, size_t size, bool flush) {
     write(data, size, flush);
 }
 
+void Connection::payloadFile(int fd, uint64_t offset, size_t length, bool flush) {
+    _server.checkThread();
+    if (_state == State::SENDING_RESPONSE_HEADERS) {
+        bufferLine("");
+        _state = State::SENDING_RESPONSE_BODY;
+    } else if (_state != State::SENDING_RESPONSE_BODY) {
+        LS_ERROR(logger(), "payloadFile() called when in wrong state");
+        return;
+    }
+    if (!length) {
+        return;
+    }
+    // Our own descriptor, so the caller's can be closed at once.
+    auto file = std::make_shared<RaiiFd>(::fcntl(fd, F_DUPFD_CLOEXEC, 0));
+    if (!file->ok()) {
+        LS_ERROR(logger(), "Unable to duplicate file descriptor: " << getLastError());
+        // We can't send an error document as we've sent the header.
+        closeInternal();
+        return;
+    }
+    if (_transferEncoding == TransferEncoding::Chunked) {
+        writeChunkHeader(length);
+    }
+    writeFile(*file, offset, length, file, flush);
+}
+
 void Connection::writeChunkHeader(size_t size) {
     std::ostringstream lengthStr;
     if (_chunk)
@@ -1021,7 +2078,7 @@ void Connection::finish(bool keepConnectionOpen) {
     if (_state == State::SENDING_RESPONSE_HEADERS) {
         bufferLine("");
     } else if (_state != State::SENDING_RESPONSE_BODY) {
-        LS_ERROR(_logger, "finish() called when in wrong state");
+        LS_ERROR(logger(), "finish() called when in wrong state");
         return;
     }
     if (_transferEncoding == TransferEncoding::Chunked) {
@@ -1037,6 +2094,8 @@ void Connection::finish(bool keepConnectionOpen) {
 
     _state = State::READING_HEADERS;
     _response.reset();
+    // Answer whatever the client has already sent after this one.
+    handleNewData();
 }
 
 bool Connection::handleHybiHandshake(
@@ -1045,9 +2104,9 @@ bool Connection::handleHybiHandshake(
     if (webSocketVersion != 8 && webSocketVersion != 13) {
         return sendBadRequest("Invalid websocket version");
     }
-    LS_DEBUG(_logger, "Got a hybi-8 websocket with key=" << webSocketKey);
+    LS_DEBUG(logger(), "Got a hybi-8 websocket with key=" << webSocketKey);
 
-    LS_DEBUG(_logger, "Attempting websocket upgrade");
+    LS_DEBUG(logger(), "Attempting websocket upgrade");
 
     bufferResponseAndCommonHeaders(ResponseCode::WebSocketProtocolHandshake);
     bufferLine("Upgrade: websocket");
@@ -1073,7 +2132,7 @@ void Connection::parsePerMessageDeflateHeader(const std::string& header) {
         }
 
         if (seasocks::caseInsensitiveSame(extField, "permessage-deflate")) {
-            LS_INFO(_logger, "Enabling per-message deflate");
+            LS_INFO(logger(), "Enabling per-message deflate");
             _perMessageDeflate = true;
             zlibContext.initialise();
         }
@@ -1081,38 +2140,58 @@ void Connection::parsePerMessageDeflateHeader(const std::string& header) {
 }
 
 bool Connection::parseRange(const std::string& rangeStr, Range& range) const {
+    // strtoll() rather than from_chars(), which libstdc++ only has from GCC 8.
+    auto parse = [](const char* first, const char* last, int64_t& value) {
+        std::string number(first, last);
+        if (number.empty() || !(isdigit(static_cast<unsigned char>(number[0])) || number[0] == '-')) {
+            return false;
+        }
+        char* parsed;
+        errno = 0;
+        auto result = std::strtoll(number.c_str(), &parsed, 10);
+        if (errno == ERANGE || parsed != number.c_str() + number.size()) {
+            return false;
+        }
+        value = result;
+        return true;
+    };
     size_t minusPos = rangeStr.find('-');
+    auto text = rangeStr.data();
+    auto end = text + rangeStr.size();
     if (minusPos == std::string::npos) {
-        LS_WARNING(_logger, "Bad range: '" << rangeStr << "'");
+        LS_WARNING(logger(), "Bad range: '" << rangeStr << "'");
         return false;
     }
     if (minusPos == 0) {
         // A range like "-500" means 500 bytes from end of file to end.
-        range.start = std::stoi(rangeStr);
-        range.end = std::numeric_limits<long>::max();
-        return true;
-    } else {
-        range.start = std::stoi(rangeStr.substr(0, minusPos));
-        if (minusPos == rangeStr.size() - 1) {
-            range.end = std::numeric_limits<long>::max();
-        } else {
-            range.end = std::stoi(rangeStr.substr(minusPos + 1));
+        range.end = std::numeric_limits<int64_t>::max();
+        if (!parse(text, end, range.start)) {
+            LS_WARNING(logger(), "Bad range: '" << rangeStr << "'");
+            return false;
         }
         return true;
     }
-    return false;
+    range.end = std::numeric_limits<int64_t>::max();
+    if (!parse(text, text + minusPos, range.start)
+        || (minusPos != rangeStr.size() - 1 && !parse(text + minusPos + 1, end, range.end))
+        || range.start < 0 || range.end < range.start) {
+        LS_WARNING(logger(), "Bad range: '" << rangeStr << "'");
+        return false;
+    }
+    return true;
 }
 
 bool Connection::parseRanges(const std::string& range, std::list<Range>& ranges) const {
     static const std::string expectedPrefix = "bytes=";
     if (range.length() < expectedPrefix.length() || range.substr(0, expectedPrefix.length()) != expectedPrefix) {
-        LS_WARNING(_logger, "Bad range request prefix: '" << range << "'");
+        LS_WARNING(logger(), "Bad range request prefix: '" << range << "'");
         return false;
     }
     auto rangesText = split(range.substr(expectedPrefix.length()), ',');
     for (auto& it : rangesText) {
         Range r;
-        if (!parseRange(it, r)) {
+        // Specs may have whitespace around them, as in "bytes=0-10, 20-30".
+        if (!parseRange(trimWhitespace(it), r)) {
             return false;
         }
         ranges.push_back(r);
@@ -1120,9 +2199,22 @@ bool Connection::parseRanges(const std::string& range, std::list<Range>& ranges)
     return !ranges.empty();
 }
 
+Connection::Range Connection::clampRange(Range range, int64_t fileSize) {
+    if (range.start < 0) {
+        range.start = std::max<int64_t>(range.start + fileSize, 0);
+    }
+    if (range.start >= fileSize) {
+        range.start = fileSize - 1;
+    }
+    if (range.end >= fileSize) {
+        range.end = fileSize - 1;
+    }
+    return range;
+}
+
 // Sends HTTP 200 or 206, content-length, and range info as needed. Returns the actual file ranges
 // needing sending.
-std::list<Connection::Range> Connection::processRangesForStaticData(const std::list<Range>& origRanges, long fileSize) {
+std::list<Connection::Range> Connection::processRangesForStaticData(const std::list<Range>& origRanges, int64_t fileSize) {
     if (origRanges.empty()) {
         // Easy case: a non-range request.
         bufferResponseAndCommonHeaders(ResponseCode::Ok);
@@ -1132,20 +2224,12 @@ std::list<Connection::Range> Connection::processRangesForStaticData(const std::l
 
     // Partial content request.
     bufferResponseAndCommonHeaders(ResponseCode::PartialContent);
-    int contentLength = 0;
+    int64_t contentLength = 0;
     std::ostringstream rangeLine;
     rangeLine << "Content-Range: bytes ";
     std::list<Range> sendRanges;
-    for (auto actualRange : origRanges) {
-        if (actualRange.start < 0) {
-            actualRange.start += fileSize;
-        }
-        if (actualRange.start >= fileSize) {
-            actualRange.start = fileSize - 1;
-        }
-        if (actualRange.end >= fileSize) {
-            actualRange.end = fileSize - 1;
-        }
+    for (auto range : origRanges) {
+        auto actualRange = clampRange(range, fileSize);
         contentLength += actualRange.length();
         sendRanges.push_back(actualRange);
         rangeLine << actualRange.start << "-" << actualRange.end;
@@ -1159,7 +2243,7 @@ std::list<Connection::Range> Connection::processRangesForStaticData(const std::l
 bool Connection::sendStaticData() {
     // TODO: fold this into the handler way of doing things.
     std::string path = _server.getStaticPath() + getRequestUri();
-    auto rangeHeader = getHeader("Range");
+    auto rangeHeader = std::string(_request->getHeader(KnownHeader::Range));
     // Trim any trailing queries.
     size_t queryPos = path.find('?');
     if (queryPos != std::string::npos) {
@@ -1168,53 +2252,115 @@ bool Connection::sendStaticData() {
     if (*path.rbegin() == '/') {
         path += "index.html";
     }
+    // A bad Range header is only reported once the file's known to exist.
+    std::list<Range> ranges;
+    bool badRange = !rangeHeader.empty() && !parseRanges(rangeHeader, ranges);
+    if (badRange) {
+        ranges.clear();
+    }
 
-    RaiiFd input{::open(path.c_str(), O_RDONLY)};
+    auto pool = _server.filePool();
+    if (!pool) {
+        return sendStaticFile(path, openStaticFile(path, ranges, false), ranges, badRange);
+    }
+    // Opening the file may wait on the disk, so it's done off the loop, with the
+    // request waiting much as it would for an offloaded handler.
+    _state = State::AWAITING_RESPONSE_BEGIN;
+    if (!_writer) {
+        _writer = std::make_shared<Writer>(*this);
+    }
+    pool->submit(Task([server = &_server, writer = _writer, path = std::move(path), ranges = std::move(ranges),
+                       badRange]() mutable {
+        auto file = openStaticFile(path, ranges, true);
+        server->post(Task([writer = std::move(writer), path = std::move(path), file = std::move(file),
+                           ranges = std::move(ranges), badRange] {
+            // The writer's detached if the connection closed meanwhile.
+            if (writer->_connection) {
+                writer->_connection->finishStaticData(path, file, ranges, badRange);
+            }
+        }));
+    }));
+    return true;
+}
+
+Connection::StaticFile Connection::openStaticFile(const std::string& path, const std::list<Range>& ranges,
+                                                  bool readAhead) {
+    StaticFile file;
+    auto fd = std::make_shared<RaiiFd>(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
     struct stat fileStat;
-    if (!input.ok() || ::fstat(input, &fileStat) == -1) {
+    if (!fd->ok() || ::fstat(*fd, &fileStat) == -1) {
+        return file;
+    }
+    file.fd = std::move(fd);
+    file.size = fileStat.st_size;
+    file.modified = fileStat.st_mtime;
+    // It's sent front to back, so the kernel can read ahead further.
+    ::posix_fadvise(*file.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    if (!readAhead || !file.size) {
+        return file;
+    }
+    auto readAheadRange = [&](Range range) {
+        range = clampRange(range, file.size);
+        auto length = std::min(range.length(), StaticFileReadAhead);
+        // Blocks until it's read, unlike the advice given for the rest.
+        ::readahead(*file.fd, range.start, length);
+        if (range.length() > length) {
+            ::posix_fadvise(*file.fd, range.start + static_cast<off_t>(length),
+                            static_cast<off_t>(range.length() - length), POSIX_FADV_WILLNEED);
+        }
+    };
+    if (ranges.empty()) {
+        readAheadRange(Range{0, file.size - 1});
+    }
+    for (auto range : ranges) {
+        readAheadRange(range);
+    }
+    return file;
+}
+
+bool Connection::sendStaticFile(const std::string& path, const StaticFile& file, const std::list<Range>& requested,
+                                bool badRange) {
+    if (!file.fd) {
         return send404();
     }
-    std::list<Range> ranges;
-    if (!rangeHeader.empty() && !parseRanges(rangeHeader, ranges)) {
+    if (badRange) {
         return sendBadRequest("Bad range header");
     }
-    ranges = processRangesForStaticData(ranges, fileStat.st_size);
+    auto ranges = processRangesForStaticData(requested, file.size);
     bufferLine("Content-Type: " + getContentType(path));
     bufferLine("Connection: keep-alive");
     bufferLine("Accept-Ranges: bytes");
-    bufferLine("Last-Modified: " + webtime(fileStat.st_mtime));
+    bufferLine("Last-Modified: " + webtime(file.modified));
     if (!isCacheable(path)) {
         bufferLine("Cache-Control: no-store");
         bufferLine("Pragma: no-cache");
         bufferLine("Expires: " + now());
     }
     bufferLine("");
-    if (!flush()) {
-        return false;
-    }
 
+    // The file's sent straight from the page cache as the socket has room, so
+    // only where we've got to is kept.
     for (auto range : ranges) {
-        if (::lseek(input, range.start, SEEK_SET) == -1) {
-            // We've (probably) already sent data.
+        if (!writeFile(*file.fd, range.start, range.length(), file.fd, false)) {
             return false;
         }
-        auto bytesLeft = range.length();
-        while (bytesLeft) {
-            char buf[ReadWriteBufferSize];
-            auto bytesRead = ::read(input, buf, std::min(sizeof(buf), bytesLeft));
-            if (bytesRead <= 0) {
-                const static std::string unexpectedEof("Unexpected EOF");
-                LS_ERROR(_logger, "Error reading file: " << (bytesRead == 0 ? unexpectedEof : getLastError()));
-                // We can't send an error document as we've sent the header.
-                return false;
-            }
-            bytesLeft -= bytesRead;
-            if (!write(buf, bytesRead, true)) {
-                return false;
-            }
-        }
     }
-    return true;
+    return flush();
+}
+
+void Connection::finishStaticData(const std::string& path, const StaticFile& file, const std::list<Range>& ranges,
+                                  bool badRange) {
+    if (_state != State::AWAITING_RESPONSE_BEGIN) {
+        LS_ERROR(logger(), "Static file opened when in wrong state");
+        return;
+    }
+    _state = State::READING_HEADERS;
+    if (!sendStaticFile(path, file, ranges, badRange)) {
+        closeInternal();
+        return;
+    }
+    // Answer whatever the client has already sent after this one.
+    handleNewData();
 }
 
 bool Connection::sendHeader(const std::string& type, size_t size) {
@@ -1225,12 +2371,16 @@ bool Connection::sendHeader(const std::string& type, size_t size) {
     return bufferLine("");
 }
 
-bool Connection::sendData(const std::string& type, const char* start, size_t size) {
+bool Connection::sendData(const std::string& type, const char* start, size_t size, bool embedded) {
     bufferResponseAndCommonHeaders(ResponseCode::Ok);
     bufferLine("Content-Type: " + type);
     bufferLine("Content-Length: " + toString(size));
     bufferLine("Connection: keep-alive");
     bufferLine("");
+    if (embedded) {
+        // Embedded content lives as long as the program, so needn't be copied.
+        return writeBorrowed(start, size, nullptr);
+    }
     bool result = write(start, size, true);
     return result;
 }
@@ -1239,7 +2389,7 @@ void Connection::bufferResponseAndCommonHeaders(ResponseCode code) {
     auto responseCodeInt = static_cast<int>(code);
     auto responseCodeName = ::name(code);
     auto response = std::string("HTTP/1.1 " + toString(responseCodeInt) + " " + responseCodeName);
-    LS_ACCESS(_logger, "Response: " << response);
+    LS_ACCESS(logger(), "Response: " << response);
     bufferLine(response);
     bufferLine("Server: " + std::string(Config::version));
     bufferLine("Date: " + now());
@@ -1253,7 +2403,7 @@ void Connection::setLinger() {
     const int secondsToLinger = 1;
     struct linger linger = {true, secondsToLinger};
     if (::setsockopt(_fd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger)) == -1) {
-        LS_INFO(_logger, "Unable to set linger on socket");
+        LS_INFO(logger(), "Unable to set linger on socket");
     }
 }
 
@@ -1265,11 +2415,23 @@ std::string Connection::getHeader(const std::string& header) const {
     return _request ? _request->getHeader(header) : "";
 }
 
+std::string_view Connection::getHeaderView(std::string_view header) const {
+    return _request ? _request->getHeaderView(header) : std::string_view();
+}
+
 const std::string& Connection::getRequestUri() const {
     static const std::string empty;
     return _request ? _request->getRequestUri() : empty;
 }
 
+size_t Connection::inputBufferSize() const {
+    return _input->size();
+}
+
+size_t Connection::outputBufferSize() const {
+    return _output->size();
+}
+
 Server& Connection::server() const {
     return _server.server();
 }
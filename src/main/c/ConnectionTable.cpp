@@ -0,0 +1,143 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/ConnectionTable.h"
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace seasocks {
+
+constexpr size_t ConnectionTable::SlabSize;
+constexpr uint32_t ConnectionTable::NoSlot;
+
+uint32_t ConnectionTable::allocate() {
+    if (!_free.empty()) {
+        // Most recently freed first: its memory is the most likely to be cached.
+        auto index = _free.back();
+        _free.pop_back();
+        return index;
+    }
+    auto index = static_cast<uint32_t>(_entries.size());
+    if (index % SlabSize == 0) {
+        _slabs.emplace_back(new Slot[SlabSize]);
+    }
+    _entries.push_back(Entry{nullptr, 0, 0, 0});
+    return index;
+}
+
+uint32_t ConnectionTable::slotOf(const Connection* connection) const {
+    if (!connection) {
+        return NoSlot;
+    }
+    auto index = connection->_tableSlot;
+    if (index >= _entries.size() || slot(index)->storage() != connection) {
+        return NoSlot;
+    }
+    return index;
+}
+
+Connection* ConnectionTable::create(std::shared_ptr<Logger> logger, ServerImpl& server,
+                                    int fd, const sockaddr_in& address) {
+    auto index = allocate();
+    Connection* connection;
+    try {
+        connection = new (slot(index)->storage()) Connection(std::move(logger), server, fd, address);
+    } catch (...) {
+        _free.push_back(index);
+        throw;
+    }
+    connection->_tableSlot = index;
+    return connection;
+}
+
+void ConnectionTable::destroy(Connection* connection) {
+    auto index = slotOf(connection);
+    if (index == NoSlot) {
+        return;
+    }
+    // The destructor removes the connection from the server, and so from here.
+    connection->~Connection();
+    Entry ignored;
+    removeAt(index, ignored);
+    _free.push_back(index);
+}
+
+ConnectionHandle ConnectionTable::add(Connection* connection, time_t since) {
+    auto index = slotOf(connection);
+    auto& entry = _entries[index];
+    entry.connection = connection;
+    entry.since = since;
+    entry.lameTimer = 0;
+    ++_size;
+    return {index, entry.generation};
+}
+
+bool ConnectionTable::remove(Connection* connection, Entry& removed) {
+    auto index = slotOf(connection);
+    return index != NoSlot && removeAt(index, removed);
+}
+
+bool ConnectionTable::removeAt(uint32_t index, Entry& removed) {
+    auto& entry = _entries[index];
+    if (!entry.connection) {
+        return false;
+    }
+    removed = entry;
+    entry.connection = nullptr;
+    // Outstanding handles to this connection are now stale.
+    ++entry.generation;
+    --_size;
+    return true;
+}
+
+ConnectionTable::Entry* ConnectionTable::find(Connection* connection) {
+    auto index = slotOf(connection);
+    if (index == NoSlot || !_entries[index].connection) {
+        return nullptr;
+    }
+    return &_entries[index];
+}
+
+ConnectionTable::Entry* ConnectionTable::find(ConnectionHandle handle) {
+    if (handle.index >= _entries.size()) {
+        return nullptr;
+    }
+    auto& entry = _entries[handle.index];
+    if (!entry.connection || entry.generation != handle.generation) {
+        return nullptr;
+    }
+    return &entry;
+}
+
+std::vector<Connection*> ConnectionTable::registered() const {
+    std::vector<Connection*> connections;
+    connections.reserve(_size);
+    forEach([&](const Entry& entry) { connections.push_back(entry.connection); });
+    return connections;
+}
+
+}
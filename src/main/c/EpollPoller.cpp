@@ -0,0 +1,78 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/Poller.h"
+
+#include <unistd.h>
+
+namespace seasocks {
+
+namespace {
+
+class EpollPoller : public Poller {
+    int _epollFd;
+
+public:
+    explicit EpollPoller(int epollFd)
+            : _epollFd(epollFd) {
+    }
+    ~EpollPoller() {
+        ::close(_epollFd);
+    }
+
+    const char* name() const override {
+        return "epoll";
+    }
+    int fd() const override {
+        return _epollFd;
+    }
+    bool add(int fd, uint32_t events, void* data) override {
+        epoll_event event = {events, {data}};
+        return epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+    }
+    bool modify(int fd, uint32_t events, void* data) override {
+        epoll_event event = {events, {data}};
+        return epoll_ctl(_epollFd, EPOLL_CTL_MOD, fd, &event) == 0;
+    }
+    bool remove(int fd) override {
+        epoll_event event = {0, {nullptr}};
+        return epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, &event) == 0;
+    }
+    int wait(epoll_event* events, int maxEvents, int millis) override {
+        return epoll_wait(_epollFd, events, maxEvents, millis);
+    }
+};
+
+}
+
+std::unique_ptr<Poller> makeEpollPoller() {
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd == -1) {
+        return nullptr;
+    }
+    return std::make_unique<EpollPoller>(epollFd);
+}
+
+}
@@ -0,0 +1,151 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/ExecutorQueue.h"
+
+#include <cassert>
+
+namespace seasocks {
+
+ExecutorQueue::ExecutorQueue(size_t capacity)
+        : _mask(capacity - 1),
+          _cells(new Cell[capacity]),
+          _enqueuePos{{0}, {}},
+          _dequeuePos(0),
+          _signalled(false),
+          _executed(0),
+          _overflowSize(0),
+          _overflowed(0),
+          _drainingSize(0) {
+    assert(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+    for (size_t i = 0; i < capacity; ++i) {
+        _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool ExecutorQueue::push(Task&& task) {
+    // Once anything has overflowed, later tasks follow it until the consumer
+    // takes the overflow, to keep each producer's tasks in order.
+    if (_overflowSize.load(std::memory_order_acquire) != 0 || !tryPush(task)) {
+        std::lock_guard<std::mutex> lock(_overflowMutex);
+        _overflow.emplace_back(std::move(task));
+        _overflowSize.fetch_add(1, std::memory_order_release);
+        _overflowed.fetch_add(1, std::memory_order_relaxed);
+    }
+    // Pairs with the fence in runBatch(): either the consumer sees this task, or
+    // we see that it has cleared _signalled and so must be woken.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_signalled.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    return !_signalled.exchange(true, std::memory_order_acq_rel);
+}
+
+bool ExecutorQueue::tryPush(Task& task) {
+    auto pos = _enqueuePos.value.load(std::memory_order_relaxed);
+    for (;;) {
+        auto& cell = _cells[pos & _mask];
+        auto sequence = cell.sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (_enqueuePos.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                cell.task = std::move(task);
+                cell.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            // Full: the consumer hasn't finished with this cell since last time round.
+            return false;
+        } else {
+            pos = _enqueuePos.value.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool ExecutorQueue::tryPop(Task& task) {
+    auto pos = _dequeuePos.load(std::memory_order_relaxed);
+    auto& cell = _cells[pos & _mask];
+    if (cell.sequence.load(std::memory_order_acquire) != pos + 1) {
+        return false;
+    }
+    task = std::move(cell.task);
+    cell.sequence.store(pos + _mask + 1, std::memory_order_release);
+    _dequeuePos.store(pos + 1, std::memory_order_relaxed);
+    return true;
+}
+
+bool ExecutorQueue::ringEmpty() const {
+    // Unlike a failed tryPop(), this is false while a producer is part way
+    // through filling a claimed cell.
+    return _enqueuePos.value.load(std::memory_order_acquire) == _dequeuePos.load(std::memory_order_relaxed);
+}
+
+bool ExecutorQueue::runBatch(size_t maxTasks) {
+    _signalled.store(false, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    size_t numRun = 0;
+    while (numRun < maxTasks) {
+        Task task;
+        if (!_draining.empty()) {
+            task = std::move(_draining.front());
+            _draining.pop_front();
+            _drainingSize.store(_draining.size(), std::memory_order_relaxed);
+        } else if (!tryPop(task)) {
+            // Overflowed tasks are newer than anything left in the ring, so can only
+            // be taken once it's completely empty. The overflow must be checked first:
+            // seeing it non-empty guarantees we see the ring positions of the pushes
+            // that preceded it.
+            if (_overflowSize.load(std::memory_order_acquire) == 0 || !ringEmpty()) {
+                break;
+            }
+            std::lock_guard<std::mutex> lock(_overflowMutex);
+            _draining.swap(_overflow);
+            _drainingSize.store(_draining.size(), std::memory_order_relaxed);
+            _overflowSize.store(0, std::memory_order_release);
+            continue;
+        }
+        ++numRun;
+        _executed.fetch_add(1, std::memory_order_relaxed);
+        task();
+    }
+
+    if (_draining.empty() && _overflowSize.load(std::memory_order_acquire) == 0 && ringEmpty()) {
+        return false;
+    }
+    // Either we stopped early, or a producer is mid-push: stay "woken" and have
+    // the caller come back for the rest.
+    _signalled.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+size_t ExecutorQueue::depth() const {
+    auto enqueued = _enqueuePos.value.load(std::memory_order_relaxed);
+    auto dequeued = _dequeuePos.load(std::memory_order_relaxed);
+    auto inRing = enqueued > dequeued ? enqueued - dequeued : 0;
+    return inRing + _overflowSize.load(std::memory_order_relaxed) + _drainingSize.load(std::memory_order_relaxed);
+}
+
+}
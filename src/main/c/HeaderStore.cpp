@@ -0,0 +1,100 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/HeaderStore.h"
+
+#include <strings.h>
+
+#include <cstring>
+
+namespace seasocks {
+
+namespace {
+
+constexpr std::pair<std::string_view, KnownHeader> knownHeaders[] = {
+    {"Host", KnownHeader::Host},
+    {"Connection", KnownHeader::Connection},
+    {"Upgrade", KnownHeader::Upgrade},
+    {"Origin", KnownHeader::Origin},
+    {"Sec-WebSocket-Key", KnownHeader::SecWebSocketKey},
+    {"Sec-WebSocket-Key1", KnownHeader::SecWebSocketKey1},
+    {"Sec-WebSocket-Key2", KnownHeader::SecWebSocketKey2},
+    {"Sec-WebSocket-Version", KnownHeader::SecWebSocketVersion},
+    {"Sec-WebSocket-Protocol", KnownHeader::SecWebSocketProtocol},
+    {"Sec-WebSocket-Extensions", KnownHeader::SecWebSocketExtensions},
+    {"Content-Length", KnownHeader::ContentLength},
+    {"Transfer-Encoding", KnownHeader::TransferEncoding},
+    {"Expect", KnownHeader::Expect},
+    {"Range", KnownHeader::Range},
+    {"Cookie", KnownHeader::Cookie},
+};
+
+bool sameName(std::string_view lhs, std::string_view rhs) {
+    return lhs.size() == rhs.size() && strncasecmp(lhs.data(), rhs.data(), lhs.size()) == 0;
+}
+
+const KnownHeader* knownHeader(std::string_view name) {
+    for (auto& known : knownHeaders) {
+        if (sameName(known.first, name)) {
+            return &known.second;
+        }
+    }
+    return nullptr;
+}
+
+}
+
+HeaderStore::HeaderStore(const uint8_t* first, const uint8_t* last)
+        : _block(new uint8_t[last - first]),
+          _blockSize(last - first) {
+    std::memcpy(_block.get(), first, _blockSize);
+    _headers.reserve(16);
+}
+
+void HeaderStore::add(std::string_view name, std::string_view value) {
+    _headers.emplace_back(name, value);
+    if (auto known = knownHeader(name)) {
+        auto& slot = _known[static_cast<size_t>(*known)];
+        if (slot == 0) {
+            slot = static_cast<uint16_t>(_headers.size());
+        }
+    }
+}
+
+const HeaderStore::Header* HeaderStore::find(std::string_view name) const {
+    auto known = knownHeader(name);
+    if (known) {
+        auto index = slot(*known);
+        return index == 0 ? nullptr : &_headers[index - 1];
+    }
+    for (auto& header : _headers) {
+        if (sameName(header.first, name)) {
+            return &header;
+        }
+    }
+    return nullptr;
+}
+
+}
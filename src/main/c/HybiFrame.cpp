@@ -0,0 +1,66 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/HybiFrame.h"
+
+#include <cstring>
+
+namespace seasocks {
+
+constexpr size_t HybiFrameHeader::MaxSize;
+
+HybiFrameHeader::HybiFrameHeader(uint8_t firstByte, size_t payloadLength) {
+    bytes[0] = firstByte;
+    if (payloadLength < 126) {
+        bytes[1] = static_cast<uint8_t>(payloadLength);
+        size = 2;
+    } else if (payloadLength < 65536) {
+        bytes[1] = 126;
+        bytes[2] = static_cast<uint8_t>(payloadLength >> 8);
+        bytes[3] = static_cast<uint8_t>(payloadLength);
+        size = 4;
+    } else {
+        bytes[1] = 127;
+        for (int i = 0; i < 8; ++i) {
+            bytes[2 + i] = static_cast<uint8_t>(static_cast<uint64_t>(payloadLength) >> (56 - 8 * i));
+        }
+        size = 10;
+    }
+}
+
+std::shared_ptr<const SharedFrame> SharedFrame::encode(uint8_t opcode, const void* payload, size_t length) {
+    HybiFrameHeader header(0x80 | opcode, length);
+    auto frame = std::make_shared<SharedFrame>();
+    frame->opcode = opcode;
+    frame->headerSize = header.size;
+    frame->bytes.resize(header.size + length);
+    memcpy(frame->bytes.data(), header.bytes, header.size);
+    if (length) {
+        memcpy(frame->bytes.data() + header.size, payload, length);
+    }
+    return frame;
+}
+
+}
@@ -25,6 +25,7 @@
 
 #include "internal/HybiPacketDecoder.h"
 #include "internal/LogStream.h"
+#include "internal/Unmask.h"
 
 #include <arpa/inet.h>
 #include <byteswap.h>
@@ -33,38 +34,31 @@
 namespace seasocks {
 
 HybiPacketDecoder::HybiPacketDecoder(Logger& logger,
-                                     const std::vector<uint8_t>& buffer)
+                                     const uint8_t* buffer, size_t size)
         : _logger(logger),
           _buffer(buffer),
+          _size(size),
           _messageStart(0) {
 }
 
-HybiPacketDecoder::MessageState HybiPacketDecoder::decodeNextMessage(
-    std::vector<uint8_t>& messageOut, bool& deflateNeeded) {
-    if (_messageStart + 1 >= _buffer.size()) {
+HybiPacketDecoder::MessageState HybiPacketDecoder::peekNextFrame(FrameHeader& header) const {
+    if (_messageStart + 1 >= _size) {
         return MessageState::NoMessage;
     }
-    if ((_buffer[_messageStart] & 0x80) == 0) {
-        // FIN bit is not clear...
-        // TODO: support
-        LS_WARNING(&_logger, "Received hybi frame without FIN bit set - unsupported");
-        return MessageState::Error;
-    }
-
-    auto reservedBits = _buffer[_messageStart] & (7 << 4);
-    if ((reservedBits & 0x30) != 0) {
+    auto firstByte = _buffer[_messageStart];
+    if ((firstByte & 0x30) != 0) {
         LS_WARNING(&_logger, "Received hybi frame with reserved bits set - error");
         return MessageState::Error;
     }
+    header.fin = !!(firstByte & 0x80);
+    header.compressed = !!(firstByte & 0x40);
+    header.opcode = static_cast<Opcode>(firstByte & 0xf);
 
-    deflateNeeded = !!(reservedBits & 0x40);
-
-    auto opcode = static_cast<Opcode>(_buffer[_messageStart] & 0xf);
     size_t payloadLength = _buffer[_messageStart + 1] & 0x7fu;
     auto maskBit = _buffer[_messageStart + 1] & 0x80;
     auto ptr = _messageStart + 2;
     if (payloadLength == 126) {
-        if (_buffer.size() < 4) {
+        if (_size < ptr + 2) {
             return MessageState::NoMessage;
         }
         uint16_t raw_length;
@@ -72,7 +66,7 @@ HybiPacketDecoder::MessageState HybiPacketDecoder::decodeNextMessage(
         payloadLength = htons(raw_length);
         ptr += 2;
     } else if (payloadLength == 127) {
-        if (_buffer.size() < 10) {
+        if (_size < ptr + 8) {
             return MessageState::NoMessage;
         }
         uint64_t raw_length;
@@ -80,45 +74,60 @@ HybiPacketDecoder::MessageState HybiPacketDecoder::decodeNextMessage(
         payloadLength = __bswap_64(raw_length);
         ptr += 8;
     }
-    uint32_t mask = 0;
+    header.mask = 0;
     if (maskBit) {
-        // MASK is set.
-        if (_buffer.size() < ptr + 4) {
+        if (_size < ptr + 4) {
             return MessageState::NoMessage;
         }
-        uint32_t raw_length;
-        memcpy(&raw_length, &_buffer[ptr], sizeof(raw_length));
-        mask = htonl(raw_length);
+        memcpy(&header.mask, &_buffer[ptr], sizeof(header.mask));
         ptr += 4;
     }
-    auto bytesLeftInBuffer = _buffer.size() - ptr;
-    if (payloadLength > bytesLeftInBuffer) {
-        return MessageState::NoMessage;
-    }
+    header.headerSize = ptr - _messageStart;
+    header.payloadLength = payloadLength;
 
-    messageOut.clear();
-    messageOut.reserve(payloadLength);
-    for (auto i = 0u; i < payloadLength; ++i) {
-        auto byteShift = (3 - (i & 3)) * 8;
-        messageOut.push_back(static_cast<uint8_t>((_buffer[ptr++] ^ (mask >> byteShift)) & 0xff));
-    }
-    _messageStart = ptr;
-    switch (opcode) {
+    switch (header.opcode) {
         default:
             LS_WARNING(&_logger, "Received hybi frame with unknown opcode "
-                                     << static_cast<int>(opcode));
+                                     << static_cast<int>(header.opcode));
             return MessageState::Error;
+        case Opcode::Cont:
+            return MessageState::Continuation;
         case Opcode::Text:
             return MessageState::TextMessage;
         case Opcode::Binary:
             return MessageState::BinaryMessage;
         case Opcode::Ping:
-            return MessageState::Ping;
         case Opcode::Pong:
-            return MessageState::Pong;
         case Opcode::Close:
-            return MessageState::Close;
+            break;
+    }
+    // Control frames may come between the fragments of a message, but can't
+    // themselves be fragmented.
+    if (!header.fin || header.payloadLength > 125) {
+        LS_WARNING(&_logger, "Received fragmented or oversized hybi control frame");
+        return MessageState::Error;
+    }
+    return header.opcode == Opcode::Ping   ? MessageState::Ping
+           : header.opcode == Opcode::Pong ? MessageState::Pong
+                                           : MessageState::Close;
+}
+
+HybiPacketDecoder::MessageState HybiPacketDecoder::decodeNextMessage(
+    std::vector<uint8_t>& messageOut, bool& deflateNeeded, bool& fin) {
+    FrameHeader header;
+    auto state = peekNextFrame(header);
+    if (state == MessageState::NoMessage || state == MessageState::Error) {
+        return state;
+    }
+    if (header.payloadLength > _size - _messageStart - header.headerSize) {
+        return MessageState::NoMessage;
     }
+    deflateNeeded = header.compressed;
+    fin = header.fin;
+    messageOut.resize(header.payloadLength);
+    unmask(messageOut.data(), &_buffer[_messageStart + header.headerSize], header.payloadLength, header.mask);
+    skip(header, header.payloadLength);
+    return state;
 }
 
 size_t HybiPacketDecoder::numBytesDecoded() const {
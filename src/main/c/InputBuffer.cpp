@@ -0,0 +1,77 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/InputBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace seasocks {
+
+uint8_t* InputBuffer::prepare(size_t size) {
+    if (_capacity - _end >= size) {
+        return _storage.get() + _end;
+    }
+    auto used = _end - _begin;
+    if (_capacity - used >= size && _begin > 0) {
+        std::memmove(_storage.get(), _storage.get() + _begin, used);
+    } else {
+        auto capacity = std::max(_capacity * 2, used + size);
+        // Deliberately not value-initialised: the caller is about to overwrite it.
+        std::unique_ptr<uint8_t[]> storage(new uint8_t[capacity]);
+        if (used > 0) {
+            std::memcpy(storage.get(), _storage.get() + _begin, used);
+        }
+        _storage = std::move(storage);
+        _capacity = capacity;
+    }
+    _begin = 0;
+    _end = used;
+    return _storage.get() + _end;
+}
+
+void InputBuffer::consume(size_t size) {
+    _begin += size;
+    if (_begin == _end) {
+        // Nothing left to keep, so start again at the front for free.
+        _begin = _end = 0;
+    }
+}
+
+void InputBuffer::assign(const uint8_t* first, const uint8_t* last) {
+    clear();
+    append(first, last);
+}
+
+void InputBuffer::append(const uint8_t* first, const uint8_t* last) {
+    auto size = static_cast<size_t>(last - first);
+    if (size == 0) {
+        return;
+    }
+    std::memcpy(prepare(size), first, size);
+    commit(size);
+}
+
+}
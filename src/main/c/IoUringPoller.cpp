@@ -0,0 +1,342 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/Poller.h"
+
+#include <linux/io_uring.h>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <unordered_map>
+
+// An io_uring backed Poller. Each registered descriptor has a single-shot poll
+// request armed in the ring; when it completes the event is reported and the poll
+// re-armed, which gives the same level-triggered behaviour as epoll. Edge-triggered
+// registrations use a multishot poll instead, which completes each time the
+// descriptor is woken and stays armed until the kernel says otherwise. Arming,
+// modifying and removing polls only queue submission entries: they reach the
+// kernel together with the next wait, however many registrations changed. Only
+// readiness goes through the ring; the reads, writes and accepts it prompts are
+// still made by the caller, a system call each.
+
+namespace seasocks {
+
+namespace {
+
+constexpr unsigned RingEntries = 256;
+// Completions we have no interest in, e.g. those of poll removals.
+constexpr uint64_t IgnoredUserData = ~0ull;
+constexpr uint32_t PollableEvents = EPOLLIN | EPOLLPRI | EPOLLOUT | EPOLLERR | EPOLLHUP | EPOLLRDHUP;
+
+int ioUringSetup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags,
+                 const void* arg, size_t argSize) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, arg, argSize));
+}
+
+class IoUringPoller : public Poller {
+    struct Registration {
+        uint32_t events;
+        void* data;
+        uint32_t generation;
+        bool armed;
+    };
+
+    int _ringFd;
+    void* _ring = MAP_FAILED;
+    size_t _ringSize = 0;
+    io_uring_sqe* _sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t _sqesSize = 0;
+
+    unsigned* _sqHead = nullptr;
+    unsigned* _sqTail = nullptr;
+    unsigned* _sqArray = nullptr;
+    unsigned _sqMask = 0;
+    unsigned _sqEntries = 0;
+    unsigned _sqLocalTail = 0;
+
+    unsigned* _cqHead = nullptr;
+    unsigned* _cqTail = nullptr;
+    io_uring_cqe* _cqes = nullptr;
+    unsigned _cqMask = 0;
+
+    // Generations are unique across all registrations so completions from polls
+    // on a since-closed (and possibly reused) descriptor can be told apart.
+    uint32_t _nextGeneration = 0;
+    std::unordered_map<int, Registration> _registrations;
+
+    static uint64_t userData(int fd, uint32_t generation) {
+        return (static_cast<uint64_t>(fd) << 32) | generation;
+    }
+
+    unsigned unsubmitted() const {
+        return _sqLocalTail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+    }
+
+    io_uring_sqe* nextSqe() {
+        if (unsubmitted() >= _sqEntries && (!submit() || unsubmitted() >= _sqEntries)) {
+            errno = EBUSY;
+            return nullptr;
+        }
+        auto index = _sqLocalTail & _sqMask;
+        auto sqe = &_sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        _sqArray[index] = index;
+        ++_sqLocalTail;
+        return sqe;
+    }
+
+    bool arm(int fd, Registration& registration) {
+        auto sqe = nextSqe();
+        if (!sqe) {
+            return false;
+        }
+        registration.generation = ++_nextGeneration;
+        registration.armed = true;
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = fd;
+        sqe->poll32_events = registration.events & PollableEvents;
+        if (registration.events & EPOLLET) {
+            sqe->len = IORING_POLL_ADD_MULTI;
+        }
+        sqe->user_data = userData(fd, registration.generation);
+        return true;
+    }
+
+    bool disarm(int fd, Registration& registration) {
+        if (!registration.armed) {
+            return true;
+        }
+        auto sqe = nextSqe();
+        if (!sqe) {
+            return false;
+        }
+        registration.armed = false;
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = userData(fd, registration.generation);
+        sqe->user_data = IgnoredUserData;
+        return true;
+    }
+
+    int reap(epoll_event* events, int maxEvents) {
+        int numEvents = 0;
+        auto head = *_cqHead;
+        auto tail = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+        while (head != tail && numEvents < maxEvents) {
+            const auto& cqe = _cqes[head & _cqMask];
+            ++head;
+            if (cqe.user_data == IgnoredUserData) {
+                continue;
+            }
+            auto fd = static_cast<int>(cqe.user_data >> 32);
+            auto generation = static_cast<uint32_t>(cqe.user_data);
+            auto it = _registrations.find(fd);
+            if (it == _registrations.end() || !it->second.armed || it->second.generation != generation) {
+                // A completion for a poll that has since been removed or replaced.
+                continue;
+            }
+            auto& registration = it->second;
+            if (cqe.res != -ECANCELED) {
+                auto ready = cqe.res < 0 ? static_cast<uint32_t>(EPOLLERR) : static_cast<uint32_t>(cqe.res);
+                events[numEvents++] = {ready, {registration.data}};
+            }
+            if (cqe.flags & IORING_CQE_F_MORE) {
+                // A multishot poll that is still armed.
+                continue;
+            }
+            registration.armed = false;
+            // Re-arm straight away; if the descriptor is still ready this completes
+            // on the next submission, just as epoll would report it again.
+            arm(fd, registration);
+        }
+        __atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+        return numEvents;
+    }
+
+public:
+    explicit IoUringPoller(int ringFd)
+            : _ringFd(ringFd) {
+    }
+
+    ~IoUringPoller() {
+        if (_sqes != MAP_FAILED) {
+            munmap(_sqes, _sqesSize);
+        }
+        if (_ring != MAP_FAILED) {
+            munmap(_ring, _ringSize);
+        }
+        ::close(_ringFd);
+    }
+
+    bool map(const io_uring_params& params) {
+        auto sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        auto cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        _ringSize = sqRingSize > cqRingSize ? sqRingSize : cqRingSize;
+        _ring = mmap(nullptr, _ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     _ringFd, IORING_OFF_SQ_RING);
+        if (_ring == MAP_FAILED) {
+            return false;
+        }
+        _sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        _sqes = static_cast<io_uring_sqe*>(mmap(nullptr, _sqesSize, PROT_READ | PROT_WRITE,
+                                                MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_SQES));
+        if (_sqes == MAP_FAILED) {
+            return false;
+        }
+        auto base = static_cast<char*>(_ring);
+        _sqHead = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+        _sqTail = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+        _sqArray = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+        _sqMask = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+        _sqEntries = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_entries);
+        _sqLocalTail = *_sqTail;
+        _cqHead = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+        _cqTail = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+        _cqes = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+        _cqMask = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+        return true;
+    }
+
+    const char* name() const override {
+        return "io_uring";
+    }
+
+    int fd() const override {
+        return _ringFd;
+    }
+
+    bool add(int fd, uint32_t events, void* data) override {
+        if (events & EPOLLEXCLUSIVE) {
+            // Polls can't be exclusive: every ring waiting on the descriptor is woken.
+            errno = EINVAL;
+            return false;
+        }
+        auto inserted = _registrations.emplace(fd, Registration{events, data, 0, false});
+        if (!inserted.second) {
+            errno = EEXIST;
+            return false;
+        }
+        if (!arm(fd, inserted.first->second)) {
+            _registrations.erase(inserted.first);
+            return false;
+        }
+        return true;
+    }
+
+    bool modify(int fd, uint32_t events, void* data) override {
+        if (events & EPOLLEXCLUSIVE) {
+            errno = EINVAL;
+            return false;
+        }
+        auto it = _registrations.find(fd);
+        if (it == _registrations.end()) {
+            errno = ENOENT;
+            return false;
+        }
+        if (!disarm(fd, it->second)) {
+            return false;
+        }
+        it->second.events = events;
+        it->second.data = data;
+        return arm(fd, it->second);
+    }
+
+    bool remove(int fd) override {
+        auto it = _registrations.find(fd);
+        if (it == _registrations.end()) {
+            errno = ENOENT;
+            return false;
+        }
+        auto result = disarm(fd, it->second);
+        _registrations.erase(it);
+        return result;
+    }
+
+    int wait(epoll_event* events, int maxEvents, int millis) override {
+        auto numEvents = reap(events, maxEvents);
+        if (numEvents > 0) {
+            return submit() ? numEvents : -1;
+        }
+        __atomic_store_n(_sqTail, _sqLocalTail, __ATOMIC_RELEASE);
+        __kernel_timespec timeout{millis / 1000, (millis % 1000) * 1000000LL};
+        io_uring_getevents_arg arg{};
+        arg.ts = millis >= 0 ? reinterpret_cast<uint64_t>(&timeout) : 0;
+        auto result = ioUringEnter(_ringFd, unsubmitted(), millis == 0 ? 0 : 1,
+                                   IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+        if (result == -1 && errno != ETIME && errno != EBUSY) {
+            return -1;
+        }
+        return reap(events, maxEvents);
+    }
+
+    bool submit() override {
+        if (unsubmitted() == 0) {
+            return true;
+        }
+        __atomic_store_n(_sqTail, _sqLocalTail, __ATOMIC_RELEASE);
+        return ioUringEnter(_ringFd, unsubmitted(), 0, 0, nullptr, 0) != -1;
+    }
+};
+
+}
+
+std::unique_ptr<Poller> makeIoUringPoller() {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+#ifdef IORING_SETUP_COOP_TASKRUN
+    // All submissions come from the loop thread, so there's no need to interrupt it
+    // with an IPI to run completion work: it'll be run next time it enters the kernel.
+    params.flags = IORING_SETUP_COOP_TASKRUN;
+#endif
+    int ringFd = ioUringSetup(RingEntries, &params);
+    if (ringFd == -1 && errno == EINVAL && params.flags) {
+        // Older kernels reject flags they don't know.
+        memset(&params, 0, sizeof(params));
+        ringFd = ioUringSetup(RingEntries, &params);
+    }
+    if (ringFd == -1) {
+        return nullptr;
+    }
+    auto poller = std::make_unique<IoUringPoller>(ringFd);
+    constexpr auto requiredFeatures = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+    if ((params.features & requiredFeatures) != requiredFeatures) {
+        errno = ENOSYS;
+        return nullptr;
+    }
+    if (!poller->map(params)) {
+        return nullptr;
+    }
+    return poller;
+}
+
+}
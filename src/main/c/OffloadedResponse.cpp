@@ -0,0 +1,237 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/OffloadedResponse.h"
+#include "internal/RaiiFd.h"
+#include "internal/WorkerPool.h"
+
+#include "seasocks/PageHandler.h"
+#include "seasocks/Request.h"
+#include "seasocks/Server.h"
+
+#include <fcntl.h>
+
+#include <stdexcept>
+
+namespace seasocks {
+
+OffloadedResponse::OffloadedResponse(Server& server, WorkerPool& pool, std::shared_ptr<Request> request,
+                                     const Handlers& handlers, size_t firstHandler)
+        : _server(server), _pool(pool), _request(std::move(request)),
+          _handlers(handlers), _firstHandler(firstHandler), _active(true),
+          _cancelled(false) {
+}
+
+void OffloadedResponse::handle(std::shared_ptr<ResponseWriter> writer) {
+    _writer = std::move(writer);
+    _pool.submit(Task([self = shared_from_this()] { self->run(); }));
+}
+
+void OffloadedResponse::cancel() {
+    _active.store(false, std::memory_order_release);
+    _writer.reset();
+    std::shared_ptr<Response> response;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _cancelled = true;
+        response = std::move(_response);
+    }
+    if (response) {
+        // It's running on the pool, so hear about it there too.
+        _pool.submit(Task([response = std::move(response)] { response->cancel(); }));
+    }
+}
+
+void OffloadedResponse::run() {
+    for (auto i = _firstHandler; i < _handlers.size(); ++i) {
+        auto& handler = *_handlers[i];
+        if (!handler.offloaded()) {
+            continueFrom(i);
+            return;
+        }
+        if (!isActive()) {
+            return;
+        }
+        std::shared_ptr<Response> response;
+        try {
+            response = handler.handle(*_request);
+        } catch (const std::exception& e) {
+            error(ResponseCode::InternalServerError, e.what());
+            return;
+        } catch (...) {
+            error(ResponseCode::InternalServerError, "(unknown)");
+            return;
+        }
+        if (response == Response::unhandled()) {
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_cancelled) {
+                return;
+            }
+            _response = response;
+        }
+        try {
+            response->handle(shared_from_this());
+        } catch (const std::exception& e) {
+            error(ResponseCode::InternalServerError, e.what());
+        } catch (...) {
+            error(ResponseCode::InternalServerError, "(unknown)");
+        }
+        return;
+    }
+    continueFrom(_handlers.size());
+}
+
+void OffloadedResponse::continueFrom(size_t nextHandler) {
+    Call call{Op::Continue};
+    call.nextHandler = nextHandler;
+    record(call, true);
+}
+
+void OffloadedResponse::begin(ResponseCode responseCode, TransferEncoding encoding) {
+    Call call{Op::Begin};
+    call.responseCode = responseCode;
+    call.encoding = encoding;
+    record(call, false);
+}
+
+void OffloadedResponse::header(const std::string& header, const std::string& value) {
+    record(Call{Op::Header}, false, header.data(), header.size(), value);
+}
+
+void OffloadedResponse::payload(const void* data, size_t size, bool flush) {
+    Call call{Op::Payload};
+    call.flag = flush;
+    record(call, flush, data, size);
+}
+
+void OffloadedResponse::payloadFile(int fd, uint64_t offset, size_t length, bool flush) {
+    Call call{Op::PayloadFile};
+    call.file = std::make_shared<RaiiFd>(::fcntl(fd, F_DUPFD_CLOEXEC, 0));
+    if (!call.file->ok()) {
+        ResponseWriter::payloadFile(fd, offset, length, flush);
+        return;
+    }
+    call.flag = flush;
+    call.fileOffset = offset;
+    call.fileLength = length;
+    record(std::move(call), flush);
+}
+
+void OffloadedResponse::finish(bool keepConnectionOpen) {
+    Call call{Op::Finish};
+    call.flag = keepConnectionOpen;
+    record(call, true);
+}
+
+void OffloadedResponse::error(ResponseCode responseCode, const std::string& payload) {
+    Call call{Op::Error};
+    call.responseCode = responseCode;
+    record(call, true, payload.data(), payload.size());
+}
+
+bool OffloadedResponse::isActive() const {
+    return _active.load(std::memory_order_acquire);
+}
+
+void OffloadedResponse::record(Call call, bool flush, const void* data, size_t length, const std::string& value) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_cancelled) {
+            return;
+        }
+        call.offset = _data.size();
+        call.length = length;
+        call.valueLength = value.size();
+        if (length) {
+            _data.append(static_cast<const char*>(data), length);
+        }
+        _data += value;
+        _calls.push_back(std::move(call));
+        if (!flush || _pendingApply) {
+            return;
+        }
+        _pendingApply = shared_from_this();
+    }
+    // Capturing only 'this' keeps the std::function - and so the queued task - free of allocation.
+    _server.execute([this] { apply(); });
+}
+
+void OffloadedResponse::apply() {
+    std::shared_ptr<OffloadedResponse> self;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _applying.swap(_calls);
+        _applyingData.swap(_data);
+        self = std::move(_pendingApply);
+    }
+    for (const auto& call : _applying) {
+        if (!_writer) {
+            break;
+        }
+        const char* data = _applyingData.data() + call.offset;
+        switch (call.op) {
+        case Op::Begin:
+            _writer->begin(call.responseCode, call.encoding);
+            break;
+        case Op::Header:
+            _writer->header(std::string(data, call.length), std::string(data + call.length, call.valueLength));
+            break;
+        case Op::Payload:
+            _writer->payload(data, call.length, call.flag);
+            break;
+        case Op::PayloadFile:
+            _writer->payloadFile(*call.file, call.fileOffset, call.fileLength, call.flag);
+            break;
+        case Op::Finish:
+        case Op::Error:
+        case Op::Continue: {
+            // The connection's writer moves on to its next response after these.
+            auto writer = std::move(_writer);
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _cancelled = true;
+                _response.reset();
+            }
+            if (call.op == Op::Finish) {
+                writer->finish(call.flag);
+            } else if (call.op == Op::Error) {
+                writer->error(call.responseCode, std::string(data, call.length));
+            } else if (auto chain = std::dynamic_pointer_cast<HandlerChainWriter>(writer)) {
+                chain->continueHandling(call.nextHandler);
+            } else {
+                writer->error(ResponseCode::NotFound, "Not found");
+            }
+            break;
+        }
+        }
+    }
+    _applying.clear();
+    _applyingData.clear();
+}
+
+}
@@ -0,0 +1,260 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/OutputChain.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace seasocks {
+
+constexpr size_t OutputChain::BlockSize;
+
+struct OutputChain::Block {
+    uint8_t bytes[BlockSize];
+};
+
+namespace {
+
+// Set while this thread's pool exists, in case output is freed as the thread exits.
+thread_local bool blockPoolAlive = false;
+
+// Blocks freed on this thread, kept for reuse up to a limit.
+struct BlockPool {
+    static constexpr size_t MaxBlocks = 256;
+    std::vector<void*> blocks;
+
+    BlockPool() {
+        blockPoolAlive = true;
+    }
+    ~BlockPool() {
+        blockPoolAlive = false;
+        for (auto block : blocks) {
+            ::operator delete(block);
+        }
+    }
+};
+
+thread_local BlockPool blockPool;
+
+}
+
+OutputChain::~OutputChain() {
+    clear();
+}
+
+OutputChain::Block* OutputChain::allocateBlock() {
+    if (blockPool.blocks.empty()) {
+        return static_cast<Block*>(::operator new(sizeof(Block)));
+    }
+    auto block = blockPool.blocks.back();
+    blockPool.blocks.pop_back();
+    return static_cast<Block*>(block);
+}
+
+void OutputChain::releaseBlock(Block* block) {
+    if (blockPoolAlive && blockPool.blocks.size() < BlockPool::MaxBlocks) {
+        blockPool.blocks.push_back(block);
+    } else {
+        ::operator delete(block);
+    }
+}
+
+size_t OutputChain::tailSpace() const {
+    if (_segments.empty() || !_segments.back().block) {
+        return 0;
+    }
+    auto& tail = _segments.back();
+    return tail.block->bytes + BlockSize - (tail.data + tail.size);
+}
+
+void OutputChain::append(const void* data, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    _size += size;
+    while (size) {
+        auto space = tailSpace();
+        if (!space) {
+            auto block = allocateBlock();
+            _segments.push_back({block->bytes, 0, block, nullptr});
+            space = BlockSize;
+        }
+        auto& tail = _segments.back();
+        auto toCopy = std::min(space, size);
+        memcpy(const_cast<uint8_t*>(tail.data) + tail.size, bytes, toCopy);
+        tail.size += toCopy;
+        bytes += toCopy;
+        size -= toCopy;
+    }
+}
+
+uint8_t* OutputChain::reserve(size_t size, size_t& room) {
+    room = tailSpace();
+    if (room < size || !room) {
+        auto block = allocateBlock();
+        _segments.push_back({block->bytes, 0, block, nullptr});
+        room = BlockSize;
+    }
+    auto& tail = _segments.back();
+    return const_cast<uint8_t*>(tail.data) + tail.size;
+}
+
+void OutputChain::commit(size_t size) {
+    _segments.back().size += size;
+    _size += size;
+}
+
+size_t OutputChain::reserveHeader(size_t size) {
+    auto space = tailSpace();
+    if (space < size) {
+        auto block = allocateBlock();
+        _segments.push_back({block->bytes, size, block, nullptr});
+    } else {
+        auto& tail = _segments.back();
+        _segments.push_back({tail.data + tail.size, size, tail.block, nullptr});
+    }
+    _size += size;
+    return _segments.size() - 1;
+}
+
+void OutputChain::setHeader(size_t mark, size_t reserved, const void* header, size_t size) {
+    // The segment carries on past the header with whatever was appended after it.
+    auto& segment = _segments[mark];
+    auto unused = reserved - size;
+    segment.data += unused;
+    segment.size -= unused;
+    _size -= unused;
+    memcpy(const_cast<uint8_t*>(segment.data), header, size);
+}
+
+void OutputChain::truncate(size_t size) {
+    while (_size > size) {
+        auto& tail = _segments.back();
+        auto excess = _size - size;
+        if (excess < tail.size) {
+            tail.size -= excess;
+            if (tail.fd != -1) {
+                _fileBytes -= excess;
+            }
+            _size = size;
+            return;
+        }
+        _size -= tail.size;
+        if (tail.fd != -1) {
+            _fileBytes -= tail.size;
+        }
+        if (tail.block && !shareBlock(_segments.size() - 1, _segments.size() - 2)) {
+            releaseBlock(tail.block);
+        }
+        _segments.pop_back();
+    }
+}
+
+bool OutputChain::shareBlock(size_t a, size_t b) const {
+    return a < _segments.size() && b < _segments.size() && _segments[a].block == _segments[b].block;
+}
+
+void OutputChain::appendBorrowed(const void* data, size_t size, std::shared_ptr<const void> owner) {
+    if (!size) {
+        return;
+    }
+    _segments.push_back({static_cast<const uint8_t*>(data), size, nullptr, std::move(owner)});
+    _size += size;
+}
+
+void OutputChain::appendFile(int fd, uint64_t offset, size_t size, std::shared_ptr<const void> owner) {
+    if (!size) {
+        return;
+    }
+    _segments.push_back({nullptr, size, nullptr, std::move(owner), fd, offset});
+    _size += size;
+    _fileBytes += size;
+}
+
+int OutputChain::gather(iovec* iov, int maxIovecs) const {
+    int count = 0;
+    for (auto it = _segments.begin(); it != _segments.end() && it->fd == -1 && count < maxIovecs; ++it) {
+        iov[count++] = {const_cast<uint8_t*>(it->data), it->size};
+    }
+    return count;
+}
+
+size_t OutputChain::file(size_t index, int& fd, uint64_t& offset) const {
+    if (index >= _segments.size() || _segments[index].fd == -1) {
+        return 0;
+    }
+    auto& segment = _segments[index];
+    fd = segment.fd;
+    offset = segment.fileOffset;
+    return segment.size;
+}
+
+bool OutputChain::borrowed(size_t index, std::shared_ptr<const void>& owner) const {
+    auto& segment = _segments[index];
+    if (segment.block || segment.fd != -1) {
+        return false;
+    }
+    owner = segment.owner;
+    return true;
+}
+
+void OutputChain::consume(size_t bytes) {
+    bytes = std::min(bytes, _size);
+    _size -= bytes;
+    while (bytes) {
+        auto& front = _segments.front();
+        if (bytes < front.size) {
+            if (front.fd == -1) {
+                front.data += bytes;
+            } else {
+                front.fileOffset += bytes;
+                _fileBytes -= bytes;
+            }
+            front.size -= bytes;
+            return;
+        }
+        bytes -= front.size;
+        if (front.fd != -1) {
+            _fileBytes -= front.size;
+        }
+        if (front.block && !shareBlock(0, 1)) {
+            releaseBlock(front.block);
+        }
+        _segments.pop_front();
+    }
+}
+
+void OutputChain::clear() {
+    for (size_t i = 0; i < _segments.size(); ++i) {
+        if (_segments[i].block && !shareBlock(i, i + 1)) {
+            releaseBlock(_segments[i].block);
+        }
+    }
+    _segments.clear();
+    _size = 0;
+    _fileBytes = 0;
+}
+
+}
@@ -25,8 +25,11 @@
 
 #include "internal/PageRequest.h"
 
+#include <cctype>
+#include <cerrno>
 #include <cstdlib>
 #include <cstring>
+#include <limits>
 
 namespace seasocks {
 
@@ -35,39 +38,31 @@ PageRequest::PageRequest(
     const std::string& requestUri,
     Server& server,
     Verb verb,
-    HeaderMap&& headers)
+    HeaderStore&& headers)
         : _credentials(std::make_shared<Credentials>()),
           _remoteAddress(remoteAddress),
           _requestUri(requestUri),
           _server(server),
           _verb(verb),
           _headers(std::move(headers)),
-          _contentLength(getUintHeader("Content-Length")) {
+          _contentLength(getUintHeader(KnownHeader::ContentLength)) {
 }
 
-bool PageRequest::consumeContent(std::vector<uint8_t>& buffer) {
-    if (buffer.size() < _contentLength) {
-        return false;
-    }
-    if (buffer.size() == _contentLength) {
-        _content.swap(buffer);
-    } else {
-        _content.assign(buffer.begin(), buffer.begin() + _contentLength);
-        buffer.erase(buffer.begin(), buffer.begin() + _contentLength);
-    }
-    return true;
+void PageRequest::setContent(const uint8_t* content, size_t size, std::shared_ptr<const void> owner) {
+    _content = content;
+    _contentLength = size;
+    _contentOwner = std::move(owner);
 }
 
-size_t PageRequest::getUintHeader(const std::string& name) const {
-    const auto iter = _headers.find(name);
-    if (iter == _headers.end()) {
-        return 0u;
-    }
-    const auto val = std::stoi(iter->second);
-    if (val < 0) {
+size_t PageRequest::getUintHeader(KnownHeader header) const {
+    auto value = std::string(_headers.get(header));
+    if (value.empty() || !isdigit(static_cast<unsigned char>(value[0]))) {
         return 0u;
     }
-    return static_cast<size_t>(val);
+    // Too big to represent is as good as too big to accept.
+    errno = 0;
+    auto result = std::strtoull(value.c_str(), nullptr, 10);
+    return errno == ERANGE ? std::numeric_limits<size_t>::max() : static_cast<size_t>(result);
 }
 
 } // namespace seasocks
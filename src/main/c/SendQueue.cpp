@@ -0,0 +1,109 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/SendQueue.h"
+
+#include "seasocks/Connection.h"
+#include "seasocks/ServerImpl.h"
+
+#include <cassert>
+
+namespace seasocks {
+
+constexpr size_t SendQueue::DefaultCapacity;
+
+SendQueue::SendQueue(ServerImpl& server, Connection& connection, size_t capacity)
+        : _server(server),
+          _connection(&connection),
+          _mask(capacity - 1),
+          _slots(new Message[capacity]),
+          _head{{0}, {}},
+          _tail{{0}, {}},
+          _headCache(0),
+          _scheduled(false),
+          _closed(false) {
+    assert(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+}
+
+bool SendQueue::push(Message& message) {
+    if (closed()) {
+        return false;
+    }
+    auto tail = _tail.value.load(std::memory_order_relaxed);
+    if (tail - _headCache > _mask) {
+        _headCache = _head.value.load(std::memory_order_acquire);
+        if (tail - _headCache > _mask) {
+            return false;
+        }
+    }
+    _slots[tail & _mask] = std::move(message);
+    _tail.value.store(tail + 1, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!_scheduled.load(std::memory_order_relaxed) && !_scheduled.exchange(true, std::memory_order_acq_rel)) {
+        schedule();
+    }
+    return true;
+}
+
+void SendQueue::detach() {
+    _connection = nullptr;
+    _closed.store(true, std::memory_order_release);
+}
+
+void SendQueue::schedule() {
+    _scheduled.store(true, std::memory_order_relaxed);
+    _server.post(Task([self = shared_from_this()] { self->drain(); }));
+}
+
+void SendQueue::drain() {
+    if (_connection) {
+        _connection->drainSendQueue();
+    }
+}
+
+bool WebSocket::Sender::send(std::string text) const {
+    auto queue = _queue.lock();
+    if (!queue) {
+        return false;
+    }
+    SendQueue::Message message{false, std::move(text), {}};
+    return queue->push(message);
+}
+
+bool WebSocket::Sender::send(std::vector<uint8_t> binary) const {
+    auto queue = _queue.lock();
+    if (!queue) {
+        return false;
+    }
+    SendQueue::Message message{true, {}, std::move(binary)};
+    return queue->push(message);
+}
+
+bool WebSocket::Sender::connected() const {
+    auto queue = _queue.lock();
+    return queue && !queue->closed();
+}
+
+}
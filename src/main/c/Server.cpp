@@ -24,25 +24,37 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include "internal/Config.h"
+#include "internal/ConnectionTable.h"
+#include "internal/ExecutorQueue.h"
+#include "internal/HybiFrame.h"
+#include "internal/HybiPacketDecoder.h"
 #include "internal/LogStream.h"
+#include "internal/OffloadedResponse.h"
+#include "internal/Poller.h"
+#include "internal/TimerWheel.h"
+#include "internal/TopicRegistry.h"
+#include "internal/WorkerPool.h"
+#include "internal/ZeroCopySends.h"
 
 #include "seasocks/Connection.h"
 #include "seasocks/Logger.h"
 #include "seasocks/Server.h"
 #include "seasocks/PageHandler.h"
 #include "seasocks/StringUtil.h"
+#include "seasocks/ToString.h"
 #include "seasocks/util/Json.h"
 
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 
-#include <sys/epoll.h>
 #include <sys/eventfd.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/syscall.h>
+#include <sys/timerfd.h>
 #include <sys/un.h>
 
+#include <algorithm>
 #include <memory>
 #include <stdexcept>
 #include <cstring>
@@ -88,32 +100,57 @@ std::ostream& operator<<(std::ostream& o, const EventBits& b) {
     return o;
 }
 
-constexpr int EpollTimeoutMillis = 500; // Twice a second is ample.
 constexpr int DefaultLameConnectionTimeoutSeconds = 10;
+constexpr size_t ExecutableBatchSize = 1024;
+// How long a closed connection's zero-copy sends have to complete before the
+// connection is reset.
+constexpr auto ZeroCopyLingerTimeout = std::chrono::seconds(30);
 
 }
 
 namespace seasocks {
 
 pid_t gettid() {
-    return static_cast<pid_t>(syscall(SYS_gettid));
+    // Cached, as checkThread() is called on every send.
+    static thread_local pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+    return tid;
 }
 
 constexpr size_t Server::DefaultClientBufferSize;
+constexpr size_t Server::DefaultPipelineDepth;
+constexpr size_t Server::DefaultMaxRequestBodySize;
+constexpr size_t Server::AutoCorkFlushBytes;
 
 Server::Server(std::shared_ptr<Logger> logger)
-        : _logger(logger), _listenSock(-1), _epollFd(-1), _eventFd(-1),
-          _maxKeepAliveDrops(0),
-          _lameConnectionTimeoutSeconds(DefaultLameConnectionTimeoutSeconds),
-          _clientBufferSize(DefaultClientBufferSize),
-          _nextDeadConnectionCheck(0), _threadId(0), _terminate(false),
-          _expectedTerminate(false) {
-
-    _epollFd = epoll_create(10);
-    if (_epollFd == -1) {
-        LS_ERROR(_logger, "Unable to create epoll: " << getLastError());
-        return;
-    }
+        : Server(logger, nullptr, 0) {
+}
+
+Server::Server(std::shared_ptr<Logger> logger, Server* root, size_t reactorIndex)
+        : _connections(std::make_unique<ConnectionTable>()),
+          _logger(logger), _listenSock(-1), _eventFd(-1),
+          _maxKeepAliveDrops(root ? root->_maxKeepAliveDrops : 0),
+          _lameConnectionTimeoutSeconds(root ? root->_lameConnectionTimeoutSeconds : DefaultLameConnectionTimeoutSeconds),
+          _clientBufferSize(root ? root->_clientBufferSize : DefaultClientBufferSize),
+          _pipelineDepth(root ? root->_pipelineDepth : DefaultPipelineDepth),
+          _requestBodySpillThreshold(root ? root->_requestBodySpillThreshold : 0),
+          _maxRequestBodySize(root ? root->_maxRequestBodySize : DefaultMaxRequestBodySize),
+          _nowMillis(0), _timerFd(-1), _timerFdArmedAt(TimerWheel::Never), _timerFdFired(false),
+          _topics(std::make_unique<TopicRegistry>()),
+          _lastFullEventQueueWarning(0),
+          _root(root), _reactorIndex(reactorIndex),
+          _reactorCount(root ? root->_reactorCount : 1),
+          _loopBackend(LoopBackend::Epoll),
+          _edgeTriggered(root ? root->_edgeTriggered : false),
+          _zeroCopyThreshold(root ? root->_zeroCopyThreshold : 0),
+          _autoCork(root ? root->_autoCork : false),
+          _corkWindow(root ? root->_corkWindow : std::chrono::microseconds::zero()),
+          _corkTimerFd(-1), _corkTimerArmed(false), _corkWindowOver(false),
+          _perMessageDeflateEnabled(root ? root->_perMessageDeflateEnabled : false),
+          _workerThreads(root ? root->_workerThreads : std::max(std::thread::hardware_concurrency(), 1u)),
+          _fileThreads(root ? root->_fileThreads : DefaultFileThreads),
+          _executables(std::make_unique<ExecutorQueue>()), _executorWakeups(0),
+          _threadId(0), _staticPath(root ? root->_staticPath : std::string()),
+          _terminate(false), _expectedTerminate(false) {
 
     _eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
     if (_eventFd == -1) {
@@ -121,23 +158,68 @@ Server::Server(std::shared_ptr<Logger> logger)
         return;
     }
 
-    epoll_event eventWake = {EPOLLIN, {&_eventFd}};
-    if (epoll_ctl(_epollFd, EPOLL_CTL_ADD, _eventFd, &eventWake) == -1) {
-        LS_ERROR(_logger, "Unable to add wake socket to epoll: " << getLastError());
+    _timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (_timerFd == -1) {
+        LS_ERROR(_logger, "Unable to create timer FD: " << getLastError());
         return;
     }
+    updateClock();
+    _timers = std::make_unique<TimerWheel>(_nowMillis);
+
+    if (createPoller(root ? root->_loopBackend : LoopBackend::Epoll) && _corkWindow.count()) {
+        createCorkTimerFd();
+    }
+}
+
+bool Server::createPoller(LoopBackend backend) {
+    std::unique_ptr<Poller> poller;
+    if (backend == LoopBackend::IoUring) {
+        if (!Config::ioUringEnabled) {
+            LS_WARNING(_logger, "Seasocks was compiled without io_uring support, falling back to epoll");
+        } else if (!(poller = makeIoUringPoller())) {
+            LS_WARNING(_logger, "Unable to create io_uring, falling back to epoll: " << getLastError());
+        }
+    }
+    if (!poller) {
+        backend = LoopBackend::Epoll;
+        poller = makeEpollPoller();
+        if (!poller) {
+            LS_ERROR(_logger, "Unable to create epoll: " << getLastError());
+            return false;
+        }
+    }
+    if (!poller->add(_eventFd, EPOLLIN, &_eventFd)) {
+        LS_ERROR(_logger, "Unable to add wake socket to " << poller->name() << ": " << getLastError());
+        return false;
+    }
+    if (!poller->add(_timerFd, EPOLLIN, &_timerFd)) {
+        LS_ERROR(_logger, "Unable to add timer to " << poller->name() << ": " << getLastError());
+        return false;
+    }
+    _poller = std::move(poller);
+    _loopBackend = backend;
+    return true;
 }
 
 Server::~Server() {
     LS_INFO(_logger, "Server destruction");
+    stopReactors();
     shutdown();
-    // Only shut the eventfd and epoll at the very end
+    // Only shut the eventfd and event loop at the very end
     if (_eventFd != -1) {
         close(_eventFd);
     }
-    if (_epollFd != -1) {
-        close(_epollFd);
+    if (_timerFd != -1) {
+        close(_timerFd);
+    }
+    if (_corkTimerFd != -1) {
+        close(_corkTimerFd);
     }
+    _poller.reset();
+}
+
+int Server::fd() const {
+    return _poller ? _poller->fd() : -1;
 }
 
 void Server::shutdown() {
@@ -146,13 +228,19 @@ void Server::shutdown() {
         close(_listenSock);
         _listenSock = -1;
     }
+    _listenPoller.reset();
+    deleteHandedOffConnections();
     // Disconnect and close any current connections.
-    while (!_connections.empty()) {
-        // Deleting the connection closes it and removes it from 'this'.
-        Connection* toBeClosed = _connections.begin()->first;
+    for (auto toBeClosed : _connections->registered()) {
+        // Destroying the connection closes it and removes it from 'this'.
         toBeClosed->setLinger();
-        delete toBeClosed;
+        _connections->destroy(toBeClosed);
     }
+    // Including those left with zero-copy sends in flight.
+    while (!_lingering.empty()) {
+        closeLingering(_lingering.begin()->first, true);
+    }
+    _lingerPoller.reset();
 }
 
 bool Server::makeNonBlocking(int fd) const {
@@ -209,7 +297,7 @@ bool Server::startListening(int port) {
 }
 
 bool Server::startListening(uint32_t ipInHostOrder, int port) {
-    if (_epollFd == -1 || _eventFd == -1) {
+    if (!_poller || _eventFd == -1) {
         LS_ERROR(_logger, "Unable to serve, did not initialize properly.");
         return false;
     }
@@ -227,6 +315,13 @@ bool Server::startListening(uint32_t ipInHostOrder, int port) {
     if (!configureSocket(_listenSock)) {
         return false;
     }
+    if (_reactorCount > 1) {
+        const int yesPlease = 1;
+        if (setsockopt(_listenSock, SOL_SOCKET, SO_REUSEPORT, &yesPlease, sizeof(yesPlease)) == -1) {
+            LS_ERROR(_logger, "Unable to set reuse port socket option: " << getLastError());
+            return false;
+        }
+    }
     sockaddr_in sock;
     memset(&sock, 0, sizeof(sock));
     sock.sin_port = htons(port16);
@@ -240,15 +335,15 @@ bool Server::startListening(uint32_t ipInHostOrder, int port) {
         LS_ERROR(_logger, "Unable to listen on socket: " << getLastError());
         return false;
     }
-    epoll_event event = {EPOLLIN, {this}};
-    if (epoll_ctl(_epollFd, EPOLL_CTL_ADD, _listenSock, &event) == -1) {
-        LS_ERROR(_logger, "Unable to add listen socket to epoll: " << getLastError());
+    if (!_poller->add(_listenSock, EPOLLIN, this)) {
+        LS_ERROR(_logger, "Unable to add listen socket to " << _poller->name() << ": " << getLastError());
         return false;
     }
 
     char buf[1024];
     ::gethostname(buf, sizeof(buf));
-    LS_INFO(_logger, "Listening on http://" << buf << ":" << port << "/");
+    LS_INFO(_logger, "Listening on http://" << buf << ":" << port << "/"
+                                            << (_reactorIndex ? " (reactor " + toString(_reactorIndex) + ")" : ""));
 
     return true;
 }
@@ -256,6 +351,11 @@ bool Server::startListening(uint32_t ipInHostOrder, int port) {
 bool Server::startListeningUnix(const char* socketPath) {
     struct sockaddr_un sock;
 
+    if (!_poller || _eventFd == -1) {
+        LS_ERROR(_logger, "Unable to serve, did not initialize properly.");
+        return false;
+    }
+
     _listenSock = socket(AF_UNIX, SOCK_STREAM, 0);
     if (_listenSock == -1) {
         LS_ERROR(_logger, "Unable to create unix listen socket: " << getLastError());
@@ -279,9 +379,9 @@ bool Server::startListeningUnix(const char* socketPath) {
         return false;
     }
 
-    epoll_event event = {EPOLLIN, {this}};
-    if (epoll_ctl(_epollFd, EPOLL_CTL_ADD, _listenSock, &event) == -1) {
-        LS_ERROR(_logger, "Unable to add unix listen socket to epoll: " << getLastError());
+    // Other reactors will share this socket's accept queue (see listenAlongside).
+    if (!(_reactorCount > 1 ? addSharedListenSock() : _poller->add(_listenSock, EPOLLIN, this))) {
+        LS_ERROR(_logger, "Unable to add unix listen socket to " << _poller->name() << ": " << getLastError());
         return false;
     }
 
@@ -290,6 +390,48 @@ bool Server::startListeningUnix(const char* socketPath) {
     return true;
 }
 
+bool Server::listenAlongside(const Server& root) {
+    sockaddr_storage address;
+    socklen_t addressLen = sizeof(address);
+    if (getsockname(root._listenSock, reinterpret_cast<sockaddr*>(&address), &addressLen) == -1) {
+        LS_ERROR(_logger, "Unable to determine listening address: " << getLastError());
+        return false;
+    }
+    if (address.ss_family == AF_INET) {
+        // Bind our own socket to the same (resolved) address; SO_REUSEPORT has the
+        // kernel balance new connections between the reactors' accept queues.
+        auto& inet = reinterpret_cast<const sockaddr_in&>(address);
+        return startListening(ntohl(inet.sin_addr.s_addr), ntohs(inet.sin_port));
+    }
+    // Unix domain sockets can't be sharded, so share the root's accept queue.
+    _listenSock = ::dup(root._listenSock);
+    if (_listenSock == -1) {
+        LS_ERROR(_logger, "Unable to duplicate listen socket: " << getLastError());
+        return false;
+    }
+    if (!addSharedListenSock()) {
+        LS_ERROR(_logger, "Unable to add shared listen socket to " << _poller->name() << ": " << getLastError());
+        return false;
+    }
+    return true;
+}
+
+bool Server::addSharedListenSock() {
+    // EPOLLEXCLUSIVE wakes only one of the reactors per incoming connection.
+    if (_poller->add(_listenSock, EPOLLIN | EPOLLEXCLUSIVE, this)) {
+        return true;
+    }
+    if (errno != EINVAL) {
+        return false;
+    }
+    // The backend can't wait exclusively (io_uring can't), so it waits on an epoll
+    // set that does instead.
+    _listenPoller = makeEpollPoller();
+    return _listenPoller
+           && _listenPoller->add(_listenSock, EPOLLIN | EPOLLEXCLUSIVE, this)
+           && _poller->add(_listenPoller->fd(), EPOLLIN, this);
+}
+
 void Server::handlePipe() {
     uint64_t dummy;
     while (::read(_eventFd, &dummy, sizeof(dummy)) != -1) {
@@ -303,11 +445,11 @@ void Server::handlePipe() {
 }
 
 Server::NewState Server::handleConnectionEvents(Connection* connection, uint32_t events) {
-    if (events & ~(EPOLLIN | EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+    if (events & ~(EPOLLIN | EPOLLOUT | EPOLLHUP | EPOLLERR | EPOLLRDHUP)) {
         LS_WARNING(_logger, "Got unhandled epoll event (" << EventBits(events) << ") on connection: "
                                                           << formatAddress(connection->getRemoteAddress()));
         return NewState::Close;
-    } else if (events & EPOLLERR) {
+    } else if ((events & EPOLLERR) && !connection->handleErrorQueue()) {
         LS_INFO(_logger, "Error on socket (" << EventBits(events) << "): "
                                              << formatAddress(connection->getRemoteAddress()));
         return NewState::Close;
@@ -319,7 +461,8 @@ Server::NewState Server::handleConnectionEvents(Connection* connection, uint32_t
         if (events & EPOLLOUT) {
             connection->handleDataReadyForWrite();
         }
-        if (events & EPOLLIN) {
+        // A remote hang-up may still have data to be read ahead of it.
+        if (events & (EPOLLIN | EPOLLRDHUP)) {
             connection->handleDataReadyForRead();
         }
     }
@@ -331,22 +474,27 @@ void Server::checkAndDispatchEpoll(int epollMillis) {
     epoll_event events[maxEvents];
 
     std::list<Connection*> toBeDeleted;
-    int numEvents = epoll_wait(_epollFd, events, maxEvents, epollMillis);
+    if (!_deferredReads.empty()) {
+        epollMillis = 0;
+    }
+    int numEvents = _poller->wait(events, maxEvents, epollMillis);
     if (numEvents == -1) {
         if (errno != EINTR) {
-            LS_ERROR(_logger, "Error from epoll_wait: " << getLastError());
+            LS_ERROR(_logger, "Error waiting on " << _poller->name() << ": " << getLastError());
         }
         return;
     }
     if (numEvents == maxEvents) {
-        static time_t lastWarnTime = 0;
         time_t now = time(nullptr);
-        if (now - lastWarnTime >= 60) {
+        if (now - _lastFullEventQueueWarning >= 60) {
             LS_WARNING(_logger, "Full event queue; may start starving connections. "
                                 "Will warn at most once a minute");
-            lastWarnTime = now;
+            _lastFullEventQueueWarning = now;
         }
     }
+    // Reads left over from last pass are done after this pass's events; any
+    // deferred again go round once more.
+    _resumingReads.swap(_deferredReads);
     for (int i = 0; i < numEvents; ++i) {
         if (events[i].data.ptr == this) {
             if (events[i].events & ~EPOLLIN) {
@@ -364,6 +512,12 @@ void Server::checkAndDispatchEpoll(int epollMillis) {
                 break;
             }
             handlePipe();
+        } else if (events[i].data.ptr == &_timerFd) {
+            handleTimerFd();
+        } else if (events[i].data.ptr == &_corkTimerFd) {
+            handleCorkTimerFd();
+        } else if (events[i].data.ptr == &_lingerPoller) {
+            handleLingering();
         } else {
             auto connection = reinterpret_cast<Connection*>(events[i].data.ptr);
             if (handleConnectionEvents(connection, events[i].events) == NewState::Close) {
@@ -371,18 +525,95 @@ void Server::checkAndDispatchEpoll(int epollMillis) {
             }
         }
     }
+    while (!_resumingReads.empty()) {
+        auto connection = _resumingReads.back();
+        _resumingReads.pop_back();
+        connection->handleDataReadyForRead();
+    }
+    flushDeferred();
     // The connections are all deleted at the end so we've processed any other subject's
     // closes etc before we call onDisconnect().
     for (auto connection : toBeDeleted) {
-        if (_connections.find(connection) == _connections.end()) {
+        if (!_connections->find(connection)) {
             LS_SEVERE(_logger, "Attempt to delete connection we didn't know about: " << (void*) connection
                                                                                      << formatAddress(connection->getRemoteAddress()));
             _terminate = true;
             break;
         }
         LS_DEBUG(_logger, "Deleting connection: " << formatAddress(connection->getRemoteAddress()));
-        delete connection;
+        _connections->destroy(connection);
+    }
+    deleteHandedOffConnections();
+    // Run expired timers now, rather than next time round: if we're driven by poll()
+    // nothing may prompt another call until they have.
+    if (_timerFdFired) {
+        runTimers();
+        flushDeferred();
+    }
+}
+
+void Server::deleteHandedOffConnections() {
+    for (auto connection : _handedOff) {
+        _connections->destroy(connection);
+    }
+    _handedOff.clear();
+}
+
+void Server::lingerZeroCopy(int fd, std::unique_ptr<ZeroCopySends> sends) {
+    checkThread();
+    // Send the FIN closing would have, once the data queued ahead of it is out.
+    ::shutdown(fd, SHUT_WR);
+    auto& lingering = _lingering[fd];
+    lingering = {fd, std::move(sends), 0};
+    if (!_lingerPoller) {
+        _lingerPoller = makeEpollPoller();
+        if (_lingerPoller && !_poller->add(_lingerPoller->fd(), EPOLLIN, &_lingerPoller)) {
+            _lingerPoller.reset();
+        }
+    }
+    // Completions are reported as errors. Edge triggered, so a hang-up isn't
+    // reported over and over while they're awaited.
+    if (!_lingerPoller || !_lingerPoller->add(fd, EPOLLET, &lingering)) {
+        LS_WARNING(_logger, "Unable to wait for zero-copy sends on closing socket: " << getLastError());
+        closeLingering(fd, true);
+        return;
+    }
+    lingering.timer = schedule(ZeroCopyLingerTimeout, [this, fd] {
+        LS_INFO(_logger, "Resetting closed socket whose zero-copy sends haven't completed");
+        closeLingering(fd, true);
+    });
+}
+
+void Server::handleLingering() {
+    constexpr int maxEvents = 64;
+    epoll_event events[maxEvents];
+    auto numEvents = _lingerPoller->wait(events, maxEvents, 0);
+    for (int i = 0; i < numEvents; ++i) {
+        auto lingering = static_cast<LingeringSocket*>(events[i].data.ptr);
+        lingering->sends->reap(lingering->fd);
+        if (lingering->sends->empty()) {
+            closeLingering(lingering->fd, false);
+        }
+    }
+}
+
+void Server::closeLingering(int fd, bool reset) {
+    auto it = _lingering.find(fd);
+    if (it == _lingering.end()) {
+        return;
+    }
+    if (_lingerPoller) {
+        _lingerPoller->remove(fd);
+    }
+    _timers->cancel(it->second.timer);
+    if (reset) {
+        // A reset discards whatever the kernel has yet to send, so it no longer
+        // needs the buffers, and the pages it still holds it has pinned itself.
+        struct linger linger = {true, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
     }
+    ::close(fd);
+    _lingering.erase(it);
 }
 
 void Server::setStaticPath(const char* staticPath) {
@@ -408,22 +639,35 @@ bool Server::loop() {
     // Stash away "the" server thread id.
     _threadId = gettid();
 
+    if (!startReactors()) {
+        stopReactors();
+        shutdown();
+        return false;
+    }
+
     while (!_terminate) {
         // Always process events first to catch start up events.
         processEventQueue();
-        checkAndDispatchEpoll(EpollTimeoutMillis);
+        // Timers wake us via the timerfd, so there's no need for a timeout.
+        checkAndDispatchEpoll(-1);
     }
     // Reasonable effort to ensure anything enqueued during terminate has a chance to run.
     processEventQueue();
     LS_INFO(_logger, "Server terminating");
+    stopReactors();
     shutdown();
     return _expectedTerminate;
 }
 
 Server::PollResult Server::poll(int millis) {
-    // Grab the thread ID on the first poll.
-    if (_threadId == 0)
+    // Grab the thread ID on the first poll, and start any other reactors.
+    if (_threadId == 0) {
         _threadId = gettid();
+        if (_listenSock != -1 && !startReactors()) {
+            stopReactors();
+            return PollResult::Error;
+        }
+    }
     if (_threadId != gettid()) {
         LS_ERROR(_logger, "poll() called from the wrong thread");
         return PollResult::Error;
@@ -434,12 +678,19 @@ Server::PollResult Server::poll(int millis) {
     }
     processEventQueue();
     checkAndDispatchEpoll(millis);
-    if (!_terminate)
+    if (!_terminate) {
+        // Make sure fd() will signal for anything registered during this poll.
+        if (!_poller->submit()) {
+            LS_ERROR(_logger, "Unable to submit to " << _poller->name() << ": " << getLastError());
+            return PollResult::Error;
+        }
         return PollResult::Continue;
+    }
 
     // Reasonable effort to ensure anything enqueued during terminate has a chance to run.
     processEventQueue();
     LS_INFO(_logger, "Server terminating");
+    stopReactors();
     shutdown();
 
     return _expectedTerminate ? PollResult::Terminated : PollResult::Error;
@@ -447,32 +698,227 @@ Server::PollResult Server::poll(int millis) {
 
 void Server::processEventQueue() {
     runExecutables();
-    time_t now = time(nullptr);
-    if (now < _nextDeadConnectionCheck)
+    runTimers();
+    flushDeferred();
+}
+
+void Server::updateClock() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    _nowMillis = static_cast<uint64_t>(now.tv_sec) * 1000 + static_cast<uint64_t>(now.tv_nsec) / 1000000;
+}
+
+void Server::runTimers() {
+    updateClock();
+    if (_timerFdFired) {
+        // The coarse clock can lag the one the timerfd uses by a tick or so; it
+        // having fired is proof enough we've reached the time it was set for.
+        _nowMillis = std::max(_nowMillis, _timerFdArmedAt);
+        _timerFdFired = false;
+        _timerFdArmedAt = TimerWheel::Never;
+    }
+    _timers->advance(_nowMillis);
+    armTimerFd();
+}
+
+void Server::armTimerFd() {
+    auto next = _timers->nextTick();
+    if (next == _timerFdArmedAt) {
         return;
-    std::list<Connection*> toRemove;
-    for (auto _connection : _connections) {
-        time_t numSecondsSinceConnection = now - _connection.second;
-        auto connection = _connection.first;
-        if (connection->bytesReceived() == 0 && numSecondsSinceConnection >= _lameConnectionTimeoutSeconds) {
-            LS_INFO(_logger, formatAddress(connection->getRemoteAddress())
-                                 << " : Killing lame connection - no bytes received after "
-                                 << numSecondsSinceConnection << "s");
-            toRemove.push_back(connection);
+    }
+    // An all-zero time disarms it.
+    itimerspec spec{};
+    if (next != TimerWheel::Never) {
+        spec.it_value.tv_sec = static_cast<time_t>(next / 1000);
+        spec.it_value.tv_nsec = static_cast<long>(next % 1000) * 1000000;
+    }
+    if (timerfd_settime(_timerFd, TFD_TIMER_ABSTIME, &spec, nullptr) == -1) {
+        LS_ERROR(_logger, "Unable to set timer: " << getLastError());
+        return;
+    }
+    _timerFdArmedAt = next;
+}
+
+void Server::handleTimerFd() {
+    uint64_t expirations;
+    if (::read(_timerFd, &expirations, sizeof(expirations)) == -1) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            LS_ERROR(_logger, "Error from timer FD read: " << getLastError());
         }
+        return;
+    }
+    _timerFdFired = true;
+}
+
+bool Server::createCorkTimerFd() {
+    _corkTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (_corkTimerFd == -1) {
+        LS_ERROR(_logger, "Unable to create cork timer FD: " << getLastError());
+        return false;
     }
-    for (auto& it : toRemove) {
-        delete it;
+    if (!_poller->add(_corkTimerFd, EPOLLIN, &_corkTimerFd)) {
+        LS_ERROR(_logger, "Unable to add cork timer to " << _poller->name() << ": " << getLastError());
+        close(_corkTimerFd);
+        _corkTimerFd = -1;
+        return false;
     }
+    return true;
+}
+
+void Server::handleCorkTimerFd() {
+    uint64_t expirations;
+    if (::read(_corkTimerFd, &expirations, sizeof(expirations)) == -1) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            LS_ERROR(_logger, "Error from cork timer FD read: " << getLastError());
+        }
+        return;
+    }
+    _corkWindowOver = true;
+}
+
+void Server::deferFlush(Connection* connection) {
+    _deferredFlushes.push_back(connection);
+}
+
+void Server::cancelDeferredFlush(Connection* connection) {
+    _deferredFlushes.erase(std::remove(_deferredFlushes.begin(), _deferredFlushes.end(), connection),
+                           _deferredFlushes.end());
+}
+
+void Server::deferRead(Connection* connection) {
+    if (_deferredReads.empty()) {
+        // The poll() API leaves waiting to the caller, so make sure it wakes.
+        signalEventFd();
+    }
+    _deferredReads.push_back(connection);
+}
+
+void Server::cancelDeferredRead(Connection* connection) {
+    _deferredReads.erase(std::remove(_deferredReads.begin(), _deferredReads.end(), connection),
+                         _deferredReads.end());
+    _resumingReads.erase(std::remove(_resumingReads.begin(), _resumingReads.end(), connection),
+                         _resumingReads.end());
+}
+
+void Server::flushDeferred() {
+    if (_deferredFlushes.empty()) {
+        _corkWindowOver = false;
+        return;
+    }
+    if (_corkTimerFd != -1 && !_corkWindowOver) {
+        if (_corkTimerArmed) {
+            return;
+        }
+        // Start the window with the first output held back since the last flush.
+        itimerspec spec{};
+        spec.it_value.tv_sec = static_cast<time_t>(_corkWindow.count() / 1000000);
+        spec.it_value.tv_nsec = static_cast<long>(_corkWindow.count() % 1000000) * 1000;
+        if (timerfd_settime(_corkTimerFd, 0, &spec, nullptr) != -1) {
+            _corkTimerArmed = true;
+            return;
+        }
+        LS_ERROR(_logger, "Unable to set cork timer: " << getLastError());
+    }
+    _corkTimerArmed = false;
+    _corkWindowOver = false;
+    // Flushing never defers anything further, so the list is stable.
+    for (auto connection : _deferredFlushes) {
+        connection->flushDeferred();
+    }
+    _deferredFlushes.clear();
+}
+
+Server::TimerId Server::schedule(std::chrono::milliseconds delay, Executable fn) {
+    if (_threadId != 0) {
+        checkThread();
+    }
+    auto millis = std::max(delay.count(), decltype(delay.count())(0));
+    auto id = _timers->schedule(_nowMillis + static_cast<uint64_t>(millis), Task(std::move(fn)));
+    armTimerFd();
+    return id;
+}
+
+bool Server::cancel(TimerId timer) {
+    if (_threadId != 0) {
+        checkThread();
+    }
+    // Leave the timerfd be: at worst it wakes us for nothing.
+    return _timers->cancel(timer);
+}
+
+void Server::subscribe(WebSocket* socket, const std::string& topic) {
+    auto connection = dynamic_cast<Connection*>(socket);
+    if (!connection) {
+        LS_ERROR(_logger, "Can only subscribe Seasocks' own WebSockets to topics");
+        return;
+    }
+    auto& owner = connection->server();
+    owner.checkThread();
+    owner._topics->subscribe(connection, topic);
+}
+
+void Server::unsubscribe(WebSocket* socket, const std::string& topic) {
+    auto connection = dynamic_cast<Connection*>(socket);
+    if (!connection) {
+        return;
+    }
+    auto& owner = connection->server();
+    owner.checkThread();
+    owner._topics->unsubscribe(connection, topic);
+}
+
+void Server::publish(const std::string& topic, const std::string& text) {
+    publishFrame(topic, SharedFrame::encode(static_cast<uint8_t>(HybiPacketDecoder::Opcode::Text),
+                                            text.data(), text.size()));
+}
+
+void Server::publish(const std::string& topic, const uint8_t* data, size_t length) {
+    publishFrame(topic, SharedFrame::encode(static_cast<uint8_t>(HybiPacketDecoder::Opcode::Binary),
+                                            data, length));
+}
+
+void Server::publishFrame(const std::string& topic, std::shared_ptr<const SharedFrame> frame) {
+    if (_threadId != 0) {
+        checkThread();
+    }
+    auto& root = _root ? *_root : *this;
+    for (size_t i = 0; i <= root._reactors.size(); ++i) {
+        auto& target = root.reactor(i);
+        if (&target == this) {
+            deliver(topic, frame);
+        } else {
+            // Other reactors get the same frame, sent from their own threads.
+            target.post(Task([&target, topic, frame] { target.deliver(topic, frame); }));
+        }
+    }
+}
+
+void Server::deliver(const std::string& topic, const std::shared_ptr<const SharedFrame>& frame) {
+    _topics->forEachSubscriber(topic, [&frame](Connection* connection) {
+        connection->sendShared(frame);
+    });
 }
 
 void Server::runExecutables() {
-    decltype(_pendingExecutables) copy;
-    std::unique_lock<decltype(_pendingExecutableMutex)> lock(_pendingExecutableMutex);
-    copy.swap(_pendingExecutables);
-    lock.unlock();
-    for (auto&& ex : copy)
-        ex();
+    // Run a bounded batch so a flood of tasks can't starve the network; if any
+    // are left, wake ourselves to carry on after the next round of events.
+    if (_executables->runBatch(ExecutableBatchSize)) {
+        wake();
+    }
+}
+
+void Server::wake() {
+    _executorWakeups.fetch_add(1, std::memory_order_relaxed);
+    signalEventFd();
+}
+
+void Server::signalEventFd() {
+    uint64_t one = 1;
+    if (_eventFd != -1 && ::write(_eventFd, &one, sizeof(one)) == -1) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            LS_ERROR(_logger, "Unable to post a wake event: " << getLastError());
+        }
+    }
 }
 
 void Server::handleAccept() {
@@ -482,7 +928,10 @@ void Server::handleAccept() {
                       reinterpret_cast<sockaddr*>(&address),
                       &addrLen);
     if (fd == -1) {
-        LS_ERROR(_logger, "Unable to accept: " << getLastError());
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            // Another reactor sharing the listen socket may have beaten us to it.
+            LS_ERROR(_logger, "Unable to accept: " << getLastError());
+        }
         return;
     }
     if (!configureSocket(fd)) {
@@ -490,39 +939,159 @@ void Server::handleAccept() {
         return;
     }
     LS_INFO(_logger, formatAddress(address) << " : Accepted on descriptor " << fd);
-    Connection* newConnection = new Connection(_logger, *this, fd, address);
-    epoll_event event = {EPOLLIN, {newConnection}};
-    if (epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &event) == -1) {
-        LS_ERROR(_logger, "Unable to add socket to epoll: " << getLastError());
-        delete newConnection;
-        ::close(fd);
+    auto newConnection = _connections->create(_logger, *this, fd, address);
+    if (!_poller->add(fd, connectionEvents(), newConnection)) {
+        LS_ERROR(_logger, "Unable to add socket to " << _poller->name() << ": " << getLastError());
+        // Closes the socket.
+        _connections->destroy(newConnection);
         return;
     }
-    _connections.insert(std::make_pair(newConnection, time(nullptr)));
+    addConnection(newConnection);
 }
 
-void Server::remove(Connection* connection) {
-    checkThread();
-    epoll_event event = {0, {connection}};
-    if (epoll_ctl(_epollFd, EPOLL_CTL_DEL, connection->getFd(), &event) == -1) {
-        LS_ERROR(_logger, "Unable to remove from epoll: " << getLastError());
+void Server::adopt(int fd, const sockaddr_in& address, std::vector<uint8_t>&& input,
+                   std::unique_ptr<ZeroCopySends> zeroCopySends) {
+    LS_DEBUG(_logger, formatAddress(address) << " : Adopted descriptor " << fd << " on reactor " << _reactorIndex);
+    auto newConnection = _connections->create(_logger, *this, fd, address);
+    if (!_poller->add(fd, connectionEvents(), newConnection)) {
+        LS_ERROR(_logger, "Unable to add adopted socket to " << _poller->name() << ": " << getLastError());
+        _connections->destroy(newConnection);
+        return;
     }
-    _connections.erase(connection);
+    addConnection(newConnection);
+    newConnection->replayInput(std::move(input), std::move(zeroCopySends));
+}
+
+void Server::addConnection(Connection* connection) {
+    auto handle = _connections->add(connection, time(nullptr));
+    auto timeout = _lameConnectionTimeoutSeconds;
+    auto lameTimer = schedule(std::chrono::seconds(timeout), [this, handle, timeout] {
+        auto entry = _connections->find(handle);
+        if (entry && entry->connection->bytesReceived() == 0) {
+            LS_INFO(_logger, formatAddress(entry->connection->getRemoteAddress())
+                                 << " : Killing lame connection - no bytes received after "
+                                 << timeout << "s");
+            _connections->destroy(entry->connection);
+        }
+    });
+    _connections->find(handle)->lameTimer = lameTimer;
+}
+
+bool Server::runsOnThisReactor(const WebSocket::Handler& handler) const {
+    return _reactorCount == 1 || handler.runsOnReactor(_reactorIndex);
 }
 
-bool Server::subscribeToWriteEvents(Connection* connection) {
-    epoll_event event = {EPOLLIN | EPOLLOUT, {connection}};
-    if (epoll_ctl(_epollFd, EPOLL_CTL_MOD, connection->getFd(), &event) == -1) {
-        LS_ERROR(_logger, "Unable to subscribe to write events: " << getLastError());
+bool Server::handOff(Connection* connection, const WebSocket::Handler& handler,
+                     std::vector<uint8_t>&& input) {
+    checkThread();
+    auto& rootServer = const_cast<Server&>(root());
+    // Spread connections over the permitted reactors, starting from a point chosen by fd.
+    Server* target = nullptr;
+    for (size_t i = 0; i < _reactorCount && !target; ++i) {
+        auto index = (static_cast<size_t>(connection->getFd()) + i) % _reactorCount;
+        if (index != _reactorIndex && handler.runsOnReactor(index)) {
+            target = &rootServer.reactor(index);
+        }
+    }
+    if (!target) {
+        LS_WARNING(_logger, "No reactor will accept connection for '" << connection->getRequestUri() << "'");
+        return false;
+    }
+    if (!_poller->remove(connection->getFd())) {
+        LS_ERROR(_logger, "Unable to remove from " << _poller->name() << ": " << getLastError());
         return false;
     }
+    auto address = connection->getRemoteAddress();
+    // Shared, as tasks have to be copyable.
+    auto zeroCopySends = std::make_shared<std::unique_ptr<ZeroCopySends>>();
+    int fd = connection->releaseFd(*zeroCopySends);
+    forgetConnection(connection);
+    _handedOff.push_back(connection);
+    LS_DEBUG(_logger, formatAddress(address) << " : Handing off to reactor " << target->_reactorIndex);
+    target->execute([target, fd, address, input = std::move(input), zeroCopySends]() mutable {
+        target->adopt(fd, address, std::move(input), std::move(*zeroCopySends));
+    });
+    return true;
+}
+
+Server& Server::reactor(size_t index) {
+    return index == 0 ? *this : *_reactors[index - 1];
+}
+
+bool Server::startReactors() {
+    if (_root || _reactorCount == 1 || !_reactors.empty()) {
+        return true;
+    }
+    for (size_t index = 1; index < _reactorCount; ++index) {
+        std::unique_ptr<Server> reactor(new Server(_logger, this, index));
+        if (!reactor->_poller || reactor->_eventFd == -1 || !reactor->listenAlongside(*this)) {
+            LS_ERROR(_logger, "Unable to start reactor " << index);
+            return false;
+        }
+        _reactors.emplace_back(std::move(reactor));
+    }
+    for (auto& reactor : _reactors) {
+        auto reactorPtr = reactor.get();
+        _reactorThreads.emplace_back([reactorPtr] {
+            reactorPtr->loop();
+        });
+    }
+    LS_INFO(_logger, "Started " << _reactorCount << " reactors");
     return true;
 }
 
-bool Server::unsubscribeFromWriteEvents(Connection* connection) {
-    epoll_event event = {EPOLLIN, {connection}};
-    if (epoll_ctl(_epollFd, EPOLL_CTL_MOD, connection->getFd(), &event) == -1) {
-        LS_ERROR(_logger, "Unable to unsubscribe from write events: " << getLastError());
+void Server::stopReactors() {
+    for (auto& reactor : _reactors) {
+        reactor->terminate();
+    }
+    for (auto& thread : _reactorThreads) {
+        thread.join();
+    }
+    _reactorThreads.clear();
+    // Let offloaded handlers finish while the reactors they write to still exist.
+    if (_workerPool) {
+        _workerPool->stop();
+    }
+    if (_filePool) {
+        _filePool->stop();
+    }
+    _reactors.clear();
+}
+
+void Server::remove(Connection* connection) {
+    checkThread();
+    if (!_poller->remove(connection->getFd())) {
+        LS_ERROR(_logger, "Unable to remove from " << _poller->name() << ": " << getLastError());
+    }
+    forgetConnection(connection);
+}
+
+void Server::forgetConnection(Connection* connection) {
+    ConnectionTable::Entry removed;
+    if (_connections->remove(connection, removed)) {
+        _timers->cancel(removed.lameTimer);
+        _topics->unsubscribeAll(connection);
+    }
+}
+
+uint32_t Server::connectionEvents() const {
+    return _edgeTriggered ? EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET : EPOLLIN;
+}
+
+bool Server::setInterest(Connection* connection, bool reading, bool writing) {
+    if (_edgeTriggered) {
+        // Always watched for both.
+        return true;
+    }
+    uint32_t events = 0;
+    if (reading) {
+        events |= EPOLLIN;
+    }
+    if (writing) {
+        events |= EPOLLOUT;
+    }
+    if (!_poller->modify(connection->getFd(), events, connection)) {
+        LS_ERROR(_logger, "Unable to change the events watched for: " << getLastError());
         return false;
     }
     return true;
@@ -538,48 +1107,53 @@ void Server::addPageHandler(std::shared_ptr<PageHandler> handler) {
 }
 
 bool Server::isCrossOriginAllowed(const std::string& endpoint) const {
+    auto& handlerMap = root()._webSocketHandlerMap;
     auto splits = split(endpoint, '?');
-    auto iter = _webSocketHandlerMap.find(splits[0]);
-    if (iter == _webSocketHandlerMap.end()) {
+    auto iter = handlerMap.find(splits[0]);
+    if (iter == handlerMap.end()) {
         return false;
     }
     return iter->second.allowCrossOrigin;
 }
 
 std::shared_ptr<WebSocket::Handler> Server::getWebSocketHandler(const char* endpoint) const {
+    auto& handlerMap = root()._webSocketHandlerMap;
     auto splits = split(endpoint, '?');
-    auto iter = _webSocketHandlerMap.find(splits[0]);
-    if (iter == _webSocketHandlerMap.end()) {
+    auto iter = handlerMap.find(splits[0]);
+    if (iter == handlerMap.end()) {
         return std::shared_ptr<WebSocket::Handler>();
     }
     return iter->second.handler;
 }
 
 void Server::execute(std::shared_ptr<Runnable> runnable) {
-    execute([runnable] { runnable->run(); });
+    post(Task([runnable = std::move(runnable)] { runnable->run(); }));
 }
 
 void Server::execute(std::function<void()> toExecute) {
-    std::unique_lock<decltype(_pendingExecutableMutex)> lock(_pendingExecutableMutex);
-    _pendingExecutables.emplace_back(std::move(toExecute));
-    lock.unlock();
+    post(Task(std::move(toExecute)));
+}
 
-    uint64_t one = 1;
-    if (_eventFd != -1 && ::write(_eventFd, &one, sizeof(one)) == -1) {
-        if (errno != EAGAIN && errno != EWOULDBLOCK) {
-            LS_ERROR(_logger, "Unable to post a wake event: " << getLastError());
-        }
+void Server::post(Task&& task) {
+    // Only the first task queued since the loop last ran them needs to wake it.
+    if (_executables->push(std::move(task))) {
+        wake();
     }
 }
 
+Server::ExecutorStats Server::executorStats() const {
+    return {_executables->depth(), _executorWakeups.load(std::memory_order_relaxed),
+            _executables->overflowed(), _executables->executed()};
+}
+
 std::string Server::getStatsDocument() const {
     std::ostringstream doc;
     doc << "clear();\n";
-    for (auto _connection : _connections) {
+    _connections->forEach([&](const ConnectionTable::Entry& entry) {
         doc << "connection({";
-        auto connection = _connection.first;
+        auto connection = entry.connection;
         jsonKeyPairToStream(doc,
-                            "since", EpochTimeAsLocal(_connection.second),
+                            "since", EpochTimeAsLocal(entry.since),
                             "fd", connection->getFd(),
                             "id", reinterpret_cast<uint64_t>(connection),
                             "uri", connection->getRequestUri(),
@@ -590,7 +1164,7 @@ std::string Server::getStatsDocument() const {
                             "output", connection->outputBufferSize(),
                             "written", connection->bytesSent());
         doc << "});\n";
-    }
+    });
     return doc.str();
 }
 
@@ -613,6 +1187,29 @@ void Server::setPerMessageDeflateEnabled(bool enabled) {
     _perMessageDeflateEnabled = enabled;
 }
 
+void Server::setAutoCork(bool autoCork, std::chrono::microseconds flushWindow) {
+    if (_root || _listenSock != -1) {
+        LS_ERROR(_logger, "Ignoring auto-cork setting: must be set before listening");
+        return;
+    }
+    LS_INFO(_logger, "Setting auto-cork " << (autoCork ? "on" : "off") << ", flush window "
+                                          << flushWindow.count() << "us");
+    _autoCork = autoCork;
+    _corkWindow = autoCork ? std::max(flushWindow, std::chrono::microseconds::zero()) : std::chrono::microseconds::zero();
+    if (_corkWindow.count() && _corkTimerFd == -1 && _poller) {
+        createCorkTimerFd();
+    }
+}
+
+void Server::setZeroCopyThreshold(size_t bytes) {
+    if (_root || _listenSock != -1) {
+        LS_ERROR(_logger, "Ignoring zero-copy threshold: must be set before listening");
+        return;
+    }
+    LS_INFO(_logger, "Setting zero-copy threshold to " << bytes);
+    _zeroCopyThreshold = bytes;
+}
+
 void Server::checkThread() const {
     auto thisTid = gettid();
     if (thisTid != _threadId) {
@@ -623,18 +1220,112 @@ void Server::checkThread() const {
     }
 }
 
-std::shared_ptr<Response> Server::handle(const Request& request) {
-    for (const auto& handler : _pageHandlers) {
-        auto result = handler->handle(request);
+std::shared_ptr<Response> Server::handle(const std::shared_ptr<Request>& request, size_t firstHandler) {
+    auto& handlers = root()._pageHandlers;
+    for (auto i = firstHandler; i < handlers.size(); ++i) {
+        if (handlers[i]->offloaded()) {
+            return std::make_shared<OffloadedResponse>(*this, workerPool(), request, handlers, i);
+        }
+        auto result = handlers[i]->handle(*request);
         if (result != Response::unhandled())
             return result;
     }
     return Response::unhandled();
 }
 
+std::shared_ptr<BodyHandler> Server::bodyHandler(const Request& request) {
+    for (auto& handler : root()._pageHandlers) {
+        auto result = handler->bodyHandler(request);
+        if (result)
+            return result;
+    }
+    return nullptr;
+}
+
+WorkerPool& Server::workerPool() {
+    auto& root = _root ? *_root : *this;
+    std::call_once(root._workerPoolStarted, [&root] {
+        LS_INFO(root._logger, "Starting " << root._workerThreads << " worker threads");
+        root._workerPool = std::make_unique<WorkerPool>(root._workerThreads);
+    });
+    return *root._workerPool;
+}
+
+void Server::setWorkerThreads(size_t count) {
+    if (count == 0 || _root || _workerPool) {
+        LS_ERROR(_logger, "Ignoring worker thread count " << count << ": must be positive and set before use");
+        return;
+    }
+    _workerThreads = count;
+}
+
+WorkerPool* Server::filePool() {
+    auto& root = _root ? *_root : *this;
+    if (!root._fileThreads) {
+        return nullptr;
+    }
+    std::call_once(root._filePoolStarted, [&root] {
+        LS_INFO(root._logger, "Starting " << root._fileThreads << " file threads");
+        root._filePool = std::make_unique<WorkerPool>(root._fileThreads);
+    });
+    return root._filePool.get();
+}
+
+void Server::setFileThreads(size_t count) {
+    if (_root || _filePool) {
+        LS_ERROR(_logger, "Ignoring file thread count " << count << ": must be set before use");
+        return;
+    }
+    _fileThreads = count;
+}
+
+Server::LoopBackend Server::setLoopBackend(LoopBackend backend) {
+    if (_root || _listenSock != -1 || _eventFd == -1) {
+        LS_ERROR(_logger, "Ignoring loop backend change: must be set before listening");
+        return _loopBackend;
+    }
+    if (backend != _loopBackend && createPoller(backend)) {
+        LS_INFO(_logger, "Using " << _poller->name() << " event loop");
+    }
+    return _loopBackend;
+}
+
+void Server::setEdgeTriggered(bool edgeTriggered) {
+    if (_root || _listenSock != -1) {
+        LS_ERROR(_logger, "Ignoring edge-triggered setting: must be set before listening");
+        return;
+    }
+    LS_INFO(_logger, "Setting edge-triggered mode " << (edgeTriggered ? "on" : "off"));
+    _edgeTriggered = edgeTriggered;
+}
+
+void Server::setReactorCount(size_t count) {
+    if (count == 0 || _root || _listenSock != -1) {
+        LS_ERROR(_logger, "Ignoring reactor count " << count << ": must be positive and set before listening");
+        return;
+    }
+    LS_INFO(_logger, "Setting reactor count to " << count);
+    _reactorCount = count;
+}
+
 void Server::setClientBufferSize(size_t bytesToBuffer) {
     LS_INFO(_logger, "Setting client buffer size to " << bytesToBuffer << " bytes");
     _clientBufferSize = bytesToBuffer;
 }
 
+void Server::setPipelineDepth(size_t depth) {
+    LS_INFO(_logger, "Setting pipeline depth to " << depth);
+    _pipelineDepth = depth;
+}
+
+void Server::setRequestBodySpillThreshold(size_t bytes) {
+    LS_INFO(_logger, "Setting request body spill threshold to " << bytes << " bytes");
+    _requestBodySpillThreshold = bytes;
+}
+
+void Server::setMaxRequestBodySize(size_t bytes) {
+    LS_INFO(_logger, "Setting maximum request body size to " << bytes << " bytes");
+    _maxRequestBodySize = bytes;
+}
+
 } // namespace seasocks
@@ -0,0 +1,215 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/TimerWheel.h"
+
+#include <algorithm>
+
+namespace seasocks {
+
+namespace {
+
+uint64_t rotateRight(uint64_t bits, unsigned by) {
+    return by == 0 ? bits : (bits >> by) | (bits << (64 - by));
+}
+
+}
+
+constexpr uint64_t TimerWheel::Never;
+constexpr uint64_t TimerWheel::MaxDelta;
+constexpr uint32_t TimerWheel::Nil;
+
+TimerWheel::TimerWheel(uint64_t nowMillis)
+        : _now(nowMillis), _size(0), _expiring(false) {
+    for (auto& level : _levels) {
+        level.heads.fill(Nil);
+        level.tails.fill(Nil);
+        level.occupied = 0;
+    }
+}
+
+TimerWheel::Id TimerWheel::schedule(uint64_t deadlineMillis, Task&& task) {
+    uint32_t index;
+    if (_free.empty()) {
+        index = static_cast<uint32_t>(_entries.size());
+        _entries.emplace_back();
+        _entries.back().generation = 0;
+    } else {
+        index = _free.back();
+        _free.pop_back();
+    }
+    auto& entry = _entries[index];
+    entry.deadline = deadlineMillis;
+    entry.task = std::move(task);
+    place(index);
+    ++_size;
+    return (static_cast<uint64_t>(entry.generation) << 32) | (index + 1);
+}
+
+bool TimerWheel::cancel(Id id) {
+    auto index = static_cast<uint32_t>(id) - 1;
+    auto generation = static_cast<uint32_t>(id >> 32);
+    if (index >= _entries.size() || _entries[index].generation != generation
+        || _entries[index].slot == Nil) {
+        return false;
+    }
+    unlink(index);
+    release(index);
+    return true;
+}
+
+void TimerWheel::place(uint32_t index) {
+    auto& entry = _entries[index];
+    auto earliest = _expiring ? _now + 1 : _now;
+    auto delta = std::min(std::max(entry.deadline, earliest) - _now, MaxDelta);
+    auto at = _now + delta;
+    unsigned level = 0;
+    while (level < NumLevels - 1 && delta >= (uint64_t(1) << (LevelBits * (level + 1)))) {
+        ++level;
+    }
+    link(index, level, (at >> (LevelBits * level)) & (SlotsPerLevel - 1));
+}
+
+void TimerWheel::link(uint32_t index, unsigned level, unsigned slot) {
+    auto& entry = _entries[index];
+    auto& tail = _levels[level].tails[slot];
+    entry.slot = level * SlotsPerLevel + slot;
+    entry.prev = tail;
+    entry.next = Nil;
+    if (tail == Nil) {
+        _levels[level].heads[slot] = index;
+    } else {
+        _entries[tail].next = index;
+    }
+    tail = index;
+    _levels[level].occupied |= uint64_t(1) << slot;
+}
+
+void TimerWheel::unlink(uint32_t index) {
+    auto& entry = _entries[index];
+    auto& level = _levels[entry.slot / SlotsPerLevel];
+    auto slot = entry.slot % SlotsPerLevel;
+    if (entry.prev == Nil) {
+        level.heads[slot] = entry.next;
+    } else {
+        _entries[entry.prev].next = entry.next;
+    }
+    if (entry.next == Nil) {
+        level.tails[slot] = entry.prev;
+    } else {
+        _entries[entry.next].prev = entry.prev;
+    }
+    if (level.heads[slot] == Nil) {
+        level.occupied &= ~(uint64_t(1) << slot);
+    }
+    entry.slot = Nil;
+}
+
+void TimerWheel::release(uint32_t index) {
+    auto& entry = _entries[index];
+    entry.task.reset();
+    ++entry.generation;
+    _free.push_back(index);
+    --_size;
+}
+
+uint64_t TimerWheel::nextTickAt(unsigned level) const {
+    auto occupied = _levels[level].occupied;
+    if (!occupied) {
+        return Never;
+    }
+    if (level == 0) {
+        auto ticks = __builtin_ctzll(rotateRight(occupied, _now & (SlotsPerLevel - 1)));
+        return _now + ticks;
+    }
+    // Entries on higher levels are always due in a later period than the current
+    // one, and are cascaded down at the start of it.
+    auto shift = LevelBits * level;
+    auto period = (_now >> shift) + 1;
+    auto periods = __builtin_ctzll(rotateRight(occupied, period & (SlotsPerLevel - 1)));
+    return (period + periods) << shift;
+}
+
+uint64_t TimerWheel::nextTick() const {
+    auto next = Never;
+    for (unsigned level = 0; level < NumLevels; ++level) {
+        next = std::min(next, nextTickAt(level));
+    }
+    return next;
+}
+
+size_t TimerWheel::advance(uint64_t nowMillis) {
+    _expiring = false;
+    size_t numRun = 0;
+    for (;;) {
+        auto tick = nextTick();
+        if (tick > nowMillis) {
+            break;
+        }
+        // Nothing happens between the old tick and this one, so jump straight there.
+        _now = tick;
+        for (auto level = NumLevels - 1; level > 0; --level) {
+            if ((_now & ((uint64_t(1) << (LevelBits * level)) - 1)) == 0) {
+                cascade(level);
+            }
+        }
+        numRun += expire();
+    }
+    _now = std::max(_now, nowMillis);
+    return numRun;
+}
+
+void TimerWheel::cascade(unsigned level) {
+    auto slot = (_now >> (LevelBits * level)) & (SlotsPerLevel - 1);
+    auto index = _levels[level].heads[slot];
+    _levels[level].heads[slot] = Nil;
+    _levels[level].tails[slot] = Nil;
+    _levels[level].occupied &= ~(uint64_t(1) << slot);
+    while (index != Nil) {
+        auto next = _entries[index].next;
+        place(index);
+        index = next;
+    }
+}
+
+size_t TimerWheel::expire() {
+    size_t numRun = 0;
+    auto& level = _levels[0];
+    auto slot = _now & (SlotsPerLevel - 1);
+    _expiring = true;
+    // Timers may cancel or schedule others, so take them one at a time.
+    while (level.heads[slot] != Nil) {
+        auto index = level.heads[slot];
+        unlink(index);
+        auto task = std::move(_entries[index].task);
+        release(index);
+        task();
+        ++numRun;
+    }
+    _expiring = false;
+    return numRun;
+}
+
+}
@@ -0,0 +1,71 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/TopicRegistry.h"
+
+#include <algorithm>
+
+namespace seasocks {
+
+bool TopicRegistry::subscribe(Connection* connection, const std::string& topic) {
+    if (!_subscribers[topic].insert(connection).second) {
+        return false;
+    }
+    _topics[connection].push_back(topic);
+    return true;
+}
+
+bool TopicRegistry::unsubscribe(Connection* connection, const std::string& topic) {
+    auto it = _subscribers.find(topic);
+    if (it == _subscribers.end() || !it->second.erase(connection)) {
+        return false;
+    }
+    if (it->second.empty()) {
+        _subscribers.erase(it);
+    }
+    auto& topics = _topics[connection];
+    topics.erase(std::find(topics.begin(), topics.end(), topic));
+    if (topics.empty()) {
+        _topics.erase(connection);
+    }
+    return true;
+}
+
+void TopicRegistry::unsubscribeAll(Connection* connection) {
+    auto it = _topics.find(connection);
+    if (it == _topics.end()) {
+        return;
+    }
+    for (const auto& topic : it->second) {
+        auto subscribers = _subscribers.find(topic);
+        subscribers->second.erase(connection);
+        if (subscribers->second.empty()) {
+            _subscribers.erase(subscribers);
+        }
+    }
+    _topics.erase(it);
+}
+
+}
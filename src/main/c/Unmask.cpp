@@ -0,0 +1,148 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/Unmask.h"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace seasocks {
+
+namespace {
+
+// Each of these leaves the tail to the next simplest, having handled a multiple
+// of four bytes so the key still lines up with the start of what's left.
+
+void unmaskBytes(uint8_t* dest, const uint8_t* source, size_t size, uint32_t key) {
+    uint8_t keyBytes[4];
+    memcpy(keyBytes, &key, sizeof(keyBytes));
+    for (size_t i = 0; i < size; ++i) {
+        dest[i] = source[i] ^ keyBytes[i & 3];
+    }
+}
+
+void unmaskWords(uint8_t* dest, const uint8_t* source, size_t size, uint32_t key) {
+    uint64_t wideKey;
+    memcpy(&wideKey, &key, sizeof(key));
+    memcpy(reinterpret_cast<uint8_t*>(&wideKey) + sizeof(key), &key, sizeof(key));
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, source + i, sizeof(word));
+        word ^= wideKey;
+        memcpy(dest + i, &word, sizeof(word));
+    }
+    unmaskBytes(dest + i, source + i, size - i, key);
+}
+
+#if defined(__SSE2__)
+
+void unmaskSse2(uint8_t* dest, const uint8_t* source, size_t size, uint32_t key) {
+    const auto wideKey = _mm_set1_epi32(static_cast<int>(key));
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_xor_si128(chunk, wideKey));
+    }
+    unmaskWords(dest + i, source + i, size - i, key);
+}
+
+__attribute__((target("avx2")))
+void unmaskAvx2(uint8_t* dest, const uint8_t* source, size_t size, uint32_t key) {
+    const auto wideKey = _mm256_set1_epi32(static_cast<int>(key));
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        auto first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+        auto second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i + 32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), _mm256_xor_si256(first, wideKey));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i + 32), _mm256_xor_si256(second, wideKey));
+    }
+    for (; i + 32 <= size; i += 32) {
+        auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), _mm256_xor_si256(chunk, wideKey));
+    }
+    // The compiler doesn't clear the upper halves before a tail call, and SSE
+    // code running with them dirty can stall for hundreds of cycles.
+    _mm256_zeroupper();
+    unmaskSse2(dest + i, source + i, size - i, key);
+}
+
+using Unmask = void (*)(uint8_t*, const uint8_t*, size_t, uint32_t);
+
+Unmask chooseUnmask() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? unmaskAvx2 : unmaskSse2;
+}
+
+const Unmask unmaskImpl = chooseUnmask();
+
+#elif defined(__ARM_NEON)
+
+void unmaskNeon(uint8_t* dest, const uint8_t* source, size_t size, uint32_t key) {
+    const auto wideKey = vreinterpretq_u8_u32(vdupq_n_u32(key));
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        vst1q_u8(dest + i, veorq_u8(vld1q_u8(source + i), wideKey));
+    }
+    unmaskWords(dest + i, source + i, size - i, key);
+}
+
+const auto unmaskImpl = unmaskNeon;
+
+#else
+
+const auto unmaskImpl = unmaskWords;
+
+#endif
+
+}
+
+void unmask(uint8_t* dest, const uint8_t* source, size_t size, uint32_t key) {
+    if (key == 0) {
+        if (dest != source && size > 0) {
+            memcpy(dest, source, size);
+        }
+        return;
+    }
+    unmaskImpl(dest, source, size, key);
+}
+
+uint32_t advanceMask(uint32_t key, size_t bytes) {
+    uint8_t keyBytes[4];
+    uint8_t advanced[4];
+    memcpy(keyBytes, &key, sizeof(keyBytes));
+    for (size_t i = 0; i < 4; ++i) {
+        advanced[i] = keyBytes[(i + bytes) & 3];
+    }
+    memcpy(&key, advanced, sizeof(key));
+    return key;
+}
+
+}
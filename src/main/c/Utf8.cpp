@@ -0,0 +1,321 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "internal/Utf8.h"
+#include "internal/Unmask.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace seasocks {
+
+namespace {
+
+// Each scan returns how much of the text at 'data' it has found to be whole,
+// valid characters. It stops at anything it can't vouch for: a problem, a
+// character running past the end, or (for the simpler ones) any non-ASCII byte,
+// leaving that to be checked a byte at a time.
+
+size_t scanWords(const uint8_t* data, size_t size) {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        if (word & 0x8080808080808080ull) {
+            break;
+        }
+    }
+    while (i < size && data[i] < 0x80) {
+        ++i;
+    }
+    return i;
+}
+
+#if defined(__SSE2__)
+
+// Where the last whole character before 'end' finishes, given that everything
+// before 'end' is otherwise valid.
+size_t characterBoundary(const uint8_t* data, size_t end) {
+    for (size_t back = 1; back <= 3 && back <= end; ++back) {
+        auto byte = data[end - back];
+        if ((byte & 0xc0) != 0x80) {
+            size_t length = byte < 0x80 ? 1 : byte < 0xe0 ? 2 : byte < 0xf0 ? 3 : 4;
+            return length > back ? end - back : end;
+        }
+    }
+    return end;
+}
+
+size_t scanSse2(const uint8_t* data, size_t size) {
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        if (_mm_movemask_epi8(chunk) != 0) {
+            break;
+        }
+    }
+    return i + scanWords(data + i, size - i);
+}
+
+// The lookup tables classify each pair of adjacent bytes by the high nibble of
+// the first, its low nibble and the high nibble of the second; a bit set in
+// all three marks a problem. Whether a continuation byte after a continuation
+// byte is expected is worked out separately, from the two bytes before those.
+constexpr uint8_t TooShort = 1 << 0;      // Lead byte, then no continuation.
+constexpr uint8_t TooLong = 1 << 1;       // ASCII, then a continuation.
+constexpr uint8_t Overlong3 = 1 << 2;     // 11100000 100xxxxx
+constexpr uint8_t TooLarge = 1 << 3;      // Beyond U+10FFFF, 1001xxxx or 101xxxxx after.
+constexpr uint8_t Surrogate = 1 << 4;     // 11101101 101xxxxx
+constexpr uint8_t Overlong2 = 1 << 5;     // 1100000x
+constexpr uint8_t TooLarge1000 = 1 << 6;  // Beyond U+10FFFF, 1000xxxx after.
+constexpr uint8_t Overlong4 = 1 << 6;     // 11110000 1000xxxx
+constexpr uint8_t TwoConts = 1 << 7;      // A continuation after a continuation.
+constexpr uint8_t Carry = TooShort | TooLong | TwoConts;
+
+alignas(16) constexpr uint8_t FirstHighTable[16] = {
+    TooLong, TooLong, TooLong, TooLong, TooLong, TooLong, TooLong, TooLong,
+    TwoConts, TwoConts, TwoConts, TwoConts,
+    TooShort | Overlong2,
+    TooShort,
+    TooShort | Overlong3 | Surrogate,
+    TooShort | TooLarge | TooLarge1000 | Overlong4};
+alignas(16) constexpr uint8_t FirstLowTable[16] = {
+    Carry | Overlong3 | Overlong2 | Overlong4,
+    Carry | Overlong2,
+    Carry,
+    Carry,
+    Carry | TooLarge,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000 | Surrogate,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000};
+alignas(16) constexpr uint8_t SecondHighTable[16] = {
+    TooShort, TooShort, TooShort, TooShort, TooShort, TooShort, TooShort, TooShort,
+    TooLong | Overlong2 | TwoConts | Overlong3 | TooLarge1000 | Overlong4,
+    TooLong | Overlong2 | TwoConts | Overlong3 | TooLarge,
+    TooLong | Overlong2 | TwoConts | Surrogate | TooLarge,
+    TooLong | Overlong2 | TwoConts | Surrogate | TooLarge,
+    TooShort, TooShort, TooShort, TooShort};
+// Subtracted with saturation from the end of a vector, leaving something
+// non-zero where a lead byte needs more bytes than the vector has left.
+alignas(16) constexpr uint8_t IncompleteTable[16] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xef, 0xdf, 0xbf};
+
+__attribute__((target("ssse3")))
+__m128i classifySsse3(__m128i input, __m128i prev) {
+    const auto nibble = _mm_set1_epi8(0x0f);
+    const auto firstHigh = _mm_load_si128(reinterpret_cast<const __m128i*>(FirstHighTable));
+    const auto firstLow = _mm_load_si128(reinterpret_cast<const __m128i*>(FirstLowTable));
+    const auto secondHigh = _mm_load_si128(reinterpret_cast<const __m128i*>(SecondHighTable));
+    auto prev1 = _mm_alignr_epi8(input, prev, 15);
+    auto special = _mm_and_si128(
+        _mm_and_si128(_mm_shuffle_epi8(firstHigh, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+                      _mm_shuffle_epi8(firstLow, _mm_and_si128(prev1, nibble))),
+        _mm_shuffle_epi8(secondHigh, _mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+    // A third or fourth byte must be a continuation (and is the only place two are allowed).
+    auto prev2 = _mm_alignr_epi8(input, prev, 14);
+    auto prev3 = _mm_alignr_epi8(input, prev, 13);
+    auto mustContinue = _mm_and_si128(
+        _mm_or_si128(_mm_subs_epu8(prev2, _mm_set1_epi8(0x60)), _mm_subs_epu8(prev3, _mm_set1_epi8(0x70))),
+        _mm_set1_epi8(static_cast<char>(0x80)));
+    return _mm_xor_si128(mustContinue, special);
+}
+
+__attribute__((target("ssse3")))
+size_t scanSsse3(const uint8_t* data, size_t size) {
+    const auto zero = _mm_setzero_si128();
+    const auto incompleteLimit = _mm_load_si128(reinterpret_cast<const __m128i*>(IncompleteTable));
+    auto prev = zero;
+    auto prevIncomplete = zero;
+    size_t verified = 0;
+    for (size_t i = 0; i + 16 <= size; i += 16) {
+        auto input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i error;
+        if (_mm_movemask_epi8(input) == 0) {
+            // All ASCII: only a problem if the last vector left a character unfinished.
+            error = prevIncomplete;
+            prevIncomplete = zero;
+        } else {
+            error = classifySsse3(input, prev);
+            prevIncomplete = _mm_subs_epu8(input, incompleteLimit);
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(error, zero)) != 0xffff) {
+            break;
+        }
+        prev = input;
+        verified = i + 16;
+    }
+    return characterBoundary(data, verified);
+}
+
+__attribute__((target("avx2")))
+size_t scanAvx2(const uint8_t* data, size_t size) {
+    const auto nibble = _mm256_set1_epi8(0x0f);
+    const auto firstHigh = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(FirstHighTable)));
+    const auto firstLow = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(FirstLowTable)));
+    const auto secondHigh = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(SecondHighTable)));
+    const auto incompleteLimit = _mm256_setr_m128i(_mm_set1_epi8(static_cast<char>(0xff)),
+                                                   _mm_load_si128(reinterpret_cast<const __m128i*>(IncompleteTable)));
+    const auto zero = _mm256_setzero_si256();
+    auto prev = zero;
+    auto prevIncomplete = zero;
+    size_t verified = 0;
+    for (size_t i = 0; i + 32 <= size; i += 32) {
+        auto input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i error;
+        if (_mm256_movemask_epi8(input) == 0) {
+            error = prevIncomplete;
+            prevIncomplete = zero;
+        } else {
+            // The previous bytes, across the two lanes and from the last vector.
+            auto carried = _mm256_permute2x128_si256(prev, input, 0x21);
+            auto prev1 = _mm256_alignr_epi8(input, carried, 15);
+            auto prev2 = _mm256_alignr_epi8(input, carried, 14);
+            auto prev3 = _mm256_alignr_epi8(input, carried, 13);
+            auto special = _mm256_and_si256(
+                _mm256_and_si256(_mm256_shuffle_epi8(firstHigh, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+                                 _mm256_shuffle_epi8(firstLow, _mm256_and_si256(prev1, nibble))),
+                _mm256_shuffle_epi8(secondHigh, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)));
+            auto mustContinue = _mm256_and_si256(
+                _mm256_or_si256(_mm256_subs_epu8(prev2, _mm256_set1_epi8(0x60)),
+                                _mm256_subs_epu8(prev3, _mm256_set1_epi8(0x70))),
+                _mm256_set1_epi8(static_cast<char>(0x80)));
+            error = _mm256_xor_si256(mustContinue, special);
+            prevIncomplete = _mm256_subs_epu8(input, incompleteLimit);
+        }
+        if (!_mm256_testz_si256(error, error)) {
+            break;
+        }
+        prev = input;
+        verified = i + 32;
+    }
+    return characterBoundary(data, verified);
+}
+
+using Scan = size_t (*)(const uint8_t*, size_t);
+
+Scan chooseScan() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return scanAvx2;
+    }
+    return __builtin_cpu_supports("ssse3") ? scanSsse3 : scanSse2;
+}
+
+const Scan scanImpl = chooseScan();
+
+#else
+
+const auto scanImpl = scanWords;
+
+#endif
+
+}
+
+void Utf8Validator::feedByte(uint8_t byte) {
+    if (_needed != 0) {
+        if (byte < _lower || byte > _upper) {
+            _valid = false;
+            return;
+        }
+        --_needed;
+        _lower = 0x80;
+        _upper = 0xbf;
+        return;
+    }
+    if (byte < 0x80) {
+        return;
+    }
+    // The second byte's range rules out overlong forms, surrogates and
+    // anything beyond U+10FFFF.
+    if (byte < 0xc2) {
+        _valid = false;
+    } else if (byte < 0xe0) {
+        _needed = 1;
+    } else if (byte < 0xf0) {
+        _needed = 2;
+        if (byte == 0xe0) {
+            _lower = 0xa0;
+        } else if (byte == 0xed) {
+            _upper = 0x9f;
+        }
+    } else if (byte < 0xf5) {
+        _needed = 3;
+        if (byte == 0xf0) {
+            _lower = 0x90;
+        } else if (byte == 0xf4) {
+            _upper = 0x8f;
+        }
+    } else {
+        _valid = false;
+    }
+}
+
+bool Utf8Validator::feed(const uint8_t* data, size_t size) {
+    size_t i = 0;
+    while (_valid && i < size) {
+        if (_needed == 0) {
+            i += scanImpl(data + i, size - i);
+            if (i == size) {
+                break;
+            }
+        }
+        feedByte(data[i++]);
+    }
+    return _valid;
+}
+
+bool isValidUtf8(const uint8_t* data, size_t size) {
+    Utf8Validator validator;
+    validator.feed(data, size);
+    return validator.complete();
+}
+
+bool unmaskUtf8(uint8_t* dest, const uint8_t* source, size_t size, uint32_t key,
+                Utf8Validator& validator) {
+    // A multiple of four, so the key lines up with each piece.
+    constexpr size_t PieceSize = 8192;
+    for (size_t i = 0; i < size; i += PieceSize) {
+        auto length = std::min(PieceSize, size - i);
+        unmask(dest + i, source + i, length, key);
+        if (!validator.feed(dest + i, length)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
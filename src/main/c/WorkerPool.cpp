@@ -0,0 +1,137 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/WorkerPool.h"
+
+namespace seasocks {
+
+WorkerPool::WorkerPool(size_t numThreads)
+        : _nextWorker(0), _queued(0), _sleeping(0), _stopping(false), _stopped(false) {
+    for (size_t i = 0; i < numThreads; ++i) {
+        _workers.emplace_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < numThreads; ++i) {
+        _threads.emplace_back([this, i] { run(i); });
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    stop();
+}
+
+void WorkerPool::submit(Task&& task) {
+    if (_workers.empty()) {
+        task();
+        return;
+    }
+    auto& worker = *_workers[_nextWorker.fetch_add(1, std::memory_order_relaxed) % _workers.size()];
+    {
+        std::unique_lock<std::mutex> lock(worker.mutex);
+        // Checked under the lock stop() drains this queue with: the task is
+        // either queued in time to be drained, or run here.
+        if (_stopped.load(std::memory_order_acquire)) {
+            lock.unlock();
+            task();
+            return;
+        }
+        _queued.fetch_add(1, std::memory_order_release);
+        worker.tasks.emplace_back(std::move(task));
+    }
+    // Sleepers check _queued under this lock, so can't miss the notification.
+    std::lock_guard<std::mutex> lock(_idleMutex);
+    if (_sleeping) {
+        _idle.notify_one();
+    }
+}
+
+void WorkerPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(_idleMutex);
+        if (_stopping) {
+            return;
+        }
+        _stopping = true;
+    }
+    _idle.notify_all();
+    for (auto& thread : _threads) {
+        thread.join();
+    }
+    _threads.clear();
+    _stopped.store(true, std::memory_order_release);
+    // Anything submitted while the workers were finishing up. Submissions from
+    // here on run on their callers.
+    Task task;
+    for (size_t i = 0; i < _workers.size(); ++i) {
+        while (take(i, task)) {
+            task();
+            task.reset();
+        }
+    }
+}
+
+bool WorkerPool::take(size_t index, Task& task) {
+    auto numWorkers = _workers.size();
+    for (size_t i = 0; i < numWorkers; ++i) {
+        auto& worker = *_workers[(index + i) % numWorkers];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.tasks.empty()) {
+            continue;
+        }
+        // Our own queue is served in order; thieves take from the far end.
+        if (i == 0) {
+            task = std::move(worker.tasks.front());
+            worker.tasks.pop_front();
+        } else {
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+        }
+        _queued.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void WorkerPool::run(size_t index) {
+    Task task;
+    for (;;) {
+        if (take(index, task)) {
+            task();
+            task.reset();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(_idleMutex);
+        if (_queued.load(std::memory_order_acquire) != 0) {
+            continue;
+        }
+        if (_stopping) {
+            return;
+        }
+        ++_sleeping;
+        _idle.wait(lock, [this] { return _stopping || _queued.load(std::memory_order_acquire) != 0; });
+        --_sleeping;
+    }
+}
+
+}
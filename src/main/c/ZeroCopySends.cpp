@@ -0,0 +1,81 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/ZeroCopySends.h"
+
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace seasocks {
+
+void ZeroCopySends::sent(std::shared_ptr<const void> owner) {
+    _pending.push_back({_nextId++, std::move(owner)});
+    ++_sends;
+}
+
+bool ZeroCopySends::reap(int fd) {
+    bool copied = false;
+    for (;;) {
+        char control[128];
+        msghdr message{};
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        if (::recvmsg(fd, &message, MSG_ERRQUEUE) == -1) {
+            break;
+        }
+        for (auto cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+            if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR)
+                && !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)) {
+                continue;
+            }
+            sock_extended_err error;
+            memcpy(&error, CMSG_DATA(cmsg), sizeof(error));
+            if (error.ee_errno != 0 || error.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            if (error.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                copied = true;
+            }
+            // Sends ee_info to ee_data inclusive have completed, usually but not
+            // always the oldest.
+            auto first = error.ee_info;
+            auto count = error.ee_data - first;
+            _pending.erase(std::remove_if(_pending.begin(), _pending.end(),
+                                          [first, count](const Send& send) {
+                                              return send.id - first <= count;
+                                          }),
+                           _pending.end());
+            _completions += count + 1;
+        }
+    }
+    return copied;
+}
+
+}
@@ -0,0 +1,71 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace seasocks {
+
+// Collects a request's body in memory until it grows beyond a threshold, after
+// which it's moved to an unlinked temporary file (in $TMPDIR, or failing that,
+// an anonymous memfd) and the rest appended there.
+class BodyBuffer {
+public:
+    // A threshold of 0 keeps everything in memory.
+    explicit BodyBuffer(size_t spillThreshold);
+    ~BodyBuffer();
+
+    BodyBuffer(const BodyBuffer&) = delete;
+    BodyBuffer& operator=(const BodyBuffer&) = delete;
+
+    // Returns false if the body couldn't be written to its file.
+    bool append(const uint8_t* data, size_t size);
+
+    size_t size() const {
+        return _size;
+    }
+    bool spilled() const {
+        return _fd != -1;
+    }
+
+    // Hands over the whole body, or returns false if a spilled body can't be
+    // mapped back in. 'data' stays valid while 'owner' lives.
+    bool finish(const uint8_t*& data, std::shared_ptr<const void>& owner);
+
+private:
+    bool spill();
+    bool writeToFile(const uint8_t* data, size_t size);
+
+    size_t _spillThreshold;
+    size_t _size = 0;
+    std::vector<uint8_t> _memory;
+    int _fd = -1;
+};
+
+}
@@ -0,0 +1,120 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "internal/InputBuffer.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace seasocks {
+
+// Takes a request's body out of the connection's input as it arrives, either a
+// Content-Length's worth or, undoing chunked transfer encoding, up to the last
+// chunk and any trailers (which are ignored).
+class BodyDecoder {
+public:
+    enum class State {
+        Reading,
+        Done,
+        // The chunked encoding was broken.
+        Malformed,
+        // The body would be longer than the limit given.
+        TooLarge,
+        // The function given to decode() returned false.
+        Rejected
+    };
+
+    // Longest chunk size or trailer line we'll wait for.
+    static constexpr size_t MaxLineSize = 4096;
+
+    static BodyDecoder fixed(size_t contentLength) {
+        return BodyDecoder(false, contentLength, contentLength);
+    }
+    static BodyDecoder chunked(size_t limit) {
+        return BodyDecoder(true, 0, limit);
+    }
+
+    // Consumes as much of the body from 'input' as there is, passing each piece
+    // of it to fn(const uint8_t* data, size_t size), which returns false to stop.
+    template <typename Fn>
+    State decode(InputBuffer& input, Fn&& fn) {
+        while (_state == State::Reading) {
+            if (_remaining > 0) {
+                auto size = std::min(_remaining, input.size());
+                if (size == 0) {
+                    break;
+                }
+                if (!fn(input.data(), size)) {
+                    _state = State::Rejected;
+                    break;
+                }
+                input.consume(size);
+                _remaining -= size;
+                _bodySize += size;
+            } else if (!_chunked) {
+                _state = State::Done;
+            } else if (!readFraming(input)) {
+                break;
+            }
+        }
+        return _state;
+    }
+
+    State state() const {
+        return _state;
+    }
+    // How much of the body has been decoded so far.
+    size_t bodySize() const {
+        return _bodySize;
+    }
+
+private:
+    BodyDecoder(bool chunked, size_t remaining, size_t limit)
+            : _chunked(chunked), _remaining(remaining), _limit(limit) {
+    }
+
+    // Reads the chunked encoding between chunks, returning false if it needs more input.
+    bool readFraming(InputBuffer& input);
+    // The length of the line at the front of the input, or npos if it's incomplete.
+    size_t lineLength(const InputBuffer& input);
+
+    enum class Framing {
+        ChunkSize,
+        ChunkEnd,
+        Trailers
+    };
+
+    bool _chunked;
+    size_t _remaining;
+    size_t _limit;
+    size_t _bodySize = 0;
+    Framing _framing = Framing::ChunkSize;
+    State _state = State::Reading;
+};
+
+}
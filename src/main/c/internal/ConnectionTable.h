@@ -0,0 +1,126 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "seasocks/Connection.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace seasocks {
+
+// Identifies a connection slot without keeping it alive. The generation changes
+// whenever the slot is reused, so a stale handle never finds a newer connection.
+struct ConnectionHandle {
+    uint32_t index;
+    uint32_t generation;
+};
+
+// The Server's connections, constructed in place in slabs of reusable slots,
+// so a reconnect storm recycles memory rather than hitting the allocator. Only
+// the memory is pooled: each connection is constructed afresh in its slot and
+// destroyed when done with, buffers and all. Alongside the slabs is a dense
+// array of the small, frequently consulted per-connection fields, indexed by
+// slot. Every connection must be destroyed before the table is.
+class ConnectionTable {
+public:
+    struct Entry {
+        Connection* connection; // Null unless registered.
+        time_t since;
+        uint64_t lameTimer;
+        uint32_t generation;
+    };
+
+    ConnectionTable() = default;
+
+    ConnectionTable(const ConnectionTable&) = delete;
+    ConnectionTable& operator=(const ConnectionTable&) = delete;
+
+    // Constructs a connection in a free slot. It's not registered until add()ed.
+    Connection* create(std::shared_ptr<Logger> logger, ServerImpl& server, int fd, const sockaddr_in& address);
+    // Destroys a connection made by create(), freeing its slot.
+    void destroy(Connection* connection);
+
+    ConnectionHandle add(Connection* connection, time_t since);
+    // Unregisters the connection (if registered), returning its entry as it was.
+    bool remove(Connection* connection, Entry& removed);
+
+    // The entry of a registered connection, or null.
+    Entry* find(Connection* connection);
+    Entry* find(ConnectionHandle handle);
+
+    size_t size() const {
+        return _size;
+    }
+    bool empty() const {
+        return _size == 0;
+    }
+
+    // Calls fn(const Entry&) for each registered connection.
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        for (const auto& entry : _entries) {
+            if (entry.connection) {
+                fn(entry);
+            }
+        }
+    }
+
+    std::vector<Connection*> registered() const;
+
+private:
+    static constexpr size_t SlabSize = 256;
+
+    struct Slot {
+        typename std::aligned_storage<sizeof(Connection), alignof(Connection)>::type object;
+
+        Connection* storage() {
+            return reinterpret_cast<Connection*>(&object);
+        }
+    };
+    static constexpr uint32_t NoSlot = UINT32_MAX;
+
+    uint32_t allocate();
+    Slot* slot(uint32_t index) const {
+        return &_slabs[index / SlabSize][index % SlabSize];
+    }
+    // The index of the slot holding a connection, or NoSlot if it didn't come
+    // from this table. The connection carries the index; it's only trusted if
+    // that slot really holds it.
+    uint32_t slotOf(const Connection* connection) const;
+    bool removeAt(uint32_t index, Entry& removed);
+
+    std::vector<std::unique_ptr<Slot[]>> _slabs;
+    std::vector<Entry> _entries;
+    std::vector<uint32_t> _free;
+    size_t _size = 0;
+};
+
+}
@@ -0,0 +1,101 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "internal/Task.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+namespace seasocks {
+
+// A multiple producer, single consumer queue of Tasks. Producers claim slots in a
+// bounded ring without locking (Dmitry Vyukov's bounded queue); should the ring
+// fill up they fall back to a mutex protected overflow list, so pushing never
+// fails or blocks on the consumer. Each producer's tasks run in the order it
+// pushed them.
+class ExecutorQueue {
+public:
+    explicit ExecutorQueue(size_t capacity = 4096);
+
+    ExecutorQueue(const ExecutorQueue&) = delete;
+    ExecutorQueue& operator=(const ExecutorQueue&) = delete;
+
+    // Callable from any thread. Returns true if the consumer needs waking: only
+    // the first push since the consumer last started running tasks does.
+    bool push(Task&& task);
+
+    // Consumer only. Runs up to 'maxTasks' tasks, returning true if tasks remain
+    // (in which case the consumer is considered already woken).
+    bool runBatch(size_t maxTasks);
+
+    // Approximate number of tasks waiting to run.
+    size_t depth() const;
+    // Number of tasks which found the ring full.
+    uint64_t overflowed() const {
+        return _overflowed.load(std::memory_order_relaxed);
+    }
+    uint64_t executed() const {
+        return _executed.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        Task task;
+    };
+
+    bool tryPush(Task& task);
+    bool tryPop(Task& task);
+    bool ringEmpty() const;
+
+    // Keeps the producers' position off the consumer's cache line.
+    struct PaddedPosition {
+        std::atomic<size_t> value;
+        char padding[64 - sizeof(std::atomic<size_t>)];
+    };
+
+    const size_t _mask;
+    std::unique_ptr<Cell[]> _cells;
+    PaddedPosition _enqueuePos;
+    std::atomic<size_t> _dequeuePos;
+    std::atomic<bool> _signalled;
+    std::atomic<uint64_t> _executed;
+
+    std::mutex _overflowMutex;
+    std::deque<Task> _overflow;
+    std::atomic<size_t> _overflowSize;
+    std::atomic<uint64_t> _overflowed;
+    // Overflowed tasks taken by the consumer, which run before anything newer in the ring.
+    std::deque<Task> _draining;
+    std::atomic<size_t> _drainingSize;
+};
+
+}
@@ -0,0 +1,113 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace seasocks {
+
+// Headers we look at ourselves, which get a slot each so finding them needs
+// no string comparisons.
+enum class KnownHeader : uint8_t {
+    Host,
+    Connection,
+    Upgrade,
+    Origin,
+    SecWebSocketKey,
+    SecWebSocketKey1,
+    SecWebSocketKey2,
+    SecWebSocketVersion,
+    SecWebSocketProtocol,
+    SecWebSocketExtensions,
+    ContentLength,
+    TransferEncoding,
+    Expect,
+    Range,
+    Cookie,
+};
+
+// A request's headers, as views into its own copy of the header block. Names
+// are matched case-insensitively, and if a header is repeated the first one wins.
+class HeaderStore {
+public:
+    using Header = std::pair<std::string_view, std::string_view>;
+
+    HeaderStore() = default;
+    // Copies the header block, which is then parsed in place and add()ed.
+    HeaderStore(const uint8_t* first, const uint8_t* last);
+
+    uint8_t* begin() {
+        return _block.get();
+    }
+    uint8_t* end() {
+        return _block.get() + _blockSize;
+    }
+
+    // The name and value must point into the block.
+    void add(std::string_view name, std::string_view value);
+
+    bool has(KnownHeader header) const {
+        return slot(header) != 0;
+    }
+    bool has(std::string_view name) const {
+        return find(name) != nullptr;
+    }
+    // Returns an empty view for missing headers.
+    std::string_view get(KnownHeader header) const {
+        auto index = slot(header);
+        return index == 0 ? std::string_view() : _headers[index - 1].second;
+    }
+    std::string_view get(std::string_view name) const {
+        auto header = find(name);
+        return header ? header->second : std::string_view();
+    }
+
+    // In the order they arrived.
+    const std::vector<Header>& headers() const {
+        return _headers;
+    }
+
+private:
+    static constexpr size_t NumKnownHeaders = static_cast<size_t>(KnownHeader::Cookie) + 1;
+
+    // One more than the header's index in _headers, or 0 if it's missing.
+    uint16_t slot(KnownHeader header) const {
+        return _known[static_cast<size_t>(header)];
+    }
+    const Header* find(std::string_view name) const;
+
+    std::unique_ptr<uint8_t[]> _block;
+    size_t _blockSize = 0;
+    std::vector<Header> _headers;
+    uint16_t _known[NumKnownHeaders] = {};
+};
+
+}
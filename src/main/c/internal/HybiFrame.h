@@ -0,0 +1,65 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace seasocks {
+
+// The header of a server to client frame. These are never masked, so the
+// header depends only on the first byte (FIN, RSV and opcode bits) and the
+// payload's length.
+struct HybiFrameHeader {
+    static constexpr size_t MaxSize = 10;
+
+    HybiFrameHeader(uint8_t firstByte, size_t payloadLength);
+
+    uint8_t bytes[MaxSize];
+    size_t size;
+};
+
+// A complete, uncompressed frame, encoded once to be sent unchanged to any
+// number of connections.
+struct SharedFrame {
+    static std::shared_ptr<const SharedFrame> encode(uint8_t opcode, const void* payload, size_t length);
+
+    const uint8_t* payload() const {
+        return bytes.data() + headerSize;
+    }
+    size_t payloadSize() const {
+        return bytes.size() - headerSize;
+    }
+
+    uint8_t opcode;
+    size_t headerSize;
+    // The header followed by the payload.
+    std::vector<uint8_t> bytes;
+};
+
+}
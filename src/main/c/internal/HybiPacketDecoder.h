@@ -36,11 +36,15 @@ namespace seasocks {
 
 class HybiPacketDecoder {
     Logger& _logger;
-    const std::vector<uint8_t>& _buffer;
+    const uint8_t* _buffer;
+    size_t _size;
     size_t _messageStart;
 
 public:
-    HybiPacketDecoder(Logger& logger, const std::vector<uint8_t>& buffer);
+    HybiPacketDecoder(Logger& logger, const uint8_t* buffer, size_t size);
+    HybiPacketDecoder(Logger& logger, const std::vector<uint8_t>& buffer)
+            : HybiPacketDecoder(logger, buffer.data(), buffer.size()) {
+    }
 
     enum class Opcode : uint8_t {
         Cont = 0x0, // Deprecated in latest hybi spec, here anyway.
@@ -55,15 +59,45 @@ public:
         NoMessage,
         TextMessage,
         BinaryMessage,
+        // A fragment following the first frame of a text or binary message.
+        Continuation,
         Error,
         Ping,
         Pong,
         Close
     };
-    MessageState decodeNextMessage(std::vector<uint8_t>& messageOut, bool& deflateNeeded);
+
+    struct FrameHeader {
+        Opcode opcode;
+        // Set on the last frame of a message, and on unfragmented ones.
+        bool fin;
+        // RSV1, set on the first frame of a message compressed with per-message deflate.
+        bool compressed;
+        // The masking key, in the order it arrived, as unmask() wants it.
+        uint32_t mask;
+        size_t headerSize;
+        uint64_t payloadLength;
+    };
+    // Parses the header of the next frame, leaving its payload undecoded.
+    // Returns NoMessage if the header hasn't all arrived yet, Error if it's
+    // malformed, else the state its payload will decode to.
+    MessageState peekNextFrame(FrameHeader& header) const;
+
+    // Decodes the next frame, which may be one fragment of a message: 'fin' is
+    // cleared if more fragments follow it.
+    MessageState decodeNextMessage(std::vector<uint8_t>& messageOut, bool& deflateNeeded, bool& fin);
+    MessageState decodeNextMessage(std::vector<uint8_t>& messageOut, bool& deflateNeeded) {
+        bool ignore;
+        return decodeNextMessage(messageOut, deflateNeeded, ignore);
+    }
     MessageState decodeNextMessage(std::vector<uint8_t>& messageOut) {
         bool ignore;
-        return decodeNextMessage(messageOut, ignore);
+        return decodeNextMessage(messageOut, ignore, ignore);
+    }
+    // Moves past the header and the first 'payloadBytes' of the next frame's
+    // payload, for callers decoding that themselves.
+    void skip(const FrameHeader& header, size_t payloadBytes) {
+        _messageStart += header.headerSize + payloadBytes;
     }
 
     size_t numBytesDecoded() const;
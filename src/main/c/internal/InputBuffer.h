@@ -0,0 +1,87 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace seasocks {
+
+// A connection's unconsumed input, held contiguously so parsers can look at it
+// in place. Reads go straight into uninitialised space at the end, consumed
+// bytes are skipped by advancing an offset, and what's left is only moved back
+// to the front when there isn't otherwise room for the next read.
+class InputBuffer {
+public:
+    InputBuffer() = default;
+
+    InputBuffer(const InputBuffer&) = delete;
+    InputBuffer& operator=(const InputBuffer&) = delete;
+
+    uint8_t* data() {
+        return _storage.get() + _begin;
+    }
+    const uint8_t* data() const {
+        return _storage.get() + _begin;
+    }
+    size_t size() const {
+        return _end - _begin;
+    }
+    bool empty() const {
+        return _begin == _end;
+    }
+    uint8_t& operator[](size_t index) {
+        return data()[index];
+    }
+    uint8_t operator[](size_t index) const {
+        return data()[index];
+    }
+
+    // Returns room for at least 'size' more bytes at the end, which count once
+    // commit()ted. The space is uninitialised, and is invalidated by anything
+    // but commit().
+    uint8_t* prepare(size_t size);
+    void commit(size_t size) {
+        _end += size;
+    }
+    // Drops 'size' bytes from the front.
+    void consume(size_t size);
+
+    void assign(const uint8_t* first, const uint8_t* last);
+    void append(const uint8_t* first, const uint8_t* last);
+    void clear() {
+        _begin = _end = 0;
+    }
+
+private:
+    std::unique_ptr<uint8_t[]> _storage;
+    size_t _capacity = 0;
+    size_t _begin = 0;
+    size_t _end = 0;
+};
+
+}
@@ -0,0 +1,137 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "seasocks/Response.h"
+#include "seasocks/ResponseWriter.h"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace seasocks {
+
+class PageHandler;
+class RaiiFd;
+class Request;
+class Server;
+class WorkerPool;
+
+// Implemented by the writer a Connection gives its responses, so an offloaded
+// handler that declines a request can pass it back to the rest of the chain.
+class HandlerChainWriter : public ResponseWriter {
+public:
+    // Runs the page handlers from 'nextHandler' on, as if none before it existed.
+    virtual void continueHandling(size_t nextHandler) = 0;
+};
+
+// Runs offloaded PageHandlers, and the Response the first to accept the request
+// returns, on the worker pool. It's also the ResponseWriter that Response is
+// given: calls are recorded under a lock and, at each flush, handed back to the
+// connection's reactor with a single execute() - there's no allocation per call.
+class OffloadedResponse : public Response,
+                          public ResponseWriter,
+                          public std::enable_shared_from_this<OffloadedResponse> {
+public:
+    using Handlers = std::vector<std::shared_ptr<PageHandler>>;
+
+    OffloadedResponse(Server& server, WorkerPool& pool, std::shared_ptr<Request> request,
+                      const Handlers& handlers, size_t firstHandler);
+
+    // From Response; called on the Seasocks thread.
+    void handle(std::shared_ptr<ResponseWriter> writer) override;
+    void cancel() override;
+
+    // From ResponseWriter; callable from any thread.
+    void begin(ResponseCode responseCode, TransferEncoding encoding) override;
+    void header(const std::string& header, const std::string& value) override;
+    void payload(const void* data, size_t size, bool flush) override;
+    void payloadFile(int fd, uint64_t offset, size_t length, bool flush) override;
+    void finish(bool keepConnectionOpen) override;
+    void error(ResponseCode responseCode, const std::string& payload) override;
+    bool isActive() const override;
+
+private:
+    enum class Op {
+        Begin,
+        Header,
+        Payload,
+        PayloadFile,
+        Finish,
+        Error,
+        Continue,
+    };
+    // Strings and payloads live in the accompanying buffer, at [offset, offset + length),
+    // followed by a header's value.
+    struct Call {
+        Op op;
+        ResponseCode responseCode = ResponseCode::Ok;
+        TransferEncoding encoding = TransferEncoding::Raw;
+        bool flag = false;
+        size_t nextHandler = 0;
+        size_t offset = 0;
+        size_t length = 0;
+        size_t valueLength = 0;
+        // Part of a file, through a descriptor of our own.
+        std::shared_ptr<RaiiFd> file = nullptr;
+        uint64_t fileOffset = 0;
+        size_t fileLength = 0;
+    };
+
+    void run();
+    void continueFrom(size_t nextHandler);
+    // Records a call, with any data it refers to. Flushing calls hand everything
+    // recorded so far to the Seasocks thread.
+    void record(Call call, bool flush, const void* data = nullptr, size_t length = 0,
+                const std::string& value = std::string());
+    // On the Seasocks thread: replays recorded calls onto the connection's writer.
+    void apply();
+
+    Server& _server;
+    WorkerPool& _pool;
+    std::shared_ptr<Request> _request;
+    const Handlers& _handlers;
+    const size_t _firstHandler;
+    std::atomic<bool> _active;
+
+    // Seasocks thread only.
+    std::shared_ptr<ResponseWriter> _writer;
+    std::vector<Call> _applying;
+    std::string _applyingData;
+
+    std::mutex _mutex;
+    bool _cancelled;
+    std::shared_ptr<Response> _response;
+    std::vector<Call> _calls;
+    std::string _data;
+    // Holds us alive while an apply() is queued.
+    std::shared_ptr<OffloadedResponse> _pendingApply;
+};
+
+}
@@ -0,0 +1,132 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+
+namespace seasocks {
+
+// A connection's pending output: a chain of segments, each either a fixed-size
+// block we copied data into, a borrowed, immutable run of someone else's bytes
+// (embedded content, a shared frame) kept alive by a reference, or part of a
+// file, to be sent from it directly.
+// Sent data is dropped from the front without moving what's left, and empty
+// blocks go back to a per-thread pool for reuse. Consecutive segments may share
+// a block, which belongs to the last of them.
+class OutputChain {
+public:
+    static constexpr size_t BlockSize = 16 * 1024;
+
+    OutputChain() = default;
+    ~OutputChain();
+
+    OutputChain(const OutputChain&) = delete;
+    OutputChain& operator=(const OutputChain&) = delete;
+
+    // Copies data onto the end of the chain.
+    void append(const void* data, size_t size);
+    // Queues data without copying it. It must stay valid and unchanged while
+    // 'owner' lives; a null owner means it lives forever.
+    void appendBorrowed(const void* data, size_t size, std::shared_ptr<const void> owner);
+    // Queues 'size' bytes of a file from 'offset', which are never read into memory
+    // (see file()). 'owner' keeps 'fd' open.
+    void appendFile(int fd, uint64_t offset, size_t size, std::shared_ptr<const void> owner);
+
+    // Writing in place: returns room at the end of the chain for at least 'size'
+    // bytes (at most BlockSize), setting 'room' to how much there is. commit()
+    // then appends the first 'size' bytes written there.
+    uint8_t* reserve(size_t size, size_t& room);
+    void commit(size_t size);
+    // Appends 'size' bytes (at most BlockSize) that start a segment of their own,
+    // for a header only known once what follows it has been written. Returns a
+    // mark for setHeader(), which is valid until the chain is next consumed.
+    size_t reserveHeader(size_t size);
+    // Writes the header over the end of the 'reserved' bytes at 'mark', dropping
+    // the rest of them.
+    void setHeader(size_t mark, size_t reserved, const void* header, size_t size);
+    // Drops bytes from the end, leaving 'size'.
+    void truncate(size_t size);
+
+    size_t size() const {
+        return _size;
+    }
+    bool empty() const {
+        return _size == 0;
+    }
+    // How much of the output is queued parts of files, and so takes no memory.
+    size_t fileBytes() const {
+        return _fileBytes;
+    }
+    // How much of the output is held in memory, copied or borrowed. This, rather
+    // than size(), is what's held to the client buffer limit: a borrowed segment
+    // may be shared, but a slow client still keeps it alive.
+    size_t memoryBytes() const {
+        return _size - _fileBytes;
+    }
+
+    // Describes up to 'maxIovecs' segments from the front, returning how many.
+    // Stops at the first part of a file.
+    int gather(iovec* iov, int maxIovecs) const;
+    // If the segment 'index' from the front is part of a file, sets 'fd' and
+    // 'offset' to where and returns its size; otherwise returns 0.
+    size_t file(size_t index, int& fd, uint64_t& offset) const;
+    // Whether the segment 'index' from the front is borrowed, setting 'owner' to
+    // what keeps it alive if so.
+    bool borrowed(size_t index, std::shared_ptr<const void>& owner) const;
+    // Drops 'bytes' from the front.
+    void consume(size_t bytes);
+    void clear();
+
+private:
+    struct Block;
+    struct Segment {
+        const uint8_t* data;
+        size_t size;
+        Block* block; // Null if borrowed or part of a file.
+        std::shared_ptr<const void> owner;
+        // For part of a file, which has no data.
+        int fd = -1;
+        uint64_t fileOffset = 0;
+    };
+
+    static Block* allocateBlock();
+    static void releaseBlock(Block* block);
+    // Whether the segments at these indices (either may be out of range) share a block.
+    bool shareBlock(size_t a, size_t b) const;
+    // Free space at the end of the last segment, if it's a block.
+    size_t tailSpace() const;
+
+    std::deque<Segment> _segments;
+    size_t _size = 0;
+    size_t _fileBytes = 0;
+};
+
+}
@@ -25,7 +25,7 @@
 
 #pragma once
 
-#include "internal/HeaderMap.h"
+#include "internal/HeaderStore.h"
 #include "seasocks/Request.h"
 
 #include <unordered_map>
@@ -39,9 +39,10 @@ class PageRequest : public Request {
     const std::string _requestUri;
     Server& _server;
     const Verb _verb;
-    std::vector<uint8_t> _content;
-    HeaderMap _headers;
-    const size_t _contentLength;
+    const uint8_t* _content = nullptr;
+    std::shared_ptr<const void> _contentOwner;
+    HeaderStore _headers;
+    size_t _contentLength;
 
 public:
     PageRequest(
@@ -49,7 +50,7 @@ public:
         const std::string& requestUri,
         Server& server,
         Verb verb,
-        HeaderMap&& headers);
+        HeaderStore&& headers);
 
     virtual Server& server() const override {
         return _server;
@@ -76,21 +77,33 @@ public:
     }
 
     virtual const uint8_t* content() const override {
-        return _contentLength > 0 ? &_content[0] : nullptr;
+        return _contentLength > 0 ? _content : nullptr;
     }
 
     virtual bool hasHeader(const std::string& name) const override {
-        return _headers.find(name) != _headers.end();
+        return _headers.has(name);
     }
 
     virtual std::string getHeader(const std::string& name) const override {
-        auto iter = _headers.find(name);
-        return iter == _headers.end() ? std::string() : iter->second;
+        return std::string(_headers.get(name));
     }
 
-    bool consumeContent(std::vector<uint8_t>& buffer);
+    virtual std::string_view getHeaderView(std::string_view name) const override {
+        return _headers.get(name);
+    }
+
+    bool hasHeader(KnownHeader header) const {
+        return _headers.has(header);
+    }
+
+    std::string_view getHeader(KnownHeader header) const {
+        return _headers.get(header);
+    }
+
+    // Supplies the body once it's all arrived, which stays valid while 'owner' lives.
+    void setContent(const uint8_t* content, size_t size, std::shared_ptr<const void> owner);
 
-    size_t getUintHeader(const std::string& name) const;
+    size_t getUintHeader(KnownHeader header) const;
 };
 
 } // namespace seasocks
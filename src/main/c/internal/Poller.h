@@ -0,0 +1,67 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <sys/epoll.h>
+
+#include <cstdint>
+#include <memory>
+
+namespace seasocks {
+
+// The readiness notification mechanism behind a Server's event loop. Events are
+// always described using the epoll bit values (EPOLLIN, EPOLLOUT etc), whatever
+// the backend. Methods return false (or -1) on failure, leaving errno set.
+class Poller {
+public:
+    virtual ~Poller() = default;
+
+    virtual const char* name() const = 0;
+
+    // A descriptor that becomes readable when wait() has events to return.
+    virtual int fd() const = 0;
+
+    // Backends that can't honour EPOLLEXCLUSIVE refuse it with EINVAL.
+    virtual bool add(int fd, uint32_t events, void* data) = 0;
+    virtual bool modify(int fd, uint32_t events, void* data) = 0;
+    virtual bool remove(int fd) = 0;
+
+    // Waits up to 'millis' (forever if negative) for events, filling in at most
+    // 'maxEvents'. Returns the number of events, or -1 on error.
+    virtual int wait(epoll_event* events, int maxEvents, int millis) = 0;
+
+    // Passes any batched registration changes on to the kernel without waiting.
+    // Needed before blocking on fd() outside of wait().
+    virtual bool submit() {
+        return true;
+    }
+};
+
+// Each returns nullptr (with errno set) if the backend can't be created.
+std::unique_ptr<Poller> makeEpollPoller();
+std::unique_ptr<Poller> makeIoUringPoller();
+
+}
@@ -0,0 +1,117 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "internal/Task.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace seasocks {
+
+class Connection;
+class ServerImpl;
+
+// The queue behind a WebSocket::Sender: a bounded, lock-free ring of messages
+// with a single producer (the thread using the Sender) and a single consumer
+// (the connection's reactor). Only the first message pushed since the reactor
+// last drained the queue costs a task on the reactor's executor; those that
+// follow it are picked up by the same drain.
+class SendQueue : public std::enable_shared_from_this<SendQueue> {
+public:
+    static constexpr size_t DefaultCapacity = 1024;
+
+    struct Message {
+        bool isBinary;
+        std::string text;
+        std::vector<uint8_t> binary;
+    };
+
+    SendQueue(ServerImpl& server, Connection& connection, size_t capacity = DefaultCapacity);
+
+    SendQueue(const SendQueue&) = delete;
+    SendQueue& operator=(const SendQueue&) = delete;
+
+    // Producer. Returns false, leaving the message untouched, if the connection
+    // has closed or the queue is full.
+    bool push(Message& message);
+    bool closed() const {
+        return _closed.load(std::memory_order_acquire);
+    }
+
+    // Consumer. Calls fn(Message&) for up to 'maxMessages' queued messages,
+    // arranging for the rest to be drained later.
+    template <typename Fn>
+    void consume(size_t maxMessages, Fn&& fn) {
+        // Pairs with the fence in push(): either we see its message, or it sees
+        // we're no longer scheduled and schedules us again.
+        _scheduled.store(false, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto head = _head.value.load(std::memory_order_relaxed);
+        auto tail = _tail.value.load(std::memory_order_acquire);
+        for (size_t i = 0; i < maxMessages && head != tail; ++i, ++head) {
+            auto& message = _slots[head & _mask];
+            fn(message);
+            // Free the payload here, rather than when the producer next reuses the slot.
+            message = Message();
+        }
+        _head.value.store(head, std::memory_order_release);
+        if (head != tail) {
+            schedule();
+        }
+    }
+
+    // Consumer. The connection is going away: later pushes fail, and anything
+    // queued is dropped with the queue.
+    void detach();
+
+private:
+    void schedule();
+    void drain();
+
+    // Keeps the producer's and consumer's positions on separate cache lines.
+    struct PaddedPosition {
+        std::atomic<size_t> value;
+        char padding[64 - sizeof(std::atomic<size_t>)];
+    };
+
+    ServerImpl& _server;
+    Connection* _connection; // Consumer only; null once detached.
+    const size_t _mask;
+    std::unique_ptr<Message[]> _slots;
+    PaddedPosition _head;
+    PaddedPosition _tail;
+    // The consumer's position as last seen by the producer.
+    size_t _headCache;
+    std::atomic<bool> _scheduled;
+    std::atomic<bool> _closed;
+};
+
+}
@@ -0,0 +1,139 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace seasocks {
+
+// A type-erased void() callable. Callables small enough (a std::function, or a
+// lambda capturing a few pointers) are stored inline, so tasks can be queued
+// without allocating.
+class Task {
+public:
+    static constexpr size_t InlineSize = 40;
+
+    Task() = default;
+
+    template <typename Fn, typename = std::enable_if_t<!std::is_same<std::decay_t<Fn>, Task>::value>>
+    explicit Task(Fn&& fn) {
+        using Stored = std::decay_t<Fn>;
+        construct<Stored>(std::forward<Fn>(fn),
+                          std::integral_constant<bool, sizeof(Stored) <= InlineSize
+                                                           && alignof(Stored) <= alignof(std::max_align_t)
+                                                           && std::is_nothrow_move_constructible<Stored>::value>());
+    }
+
+    Task(Task&& other) noexcept {
+        take(other);
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            take(other);
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        reset();
+    }
+
+    explicit operator bool() const {
+        return _ops != nullptr;
+    }
+
+    void operator()() {
+        _ops->invoke(_storage);
+    }
+
+    void reset() {
+        if (_ops) {
+            _ops->destroy(_storage);
+            _ops = nullptr;
+        }
+    }
+
+private:
+    struct Ops {
+        void (*invoke)(void* storage);
+        // Move constructs into 'to' and destroys what's left in 'from'.
+        void (*relocate)(void* from, void* to);
+        void (*destroy)(void* storage);
+    };
+
+    template <typename Stored>
+    static const Ops inlineOps;
+    template <typename Stored>
+    static const Ops heapOps;
+
+    template <typename Stored, typename Fn>
+    void construct(Fn&& fn, std::true_type /*inline*/) {
+        new (_storage) Stored(std::forward<Fn>(fn));
+        _ops = &inlineOps<Stored>;
+    }
+
+    template <typename Stored, typename Fn>
+    void construct(Fn&& fn, std::false_type /*inline*/) {
+        *reinterpret_cast<Stored**>(_storage) = new Stored(std::forward<Fn>(fn));
+        _ops = &heapOps<Stored>;
+    }
+
+    void take(Task& other) {
+        if (other._ops) {
+            other._ops->relocate(other._storage, _storage);
+            _ops = other._ops;
+            other._ops = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char _storage[InlineSize];
+    const Ops* _ops = nullptr;
+};
+
+template <typename Stored>
+const Task::Ops Task::inlineOps = {
+    [](void* storage) { (*static_cast<Stored*>(storage))(); },
+    [](void* from, void* to) {
+        new (to) Stored(std::move(*static_cast<Stored*>(from)));
+        static_cast<Stored*>(from)->~Stored();
+    },
+    [](void* storage) { static_cast<Stored*>(storage)->~Stored(); }};
+
+template <typename Stored>
+const Task::Ops Task::heapOps = {
+    [](void* storage) { (**static_cast<Stored**>(storage))(); },
+    [](void* from, void* to) { *static_cast<Stored**>(to) = *static_cast<Stored**>(from); },
+    [](void* storage) { delete *static_cast<Stored**>(storage); }};
+
+}
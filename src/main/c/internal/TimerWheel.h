@@ -0,0 +1,116 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "internal/Task.h"
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace seasocks {
+
+// A hierarchical timing wheel with millisecond ticks. Scheduling and cancelling
+// are O(1); each timer is cascaded down at most once per level on its way to
+// expiry. Four levels of 64 slots cover about four and a half hours; timers
+// further out are parked in the top level and re-placed until they're in range.
+//
+// Timers are identified by an index into a pool of entries, tagged with a
+// generation so stale identifiers are harmless.
+class TimerWheel {
+public:
+    using Id = uint64_t;
+    static constexpr uint64_t Never = std::numeric_limits<uint64_t>::max();
+
+    explicit TimerWheel(uint64_t nowMillis);
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // Schedules 'task' to run at or after 'deadlineMillis'. Never returns 0.
+    Id schedule(uint64_t deadlineMillis, Task&& task);
+    // Returns false if the timer has already run or been cancelled.
+    bool cancel(Id id);
+
+    // Runs every timer due by 'nowMillis', including any scheduled as a result
+    // that are also due. Returns the number run.
+    size_t advance(uint64_t nowMillis);
+
+    // The next tick at which advance() has something to do - either run timers
+    // or cascade them closer to expiry - or Never if there are no timers.
+    uint64_t nextTick() const;
+
+    size_t size() const {
+        return _size;
+    }
+    uint64_t now() const {
+        return _now;
+    }
+
+private:
+    static constexpr unsigned LevelBits = 6;
+    static constexpr unsigned SlotsPerLevel = 1u << LevelBits;
+    static constexpr unsigned NumLevels = 4;
+    static constexpr uint64_t MaxDelta = (uint64_t(1) << (LevelBits * NumLevels)) - 1;
+    static constexpr uint32_t Nil = std::numeric_limits<uint32_t>::max();
+
+    struct Entry {
+        uint64_t deadline;
+        Task task;
+        uint32_t generation;
+        uint32_t slot;
+        uint32_t prev;
+        uint32_t next;
+    };
+
+    // Each slot is a list, in the order timers were placed in it, so timers due
+    // at the same time run in the order they were scheduled.
+    struct Level {
+        std::array<uint32_t, SlotsPerLevel> heads;
+        std::array<uint32_t, SlotsPerLevel> tails;
+        // Bit n is set if slot n has entries.
+        uint64_t occupied;
+    };
+
+    void place(uint32_t index);
+    void link(uint32_t index, unsigned level, unsigned slot);
+    void unlink(uint32_t index);
+    void release(uint32_t index);
+    uint64_t nextTickAt(unsigned level) const;
+    void cascade(unsigned level);
+    size_t expire();
+
+    uint64_t _now;
+    size_t _size;
+    // Set while running timers, so any they schedule for now run on the next tick.
+    bool _expiring;
+    std::array<Level, NumLevels> _levels;
+    std::vector<Entry> _entries;
+    std::vector<uint32_t> _free;
+};
+
+}
@@ -0,0 +1,65 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace seasocks {
+
+class Connection;
+
+// One reactor's topic subscriptions, with an index from each connection to its
+// topics so they can all be dropped when it closes.
+class TopicRegistry {
+public:
+    // Both return false if nothing changed.
+    bool subscribe(Connection* connection, const std::string& topic);
+    bool unsubscribe(Connection* connection, const std::string& topic);
+    void unsubscribeAll(Connection* connection);
+
+    // Calls fn(Connection*) for each subscriber, returning how many there were.
+    template <typename Fn>
+    size_t forEachSubscriber(const std::string& topic, Fn&& fn) const {
+        auto it = _subscribers.find(topic);
+        if (it == _subscribers.end()) {
+            return 0;
+        }
+        for (auto connection : it->second) {
+            fn(connection);
+        }
+        return it->second.size();
+    }
+
+private:
+    std::unordered_map<std::string, std::unordered_set<Connection*>> _subscribers;
+    std::unordered_map<Connection*, std::vector<std::string>> _topics;
+};
+
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace seasocks {
+
+// Checks text is well-formed UTF-8, a piece at a time, so a character may be
+// split between pieces. Runs of ASCII are skipped 16 or 32 bytes at a time with
+// SSE2 or AVX2, and on x86 anything else is checked a vector at a time with
+// lookup tables (after Keiser and Lemire, "Validating UTF-8 In Less Than One
+// Instruction Per Byte") if the CPU has SSSE3 or AVX2 at run time. Elsewhere
+// ASCII is skipped eight bytes at a time, and the rest checked byte by byte.
+class Utf8Validator {
+public:
+    // Checks the next piece, returning false once anything seen is invalid.
+    bool feed(const uint8_t* data, size_t size);
+    // Whether everything seen is valid, and doesn't stop part way through a character.
+    bool complete() const {
+        return _valid && _needed == 0;
+    }
+    void reset() {
+        _valid = true;
+        _needed = 0;
+        _lower = 0x80;
+        _upper = 0xbf;
+    }
+
+private:
+    // Checks the next byte, carrying on from any partial character.
+    void feedByte(uint8_t byte);
+
+    bool _valid = true;
+    // Continuation bytes still to come for the current character, and the
+    // range the next of them must be in.
+    uint8_t _needed = 0;
+    uint8_t _lower = 0x80;
+    uint8_t _upper = 0xbf;
+};
+
+bool isValidUtf8(const uint8_t* data, size_t size);
+
+// Unmasks as unmask() does, checking the result with 'validator' as it goes, a
+// piece small enough to still be in cache at a time, so that the text is only
+// brought in from memory once. Returns what the validator's feed() does.
+bool unmaskUtf8(uint8_t* dest, const uint8_t* source, size_t size, uint32_t key,
+                Utf8Validator& validator);
+
+}
@@ -0,0 +1,68 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+
+namespace seasocks {
+
+// What a socket's MSG_ZEROCOPY sends need kept alive until the kernel reports,
+// on the socket's error queue, that it has finished with them. Outlives the
+// connection that made the sends if it closes first (see ServerImpl::lingerZeroCopy).
+class ZeroCopySends {
+public:
+    // Records a send that sent something: the kernel numbers them in order.
+    void sent(std::shared_ptr<const void> owner);
+    // Reads the completions waiting on the socket's error queue, releasing what
+    // the completed sends kept alive. Returns whether the kernel had to copy any
+    // of them after all.
+    bool reap(int fd);
+
+    bool empty() const {
+        return _pending.empty();
+    }
+    size_t sends() const {
+        return _sends;
+    }
+    size_t completions() const {
+        return _completions;
+    }
+
+private:
+    struct Send {
+        uint32_t id;
+        std::shared_ptr<const void> owner;
+    };
+    std::deque<Send> _pending;
+    uint32_t _nextId = 0;
+    size_t _sends = 0;
+    size_t _completions = 0;
+};
+
+}
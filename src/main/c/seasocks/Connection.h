@@ -34,19 +34,34 @@
 #include <netinet/in.h>
 
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 #include <cinttypes>
+#include <ctime>
+#include <deque>
 #include <list>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 
 namespace seasocks {
 
+class BodyBuffer;
+class BodyDecoder;
+class BodyHandler;
+class HeaderStore;
+class InputBuffer;
 class Logger;
+class OutputChain;
 class ServerImpl;
 class PageRequest;
+class RaiiFd;
+class ZeroCopySends;
+class SendQueue;
+struct SharedFrame;
+class Utf8Validator;
 class Response;
 
 class Connection : public WebSocket {
@@ -66,10 +81,33 @@ public:
         return _fd;
     }
 
+    // Relinquishes ownership of the socket without closing it or notifying any
+    // handler, leaving this connection closed. Used to hand a connection to another
+    // reactor, along with any zero-copy sends still in flight on the socket.
+    int releaseFd(std::unique_ptr<ZeroCopySends>& zeroCopySends);
+    // Processes input read by a previous owner of this connection's socket, taking
+    // on its zero-copy sends.
+    void replayInput(std::vector<uint8_t>&& input, std::unique_ptr<ZeroCopySends> zeroCopySends);
+
     // From WebSocket.
     virtual void send(const char* webSocketResponse) override;
     virtual void send(const uint8_t* webSocketResponse, size_t length) override;
+    virtual void compose(Opcode opcode, size_t sizeHint, const std::function<void(Composer&)>& write) override;
     virtual void close() override;
+    virtual Sender sender() override;
+
+    // Sends output held back by auto-cork (see Server::setAutoCork).
+    void flushDeferred();
+    // Reads the completions of zero-copy sends from the socket's error queue.
+    // Returns false if the socket has a real error.
+    bool handleErrorQueue();
+
+    // Sends a batch of the messages queued by this connection's Senders.
+    void drainSendQueue();
+    // Sends a frame shared with other connections, queueing a reference to it
+    // rather than a copy if it can't all go at once. Connections that must
+    // encode frames themselves (deflate, Hixie) send its payload as usual.
+    void sendShared(const std::shared_ptr<const SharedFrame>& frame);
 
     // From Request.
     virtual std::shared_ptr<Credentials> credentials() const override;
@@ -88,16 +126,13 @@ public:
     }
     virtual bool hasHeader(const std::string&) const override;
     virtual std::string getHeader(const std::string&) const override;
+    virtual std::string_view getHeaderView(std::string_view) const override;
     virtual Server& server() const override;
 
     void setLinger();
 
-    size_t inputBufferSize() const {
-        return _inBuf.size();
-    }
-    size_t outputBufferSize() const {
-        return _outBuf.size();
-    }
+    size_t inputBufferSize() const;
+    size_t outputBufferSize() const;
 
     size_t bytesReceived() const {
         return _bytesReceived;
@@ -107,8 +142,8 @@ public:
     }
 
     // For testing:
-    std::vector<uint8_t>& getInputBuffer() {
-        return _inBuf;
+    InputBuffer& getInputBuffer() {
+        return *_input;
     }
     void handleHixieWebSocket();
     void handleHybiWebSocket();
@@ -129,16 +164,59 @@ private:
     void closeWhenEmpty();
     void closeInternal();
 
+    void processInput();
+    // The size of the headers at the front of the input (without the blank
+    // line after them), or npos if they've not all arrived.
+    size_t findEndOfHeaders();
     void handleHeaders();
+    // Parses further complete requests while answering one, up to the pipeline
+    // depth, noting if reading should stop until the pipeline moves on.
+    void pipelineRequests();
+    void handlePipelinedRequest();
     void handleWebSocketKey3();
-    void handleWebSocketTextMessage(const char* message);
-    void handleWebSocketBinaryMessage(const std::vector<uint8_t>& message);
+    void handleWebSocketTextMessage(std::string_view message);
+    void handleWebSocketBinaryMessage(Span<const uint8_t> message);
+    // Unmasks part of a data frame in place, checking the text of messages
+    // that need it. Returns false if it isn't valid UTF-8, or, if 'last' is
+    // set, if it stops part way through a character.
+    bool unmaskPayload(uint8_t* payload, size_t size, uint32_t mask, bool last);
+    bool validatesUtf8() const;
+    bool validatesSentUtf8() const;
+    // Delivers the rest of a frame being streamed to the handler, as it arrives.
+    void continueStreamedFrame();
+    // Passes a piece of the current message to a streaming handler.
+    void deliverFragment(const uint8_t* data, size_t length, bool last);
+    // Handles a complete (and reassembled) text or binary message. The byte
+    // after it must be writable, so that text can be NUL terminated in place.
+    // 'inInput' says whether it's still in the input, rather than copied out.
+    void finishMessage(uint8_t* message, size_t size, bool inInput);
+    // For handlers that batch messages: adds one to the batch, or delivers it.
+    void batchMessage(bool isText, uint8_t* message, size_t size, bool inInput);
+    void deliverMessageBatch();
+    size_t maxWebSocketMessageSize() const;
+    // Sends a close frame with the given status, and closes once it's gone.
+    void closeWithStatus(uint16_t status);
     void handleBufferingPostData();
-    bool handlePageRequest();
+    // Answers _request now its body has all been read.
+    bool finishRequestBody();
+    // Offers the request to the page handlers from 'firstHandler' on.
+    bool handlePageRequest(size_t firstHandler = 0);
+    // Resumes the handler chain after an offloaded handler declined the request.
+    void continuePageRequest(size_t nextHandler);
+
+    ssize_t readSome(size_t size);
+    void drainSocket();
+    // Stops reading while too much input is waiting on a response, and starts again.
+    void updateReadInterest();
 
     bool bufferLine(const char* line);
     bool bufferLine(const std::string& line);
+    // Sends what it can of the output now, unless auto-corking, in which case
+    // that's usually left to the end of the loop's pass.
     bool flush();
+    // With 'moreToCome', sends with MSG_MORE, keeping back the last segment to send
+    // without it later.
+    bool flushNow(bool moreToCome);
 
     bool handleHybiHandshake(int webSocketVersion, const std::string& webSocketKey);
 
@@ -151,15 +229,21 @@ private:
     bool sendBadRequest(const std::string& reason);
     bool sendISE(const std::string& error);
 
+    void sendText(const char* webSocketResponse, size_t messageLength, bool flush);
+    void sendHixieText(const char* text, size_t length, bool flush);
     void sendHybi(uint8_t opcode, const uint8_t* webSocketResponse,
-                  size_t messageLength);
-    void sendHybiData(const uint8_t* webSocketResponse, size_t messageLength);
+                  size_t messageLength, bool flush = true);
+    void sendHybiData(uint8_t firstByte, const uint8_t* webSocketResponse, size_t messageLength, bool flush);
 
 
     bool sendResponse(std::shared_ptr<Response> response);
 
-    bool processHeaders(uint8_t* first, uint8_t* last);
-    bool sendData(const std::string& type, const char* start, size_t size);
+    bool processHeaders(HeaderStore&& headers);
+    // Sets up reading _request's body, if it has one, or answers it if not.
+    bool startRequestBody();
+    // Answers _request, once all its content has arrived.
+    bool dispatchRequest();
+    bool sendData(const std::string& type, const char* start, size_t size, bool embedded = false);
     bool sendHeader(const std::string& type, size_t size);
 
     // Delegated from ResponseWriter.
@@ -167,50 +251,150 @@ private:
     void begin(ResponseCode responseCode, TransferEncoding encoding);
     void header(const std::string& header, const std::string& value);
     void payload(const void* data, size_t size, bool flush);
+    void payloadFile(int fd, uint64_t offset, size_t length, bool flush);
     void finish(bool keepConnectionOpen);
     void error(ResponseCode responseCode, const std::string& payload);
 
     struct Range {
-        long start;
-        long end;
+        int64_t start;
+        int64_t end;
         size_t length() const {
-            return end - start + 1;
+            return static_cast<size_t>(end - start + 1);
         }
     };
 
     bool parseRange(const std::string& rangeStr, Range& range) const;
     bool parseRanges(const std::string& range, std::list<Range>& ranges) const;
+    // Where a requested range falls in a file of the given size.
+    static Range clampRange(Range range, int64_t fileSize);
     bool sendStaticData();
 
+    // A static file opened to be sent; 'fd' is null if it couldn't be.
+    struct StaticFile {
+        std::shared_ptr<RaiiFd> fd;
+        int64_t size = 0;
+        time_t modified = 0;
+    };
+    // With 'readAhead', waits for the start of each range to be read in too, so
+    // it can be sent without waiting on the disk.
+    static StaticFile openStaticFile(const std::string& path, const std::list<Range>& ranges, bool readAhead);
+    // A missing file is a 404 even if the Range header was bad ('badRange').
+    bool sendStaticFile(const std::string& path, const StaticFile& file, const std::list<Range>& ranges,
+                        bool badRange);
+    // Answers the request once its file has been opened off the loop.
+    void finishStaticData(const std::string& path, const StaticFile& file, const std::list<Range>& ranges,
+                          bool badRange);
+
     ssize_t safeSend(const void* data, size_t size);
+    ssize_t safeSendv(const iovec* iov, int count, bool moreToCome);
+    // Sends a borrowed segment with MSG_ZEROCOPY, keeping 'owner' until the kernel
+    // has finished with it.
+    ssize_t sendZeroCopy(const iovec& iov, std::shared_ptr<const void> owner, bool moreToCome);
+    // Turns on SO_ZEROCOPY if it isn't already, returning whether it's on.
+    bool enableZeroCopy();
+    // Queues data without copying it (see OutputChain::appendBorrowed), then flushes.
+    bool writeBorrowed(const void* data, size_t size, std::shared_ptr<const void> owner);
+    // Whether 'size' more bytes of output can be queued in memory without reaching
+    // the client buffer limit (see OutputChain::memoryBytes()). If not, closes the
+    // connection.
+    bool roomToBuffer(size_t size);
+    // Queues part of a file to be sent with sendfile() as the socket has room.
+    bool writeFile(int fd, uint64_t offset, size_t size, std::shared_ptr<const void> owner, bool flush);
+    ssize_t safeSendfile(int fd, uint64_t offset, size_t size);
 
     void bufferResponseAndCommonHeaders(ResponseCode code);
 
-    std::list<Range> processRangesForStaticData(const std::list<Range>& ranges, long fileSize);
+    std::list<Range> processRangesForStaticData(const std::list<Range>& ranges, int64_t fileSize);
+
+    Logger* logger() const;
 
-    std::shared_ptr<Logger> _logger;
+    std::shared_ptr<Logger> _serverLogger;
+    mutable std::unique_ptr<Logger> _logger;
     ServerImpl& _server;
     int _fd;
     bool _shutdown;
     bool _hadSendError;
     bool _closeOnEmpty;
     bool _registeredForWriteEvents;
+    // Whether flushes are left to the end of the loop's pass, and if one is due.
+    bool _corks;
+    bool _flushDeferred;
+    // Set while we've stopped reading, as too much input is waiting to be consumed.
+    bool _readPaused;
+    // Zero-copy sends: how big a segment must be to go that way (0 once it's not
+    // to be used), and the sends in flight, present once the socket has SO_ZEROCOPY on.
+    size_t _zeroCopyThreshold;
+    std::unique_ptr<ZeroCopySends> _zeroCopySends;
     sockaddr_in _address;
     size_t _bytesSent;
+    // Counted for tests, which read it through ConnectionTestAccess.
+    friend struct ConnectionTestAccess;
+    size_t _sendCalls;
     size_t _bytesReceived;
-    std::vector<uint8_t> _inBuf;
-    std::vector<uint8_t> _outBuf;
+    size_t _lastBurstSize;
+    std::unique_ptr<InputBuffer> _input;
+    // Where the ConnectionTable keeps us, if it made us.
+    friend class ConnectionTable;
+    uint32_t _tableSlot;
+    // How much of the input has already been searched for the end of the headers.
+    size_t _headerScanOffset;
+    // Set when no more requests can be pipelined from the input, as the pipeline
+    // is full or the next request's headers are already too big.
+    bool _pipelineStalled;
+    // Set while handling input, so that anything which would handle more
+    // (such as finishing a response) leaves it to the loop already doing so.
+    bool _handlingInput;
+    bool _moreInput;
+    std::unique_ptr<OutputChain> _output;
     std::shared_ptr<WebSocket::Handler> _webSocketHandler;
     bool _shutdownByUser;
-    std::unique_ptr<PageRequest> _request;
+    std::shared_ptr<PageRequest> _request;
+    // Requests that arrived while answering _request, oldest first.
+    std::deque<std::shared_ptr<PageRequest>> _pipeline;
+    // While reading a request body: where it goes, either streamed to a page
+    // handler's BodyHandler or collected in a BodyBuffer.
+    std::unique_ptr<BodyDecoder> _bodyDecoder;
+    std::shared_ptr<BodyHandler> _bodyHandler;
+    std::unique_ptr<BodyBuffer> _bodyBuffer;
     std::shared_ptr<Response> _response;
     TransferEncoding _transferEncoding;
     unsigned _chunk;
     std::shared_ptr<Writer> _writer;
+    std::shared_ptr<SendQueue> _sendQueue;
+
+    // The WebSocket message being received, when it spans more than one frame:
+    // its type, whether it's compressed, and how big it is so far. Unless it's
+    // being streamed to the handler, its payload is collected in _fragments.
+    bool _inMessage = false;
+    bool _messageIsText = false;
+    bool _messageCompressed = false;
+    // Whether its text is being checked as it's unmasked, and the check so far.
+    bool _checkingUtf8 = false;
+    std::unique_ptr<Utf8Validator> _utf8;
+    size_t _messageSize = 0;
+    std::vector<uint8_t> _fragments;
+    // The rest of a frame being streamed to the handler: the payload still to
+    // come, the mask for it, and whether the frame ends its message.
+    uint64_t _streamedFrameRemaining = 0;
+    uint32_t _streamedFrameMask = 0;
+    bool _streamedFrameFin = false;
+    // Messages decoded from the current input, for handlers that batch them. Most
+    // point into the input; those that don't are copied into _batchStorage, at the
+    // offsets in _batchCopies, and the views fixed up on delivery.
+    std::vector<MessageView> _batch;
+    std::vector<size_t> _batchCopies;
+    std::vector<uint8_t> _batchStorage;
+    std::vector<uint8_t> _batchFollowing;
+    // Set while a handler composes a message in the output, which nothing else
+    // may be written to meanwhile.
+    bool _composing = false;
 
     void parsePerMessageDeflateHeader(const std::string& header);
     bool _perMessageDeflate = false;
     ZlibContext zlibContext;
+    // Scratch space for inflating and deflating messages, kept between them.
+    std::vector<uint8_t> _inflated;
+    std::vector<uint8_t> _deflated;
 
     void pickProtocol();
 
@@ -28,6 +28,8 @@
 #include "seasocks/Credentials.h"
 #include "seasocks/Response.h"
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
 
@@ -35,11 +37,40 @@ namespace seasocks {
 
 class Request;
 
+// Receives a request body as it arrives, rather than once it's all been buffered.
+// Chunks are only valid for the duration of the call. Both calls are made on the
+// Seasocks thread.
+class BodyHandler {
+public:
+    virtual ~BodyHandler() = default;
+
+    virtual void onBodyChunk(const uint8_t* data, size_t size) = 0;
+    // Called once the whole body has been seen; the Response answers the request.
+    // As with PageHandler::handle(), Response::unhandled() falls back to static files.
+    virtual std::shared_ptr<Response> onBodyEnd() = 0;
+};
+
 class PageHandler {
 public:
     virtual ~PageHandler() = default;
 
     virtual std::shared_ptr<Response> handle(const Request& request) = 0;
+
+    // Handlers that may block - on a database, say - can ask to run on the
+    // server's worker pool instead of the Seasocks thread. Both handle() and the
+    // Response it returns then run there, and the Response is given a
+    // ResponseWriter which may be used from any thread. Should the handler
+    // decline the request, the handlers after it see it as usual.
+    virtual bool offloaded() const {
+        return false;
+    }
+
+    // Offered each request with a body before it's read. Returning a BodyHandler
+    // streams the body to it instead of buffering it, and skips handle()
+    // altogether. Always called on the Seasocks thread, even for offloaded handlers.
+    virtual std::shared_ptr<BodyHandler> bodyHandler(const Request& /*request*/) {
+        return nullptr;
+    }
 };
 
 }
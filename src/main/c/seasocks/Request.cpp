@@ -68,4 +68,16 @@ Request::Verb Request::verb(const char* verb) {
     return Request::Verb::Invalid;
 }
 
+std::string_view Request::getHeaderView(std::string_view name) const {
+    auto found = _headerCopies.find(name);
+    if (found == _headerCopies.end()) {
+        std::string header(name);
+        if (!hasHeader(header)) {
+            return {};
+        }
+        found = _headerCopies.emplace(header, getHeader(header)).first;
+    }
+    return found->second;
+}
+
 } // namespace seasocks
@@ -30,7 +30,11 @@
 #include <netinet/in.h>
 
 #include <cstdint>
+#include <functional>
+#include <map>
 #include <memory>
+#include <string>
+#include <string_view>
 
 namespace seasocks {
 
@@ -74,6 +78,17 @@ public:
     virtual bool hasHeader(const std::string& name) const = 0;
 
     virtual std::string getHeader(const std::string& name) const = 0;
+
+    /**
+     * Returns the named header's value without copying it, or an empty view if
+     * there's no such header. The view is only valid as long as the request is.
+     * By default it views a copy from getHeader(), kept for the request's lifetime;
+     * requests that hold their headers can override it to avoid the copy.
+     */
+    virtual std::string_view getHeaderView(std::string_view name) const;
+
+private:
+    mutable std::map<std::string, std::string, std::less<>> _headerCopies;
 };
 
 } // namespace seasocks
@@ -28,12 +28,15 @@
 #include "seasocks/ResponseCode.h"
 #include "seasocks/TransferEncoding.h"
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 namespace seasocks {
 
 // An interface to write a response to a Request. All methods must be called
-// from the Seasocks main thread. Safe in the presence of closed connections:
+// from the Seasocks main thread, unless the response came from an offloaded
+// PageHandler, whose writers may be used from any thread. Safe in the presence of closed connections:
 // writes to connections that have closed are silently dropped. Responses that
 // wish to take note of closed connections must use their cancel() callback.
 class ResponseWriter {
@@ -55,6 +58,12 @@ public:
     // data should be sent immediately, or buffered to be sent with a subsequent
     // call to 'payload', or 'finish'.
     virtual void payload(const void* data, size_t size, bool flush = true) = 0;
+    // Add 'length' bytes of a file from 'offset' as payload. Connections send it
+    // straight from the file (with sendfile()) as the socket has room, never
+    // holding it in memory. The writer keeps its own descriptor for the file, so
+    // 'fd' may be closed as soon as this returns. By default, reads it in and
+    // passes it to 'payload'.
+    virtual void payloadFile(int fd, uint64_t offset, size_t length, bool flush = true);
     // Finish a response.
     virtual void finish(bool keepConnectionOpen) = 0;
 
@@ -62,6 +71,7 @@ public:
     // or 'finish' should be executed. If you wish to serve your own error document
     // then use the normal 'begin'/'header'/'payload'/'finish' process but with
     // an error code. This routine is to get Seasocks to generate its own error.
+    // Called after 'begin', it cuts the response short and closes the connection.
     virtual void error(ResponseCode responseCode, const std::string& payload) = 0;
     // Check whether this writer is still active; i.e. the underlying connection
     // is still open.
@@ -31,6 +31,7 @@
 #include <sys/types.h>
 
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <functional>
 #include <list>
@@ -38,15 +39,26 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 namespace seasocks {
 
 class Connection;
+class ConnectionTable;
+class ExecutorQueue;
 class Logger;
 class PageHandler;
+class Poller;
 class Request;
 class Response;
+struct SharedFrame;
+class Task;
+class TimerWheel;
+class TopicRegistry;
+class WorkerPool;
+class ZeroCopySends;
 
 class Server : private ServerImpl {
 public:
@@ -96,8 +108,22 @@ public:
     // Returns a file descriptor that can be polled for changes (e.g. by
     // placing it in an epoll set. The poll() method above only need be called
     // when this file descriptor is readable.
-    int fd() const {
-        return _epollFd;
+    int fd() const;
+
+    // The mechanism the event loop uses to wait on its sockets. IoUring only
+    // replaces epoll for readiness: changes to what's waited for are queued and
+    // handed to the kernel along with the next wait, saving the epoll_ctl()
+    // calls, but connections still read, write and accept with a system call
+    // each. If the kernel (or this build) lacks io_uring support, epoll is used
+    // instead.
+    enum class LoopBackend {
+        Epoll,
+        IoUring,
+    };
+    // Must be called before listening. Returns the backend actually in use.
+    LoopBackend setLoopBackend(LoopBackend backend);
+    LoopBackend loopBackend() const {
+        return _loopBackend;
     }
 
     // Terminate any loop() or poll(). May be called from any thread.
@@ -105,6 +131,7 @@ public:
 
     // If we haven't heard anything ever on a connection for this long, kill it.
     // This is possibly caused by bad WebSocket implementation in Chrome.
+    // Applies to connections accepted after the call.
     void setLameConnectionTimeoutSeconds(int seconds);
 
     // Sets the maximum number of TCP level keepalives that we can miss before
@@ -115,14 +142,120 @@ public:
     void setMaxKeepAliveDrops(int maxKeepAliveDrops);
 
     // Set the maximum amount of data we'll buffer for a client before we close the
-    // connection assuming the client can't keep up with the data rate. Default
-    // is available here too.
+    // connection assuming the client can't keep up with the data rate. Published
+    // frames and embedded content waiting to be sent count, though they aren't
+    // copied; parts of static files waiting to be sent from the file don't.
+    // Default is available here too.
     static constexpr size_t DefaultClientBufferSize = 16 * 1024 * 1024u;
     void setClientBufferSize(size_t bytesToBuffer);
     size_t clientBufferSize() const override {
         return _clientBufferSize;
     }
 
+    // Sets how many further requests we'll read and queue on a keep-alive connection
+    // while still answering an earlier one (HTTP pipelining). They're answered in
+    // order as soon as the one before finishes. 0 stops us reading ahead, though
+    // requests that have already arrived are still answered in turn. Applies to
+    // reactors started after the call. Default is available here too.
+    static constexpr size_t DefaultPipelineDepth = 16;
+    void setPipelineDepth(size_t depth);
+    size_t pipelineDepth() const override {
+        return _pipelineDepth;
+    }
+
+    // Request bodies bigger than this many bytes are written to an anonymous temporary
+    // file (in $TMPDIR, else /tmp) as they arrive instead of being held in memory; the
+    // handler sees the file mapped into memory. 0, the default, never spills.
+    void setRequestBodySpillThreshold(size_t bytes);
+    size_t requestBodySpillThreshold() const override {
+        return _requestBodySpillThreshold;
+    }
+
+    // Sets the largest request body we'll accept when it's spilled to disk or streamed
+    // to a BodyHandler; bigger ones get a 413. Bodies buffered in memory are limited
+    // by the client buffer size instead. Default is available here too.
+    static constexpr size_t DefaultMaxRequestBodySize = 1024 * 1024 * 1024u;
+    void setMaxRequestBodySize(size_t bytes);
+    size_t maxRequestBodySize() const override {
+        return _maxRequestBodySize;
+    }
+
+    // Sets the number of reactor threads used to service connections. Each reactor
+    // has its own epoll set and its own SO_REUSEPORT listening socket, so the kernel
+    // spreads incoming connections across them. Handlers are called on the reactor
+    // that owns the connection, and must therefore be thread-safe unless they restrict
+    // themselves to a single reactor (see WebSocket::Handler::runsOnReactor).
+    // Must be called before startListening(). Reactor 0 is the thread calling loop()
+    // or poll(); the others are started by the first call to either.
+    void setReactorCount(size_t count);
+    size_t reactorCount() const {
+        return _reactorCount;
+    }
+    // The index of the reactor this Server instance represents: 0 for the Server
+    // created by the user, 1 upwards for the additional reactors.
+    size_t reactorIndex() const {
+        return _reactorIndex;
+    }
+
+    // In edge-triggered mode connections are registered once for input, output and
+    // remote hang-up with EPOLLET. Each notification drains the socket until it would
+    // block, with reads sized from the previous burst, up to 1MB a pass; the rest is
+    // read on the next pass, so one busy client can't starve the others. There's no
+    // need to change registrations as output buffers fill and empty. Must be called
+    // before listening.
+    void setEdgeTriggered(bool edgeTriggered);
+    bool edgeTriggered() const override {
+        return _edgeTriggered;
+    }
+
+    // With auto-cork on, what's sent on a connection during one pass of the event
+    // loop (handling its input, a batch of executed tasks, timers) is collected and
+    // sent with a single system call at the end of the pass, rather than a call and
+    // a TCP segment per send. A non-zero flush window holds it back up to that much
+    // longer, for more to join it. Output that builds up past AutoCorkFlushBytes
+    // goes early, with MSG_MORE so the kernel keeps back a part-filled segment for
+    // what follows. WebSocket endpoints can opt out (see
+    // WebSocket::Handler::corksWrites). Must be called before listening.
+    static constexpr size_t AutoCorkFlushBytes = 64 * 1024u;
+    void setAutoCork(bool autoCork, std::chrono::microseconds flushWindow = std::chrono::microseconds::zero());
+    bool autoCork() const override {
+        return _autoCork;
+    }
+
+    // Sends output segments of at least this many bytes that are already kept
+    // apart from the connection's buffers, such as published frames, with
+    // MSG_ZEROCOPY, so the kernel needn't copy them. Files go with sendfile(),
+    // which doesn't copy them to begin with. Each segment is kept until the kernel
+    // reports it's done with it, even if the connection closes first. Zero-copy
+    // sends have overheads of their own and only pay off for large ones, of tens
+    // of KB or more. Connections the kernel ends up copying for anyway, such as
+    // over loopback, stop using it. 0, the default, never uses it. Must be called
+    // before listening.
+    void setZeroCopyThreshold(size_t bytes);
+    size_t zeroCopyThreshold() const override {
+        return _zeroCopyThreshold;
+    }
+
+    // Sets the number of threads running offloaded page handlers (see
+    // PageHandler::offloaded), shared by all reactors. Defaults to the number of
+    // hardware threads. The pool is started by the first offloaded request, after
+    // which this has no effect.
+    void setWorkerThreads(size_t count);
+    size_t workerThreads() const {
+        return _workerThreads;
+    }
+
+    // Sets the number of threads opening static files, and reading in the start
+    // of what's to be sent from them, off the event loop, so a slow disk holds up
+    // only the requests for its files. Shared by all reactors. 0 does it all on the
+    // loop. The pool is started by the first static file request, after which
+    // this has no effect.
+    static constexpr size_t DefaultFileThreads = 2;
+    void setFileThreads(size_t count);
+    size_t fileThreads() const {
+        return _fileThreads;
+    }
+
     void setPerMessageDeflateEnabled(bool enabled);
     bool getPerMessageDeflateEnabled() {
         return _perMessageDeflateEnabled;
@@ -138,28 +271,106 @@ public:
     using Executable = std::function<void()>;
     void execute(Executable toExecute);
 
+    struct ExecutorStats {
+        // Tasks waiting to run.
+        size_t queueDepth;
+        // Times the Seasocks thread was woken to run tasks; consecutive executes
+        // before it gets round to them share a wakeup.
+        uint64_t wakeups;
+        // Tasks which found the lock-free queue full and took the slower path.
+        uint64_t overflowed;
+        uint64_t executed;
+    };
+    // May be called from any thread.
+    ExecutorStats executorStats() const;
+
+    // Runs 'fn' on the Seasocks thread once 'delay' has passed, give or take a few
+    // milliseconds. Timers must be scheduled and cancelled on the Seasocks thread
+    // (or before the loop starts); other threads can execute() a task to do so.
+    using TimerId = uint64_t;
+    TimerId schedule(std::chrono::milliseconds delay, Executable fn);
+    // Returns false if the timer has already fired or been cancelled.
+    bool cancel(TimerId timer);
+
+    // Topics send a message to many WebSockets for little more than the cost of
+    // one: the frame is encoded once, and connections that can't send it straight
+    // away queue a reference to it rather than a copy. (Connections using
+    // per-message deflate, or the old Hixie protocol, still encode their own.)
+    // Subscriptions end when the connection closes. Must be called on the thread
+    // running the socket's handler.
+    void subscribe(WebSocket* socket, const std::string& topic);
+    void unsubscribe(WebSocket* socket, const std::string& topic);
+    // Sends to every subscriber, on whichever reactor. Text isn't checked to be
+    // UTF-8. Must be called on this Server's thread; other threads can execute()
+    // a task to do so.
+    void publish(const std::string& topic, const std::string& text);
+    void publish(const std::string& topic, const uint8_t* data, size_t length);
+
 private:
+    // Constructs an additional reactor sharing the handlers and settings of 'root'.
+    Server(std::shared_ptr<Logger> logger, Server* root, size_t reactorIndex);
+
     // From ServerImpl
     virtual void remove(Connection* connection) override;
-    virtual bool subscribeToWriteEvents(Connection* connection) override;
-    virtual bool unsubscribeFromWriteEvents(Connection* connection) override;
+    virtual void lingerZeroCopy(int fd, std::unique_ptr<ZeroCopySends> sends) override;
+    virtual bool setInterest(Connection* connection, bool reading, bool writing) override;
     virtual const std::string& getStaticPath() const override {
         return _staticPath;
     }
     virtual std::shared_ptr<WebSocket::Handler> getWebSocketHandler(const char* endpoint) const override;
     virtual bool isCrossOriginAllowed(const std::string& endpoint) const override;
-    virtual std::shared_ptr<Response> handle(const Request& request) override;
+    virtual std::shared_ptr<Response> handle(const std::shared_ptr<Request>& request, size_t firstHandler) override;
+    virtual std::shared_ptr<BodyHandler> bodyHandler(const Request& request) override;
     virtual std::string getStatsDocument() const override;
     virtual void checkThread() const override;
+    virtual void post(Task&& task) override;
     virtual Server& server() override {
         return *this;
     }
-
+    virtual void deferFlush(Connection* connection) override;
+    virtual void cancelDeferredFlush(Connection* connection) override;
+    virtual void deferRead(Connection* connection) override;
+    virtual void cancelDeferredRead(Connection* connection) override;
+    virtual WorkerPool* filePool() override;
+    virtual bool runsOnThisReactor(const WebSocket::Handler& handler) const override;
+    virtual bool handOff(Connection* connection, const WebSocket::Handler& handler,
+                         std::vector<uint8_t>&& input) override;
+
+    const Server& root() const {
+        return _root ? *_root : *this;
+    }
+    Server& reactor(size_t index);
+    WorkerPool& workerPool();
+    bool startReactors();
+    void stopReactors();
+    bool listenAlongside(const Server& root);
+    // Watches a listening socket whose accept queue other reactors share.
+    bool addSharedListenSock();
+    void adopt(int fd, const sockaddr_in& address, std::vector<uint8_t>&& input,
+               std::unique_ptr<ZeroCopySends> zeroCopySends);
+
+    bool createPoller(LoopBackend backend);
+    uint32_t connectionEvents() const;
     bool makeNonBlocking(int fd) const;
     bool configureSocket(int fd) const;
     void handleAccept();
     void processEventQueue();
     void runExecutables();
+    void wake();
+    // Wakes the loop without counting it as an executor wake-up.
+    void signalEventFd();
+    void updateClock();
+    void runTimers();
+    void armTimerFd();
+    void handleTimerFd();
+    bool createCorkTimerFd();
+    void handleCorkTimerFd();
+    // Flushes connections' deferred output, unless a flush window has yet to pass.
+    void flushDeferred();
+    void publishFrame(const std::string& topic, std::shared_ptr<const SharedFrame> frame);
+    void deliver(const std::string& topic, const std::shared_ptr<const SharedFrame>& frame);
+    void addConnection(Connection* connection);
+    void forgetConnection(Connection* connection);
 
     void shutdown();
 
@@ -168,17 +379,69 @@ private:
     enum class NewState { KeepOpen,
                           Close };
     NewState handleConnectionEvents(Connection* connection, uint32_t events);
+    void deleteHandedOffConnections();
+    void handleLingering();
+    // Closes a socket left to finish its zero-copy sends, resetting it if they haven't.
+    void closeLingering(int fd, bool reset);
 
-    // Connections, mapped to initial connection time.
-    std::map<Connection*, time_t> _connections;
+    // Connections, with when each connected and its lame-connection timer.
+    std::unique_ptr<ConnectionTable> _connections;
     std::shared_ptr<Logger> _logger;
     int _listenSock;
-    int _epollFd;
+    std::unique_ptr<Poller> _poller;
+    // Waits exclusively on a shared listening socket for backends that can't.
+    std::unique_ptr<Poller> _listenPoller;
+    // Sockets of closed connections whose zero-copy sends are still in flight,
+    // by descriptor, and the poller waiting on their error queues.
+    struct LingeringSocket {
+        int fd;
+        std::unique_ptr<ZeroCopySends> sends;
+        TimerId timer;
+    };
+    std::unordered_map<int, LingeringSocket> _lingering;
+    std::unique_ptr<Poller> _lingerPoller;
     int _eventFd;
     int _maxKeepAliveDrops;
     int _lameConnectionTimeoutSeconds;
     size_t _clientBufferSize;
-    time_t _nextDeadConnectionCheck;
+    size_t _pipelineDepth;
+    size_t _requestBodySpillThreshold;
+    size_t _maxRequestBodySize;
+    // Milliseconds on the coarse monotonic clock, updated once per loop iteration.
+    uint64_t _nowMillis;
+    std::unique_ptr<TimerWheel> _timers;
+    int _timerFd;
+    uint64_t _timerFdArmedAt;
+    bool _timerFdFired;
+    std::unique_ptr<TopicRegistry> _topics;
+    time_t _lastFullEventQueueWarning;
+
+    // Multi-reactor support. The root Server owns the additional reactors; each of
+    // those points back at the root to share its handlers.
+    Server* _root;
+    size_t _reactorIndex;
+    size_t _reactorCount;
+    std::vector<std::unique_ptr<Server>> _reactors;
+    std::vector<std::thread> _reactorThreads;
+    // Connections passed to another reactor, awaiting deletion at the end of dispatch.
+    std::vector<Connection*> _handedOff;
+
+    LoopBackend _loopBackend;
+    bool _edgeTriggered;
+    size_t _zeroCopyThreshold;
+
+    // Auto-cork: connections with output to flush at the end of this pass, and
+    // a timer for the flush window, if there is one.
+    bool _autoCork;
+    std::chrono::microseconds _corkWindow;
+    std::vector<Connection*> _deferredFlushes;
+    int _corkTimerFd;
+    bool _corkTimerArmed;
+    bool _corkWindowOver;
+
+    // Connections to read from again next pass, and those being read this pass.
+    std::vector<Connection*> _deferredReads;
+    std::vector<Connection*> _resumingReads;
 
     // Compression settings
     bool _perMessageDeflateEnabled = false;
@@ -190,10 +453,19 @@ private:
     typedef std::unordered_map<std::string, WebSocketHandlerEntry> WebSocketHandlerMap;
     WebSocketHandlerMap _webSocketHandlerMap;
 
-    std::list<std::shared_ptr<PageHandler>> _pageHandlers;
+    std::vector<std::shared_ptr<PageHandler>> _pageHandlers;
+
+    // Runs offloaded page handlers; owned by the root and started on first use.
+    size_t _workerThreads;
+    std::unique_ptr<WorkerPool> _workerPool;
+    std::once_flag _workerPoolStarted;
+    // Opens static files (see setFileThreads); likewise owned by the root.
+    size_t _fileThreads;
+    std::unique_ptr<WorkerPool> _filePool;
+    std::once_flag _filePoolStarted;
 
-    std::mutex _pendingExecutableMutex;
-    std::list<Executable> _pendingExecutables;
+    std::unique_ptr<ExecutorQueue> _executables;
+    std::atomic<uint64_t> _executorWakeups;
 
     pid_t _threadId;
 
@@ -27,14 +27,21 @@
 
 #include "seasocks/WebSocket.h"
 
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace seasocks {
 
+class BodyHandler;
 class Connection;
 class Request;
 class Response;
 class Server;
+class Task;
+class WorkerPool;
+class ZeroCopySends;
 
 // Internal implementation used to give access to internals to Connections.
 class ServerImpl {
@@ -42,16 +49,51 @@ public:
     virtual ~ServerImpl() = default;
 
     virtual void remove(Connection* connection) = 0;
-    virtual bool subscribeToWriteEvents(Connection* connection) = 0;
-    virtual bool unsubscribeFromWriteEvents(Connection* connection) = 0;
+    // Takes over a closing connection's socket, once removed, to close when the
+    // kernel has finished with its zero-copy sends.
+    virtual void lingerZeroCopy(int fd, std::unique_ptr<ZeroCopySends> sends) = 0;
+    // Sets which events the connection's socket is watched for. Edge-triggered
+    // connections are always watched for both, so this does nothing for them.
+    virtual bool setInterest(Connection* connection, bool reading, bool writing) = 0;
     virtual const std::string& getStaticPath() const = 0;
     virtual std::shared_ptr<WebSocket::Handler> getWebSocketHandler(const char* endpoint) const = 0;
     virtual bool isCrossOriginAllowed(const std::string& endpoint) const = 0;
-    virtual std::shared_ptr<Response> handle(const Request& request) = 0;
+    // Offers the request to the page handlers from 'firstHandler' on.
+    virtual std::shared_ptr<Response> handle(const std::shared_ptr<Request>& request, size_t firstHandler) = 0;
+    // The first page handler's BodyHandler for the request, if any wants to stream its body.
+    virtual std::shared_ptr<BodyHandler> bodyHandler(const Request& request) = 0;
     virtual std::string getStatsDocument() const = 0;
     virtual void checkThread() const = 0;
+    // Runs a task on this server's thread. May be called from any thread.
+    virtual void post(Task&& task) = 0;
     virtual Server& server() = 0;
     virtual size_t clientBufferSize() const = 0;
+    virtual size_t pipelineDepth() const = 0;
+    virtual size_t maxRequestBodySize() const = 0;
+    virtual size_t requestBodySpillThreshold() const = 0;
+    // Whether connections are registered edge triggered, and so must drain their sockets.
+    virtual bool edgeTriggered() const = 0;
+    // The smallest segment of output sent with MSG_ZEROCOPY, or 0 for none.
+    virtual size_t zeroCopyThreshold() const = 0;
+    // Whether connections leave flushing their output to the end of the loop's
+    // current pass (see Server::setAutoCork).
+    virtual bool autoCork() const = 0;
+    // Flushes the connection's output at the end of the current pass.
+    virtual void deferFlush(Connection* connection) = 0;
+    virtual void cancelDeferredFlush(Connection* connection) = 0;
+    // Has the connection read again on the loop's next pass, for when it stopped
+    // short of draining an edge-triggered socket.
+    virtual void deferRead(Connection* connection) = 0;
+    virtual void cancelDeferredRead(Connection* connection) = 0;
+    // The threads opening static files and reading them ahead off the loop, or
+    // null to do it on the loop.
+    virtual WorkerPool* filePool() = 0;
+    // Whether the given handler may run on the reactor owning the connection.
+    virtual bool runsOnThisReactor(const WebSocket::Handler& handler) const = 0;
+    // Passes the connection's socket to a reactor the handler runs on, replaying
+    // 'input' there. The connection is left closed and deleted later by the server.
+    virtual bool handOff(Connection* connection, const WebSocket::Handler& handler,
+                         std::vector<uint8_t>&& input) = 0;
 };
 
 }
@@ -0,0 +1,71 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+namespace seasocks {
+
+// A view of a contiguous run of Ts owned by someone else, in the manner of
+// C++20's std::span. Valid only for as long as the storage it points into.
+template <typename T>
+class Span {
+public:
+    constexpr Span() noexcept = default;
+    constexpr Span(T* data, size_t size) noexcept
+            : _data(data), _size(size) {
+    }
+    // For spans of const T.
+    Span(const std::vector<std::remove_const_t<T>>& vector) noexcept
+            : _data(vector.data()), _size(vector.size()) {
+    }
+
+    constexpr T* data() const noexcept {
+        return _data;
+    }
+    constexpr size_t size() const noexcept {
+        return _size;
+    }
+    constexpr bool empty() const noexcept {
+        return _size == 0;
+    }
+    constexpr T* begin() const noexcept {
+        return _data;
+    }
+    constexpr T* end() const noexcept {
+        return _data + _size;
+    }
+    constexpr T& operator[](size_t index) const noexcept {
+        return _data[index];
+    }
+
+private:
+    T* _data = nullptr;
+    size_t _size = 0;
+};
+
+} // namespace seasocks
@@ -0,0 +1,76 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "seasocks/WebSocket.h"
+
+namespace seasocks {
+
+constexpr size_t WebSocket::Composer::MaxReserve;
+
+namespace {
+
+// Composes into a buffer of its own, for sending with send() once done.
+class BufferComposer : public WebSocket::Composer {
+public:
+    explicit BufferComposer(size_t sizeHint) {
+        _buffer.resize(std::max<size_t>(sizeHint, 64));
+        _next = _buffer.data();
+        _end = _next + _buffer.size();
+    }
+
+    // The payload, followed by a NUL.
+    std::vector<uint8_t>& finish() {
+        if (_next == _end) {
+            more(1);
+        }
+        *_next = 0;
+        _buffer.resize(_next - _buffer.data() + 1);
+        return _buffer;
+    }
+
+private:
+    void more(size_t size) override {
+        auto used = static_cast<size_t>(_next - _buffer.data());
+        _buffer.resize(std::max(_buffer.size() * 2, used + size));
+        _next = _buffer.data() + used;
+        _end = _buffer.data() + _buffer.size();
+    }
+
+    std::vector<uint8_t> _buffer;
+};
+
+}
+
+void WebSocket::compose(Opcode opcode, size_t sizeHint, const std::function<void(Composer&)>& write) {
+    BufferComposer composer(sizeHint + 1);
+    write(composer);
+    auto& payload = composer.finish();
+    if (opcode == Opcode::Text) {
+        send(reinterpret_cast<const char*>(payload.data()));
+    } else {
+        send(payload.data(), payload.size() - 1);
+    }
+}
+
+}
@@ -26,14 +26,26 @@
 #pragma once
 
 #include "seasocks/Request.h"
+#include "seasocks/Span.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace seasocks {
 
+class SendQueue;
+
 class WebSocket : public Request {
 public:
+    // The largest message a Handler accepts unless it says otherwise.
+    static constexpr size_t DefaultMaxMessageSize = 16384;
+
     /**
      * Send the given text data. Must be called on the seasocks thread.
      * See Server::execute for how to run work on the seasocks
@@ -54,6 +66,82 @@ public:
      * thread externally.
      */
     virtual void send(const uint8_t* data, size_t length) = 0;
+    enum class Opcode : uint8_t {
+        Text = 1,
+        Binary = 2,
+    };
+
+    /**
+     * Writes a message's payload for compose(). Space comes in contiguous runs:
+     * while what's written fits in the current one, appending is just a bounds
+     * check and a copy.
+     */
+    class Composer {
+    public:
+        // The most that reserve() can be asked for at once.
+        static constexpr size_t MaxReserve = 16384;
+
+        void append(const void* data, size_t size) {
+            if (size <= static_cast<size_t>(_end - _next)) {
+                if (size) {
+                    memcpy(_next, data, size);
+                    _next += size;
+                }
+                return;
+            }
+            appendSlowly(static_cast<const uint8_t*>(data), size);
+        }
+        void append(std::string_view text) {
+            append(text.data(), text.size());
+        }
+        /**
+         * Returns room to write at least 'size' bytes (up to MaxReserve) into
+         * directly. Once written, advance() past however many were used.
+         */
+        uint8_t* reserve(size_t size) {
+            if (size > static_cast<size_t>(_end - _next)) {
+                more(size);
+            }
+            return _next;
+        }
+        void advance(size_t size) {
+            _next += size;
+        }
+
+    protected:
+        virtual ~Composer() = default;
+        // Takes what's been written up to _next, and makes room for at least
+        // 'size' more bytes at _next.
+        virtual void more(size_t size) = 0;
+
+        uint8_t* _next = nullptr;
+        uint8_t* _end = nullptr;
+
+    private:
+        void appendSlowly(const uint8_t* data, size_t size) {
+            while (size) {
+                auto room = static_cast<size_t>(_end - _next);
+                if (!room) {
+                    more(std::min(size, MaxReserve));
+                    room = static_cast<size_t>(_end - _next);
+                }
+                auto toCopy = std::min(room, size);
+                memcpy(_next, data, toCopy);
+                _next += toCopy;
+                data += toCopy;
+                size -= toCopy;
+            }
+        }
+    };
+    /**
+     * Sends a message whose payload 'write' puts together, straight into the
+     * connection's output rather than into a buffer of its own to be copied from;
+     * the frame header is filled in afterwards. 'sizeHint' is how big the payload
+     * is likely to be, so space for it can be found up front. 'write' mustn't
+     * send anything on this WebSocket itself. Must be called on the seasocks thread.
+     */
+    virtual void compose(Opcode opcode, size_t sizeHint, const std::function<void(Composer&)>& write);
+
     /**
      * Close the socket. It's invalid to access the socket after
      * calling close(). The Handler::onDisconnect() call may occur
@@ -61,6 +149,53 @@ public:
      */
     virtual void close() = 0;
 
+    /**
+     * Sends on a WebSocket from another thread, without a Server::execute per
+     * message: data is moved into a lock-free queue that the seasocks thread
+     * drains in batches. A Sender doesn't keep its connection alive; once that
+     * closes, sends return false and the data is dropped. Each connection's
+     * queue has a single producer, so only use a connection's Senders from one
+     * thread at a time, and not once the Server has been destroyed.
+     */
+    class Sender {
+    public:
+        Sender() = default;
+        explicit Sender(std::weak_ptr<SendQueue> queue)
+                : _queue(std::move(queue)) {
+        }
+
+        /**
+         * Queues text or binary data to send. Returns false if the connection
+         * has closed, or too many earlier sends are still waiting to go.
+         */
+        bool send(std::string text) const;
+        bool send(std::vector<uint8_t> binary) const;
+
+        bool connected() const;
+
+    private:
+        std::weak_ptr<SendQueue> _queue;
+    };
+    /**
+     * Returns a Sender for this WebSocket. Must be called on the seasocks thread.
+     */
+    virtual Sender sender() {
+        return Sender();
+    }
+
+    /**
+     * A complete message, as passed to Handler::onDataBatch.
+     */
+    struct MessageView {
+        bool isText;
+        Span<const uint8_t> data;
+
+        // Text is NUL terminated, as for onData.
+        std::string_view text() const {
+            return std::string_view(reinterpret_cast<const char*>(data.data()), data.size());
+        }
+    };
+
     /**
      * Interface to dealing with WebSocket connections.
      */
@@ -82,6 +217,88 @@ public:
          */
         virtual void onData(WebSocket*, const uint8_t*, size_t) {
         }
+        /**
+         * Called on the seasocks thread upon receipt of a full text WebSocket message,
+         * without copying it: the view points into the connection's receive buffer and
+         * is only valid until this returns. The text is followed by a NUL, so data()
+         * may be used as a C string. By default passes the message on to
+         * onData(WebSocket*, const char*).
+         */
+        virtual void onData(WebSocket* connection, std::string_view text) {
+            onData(connection, text.data());
+        }
+        /**
+         * Called on the seasocks thread upon receipt of a full binary WebSocket message,
+         * without copying it; the data is only valid until this returns. By default
+         * passes the message on to onData(WebSocket*, const uint8_t*, size_t).
+         */
+        virtual void onData(WebSocket* connection, Span<const uint8_t> data) {
+            onData(connection, data.data(), data.size());
+        }
+        /**
+         * Called on the seasocks thread, instead of onData, for handlers that stream
+         * messages (see streamsMessages). Each piece of a message is passed on as it
+         * arrives, without waiting for the rest of its frame; 'last' is set on its final
+         * piece, which may be empty. Text isn't NUL terminated, and pieces may split
+         * UTF-8 sequences. Messages compressed with per-message deflate are still
+         * reassembled and inflated first, and then passed on as a single piece.
+         */
+        virtual void onFragment(WebSocket*, bool /*isText*/, const uint8_t* /*data*/, size_t /*length*/, bool /*last*/) {
+        }
+        /**
+         * Called on the seasocks thread, instead of onData, for handlers that batch
+         * messages (see batchesMessages), with every message decoded from one read of
+         * the socket, in order. The messages are only valid until this returns.
+         */
+        virtual void onDataBatch(WebSocket*, Span<const MessageView> /*messages*/) {
+        }
+        /**
+         * Return true to have messages passed to onDataBatch, so that locking and the
+         * like can be done once per batch rather than per message. Streaming (see
+         * streamsMessages) takes precedence.
+         */
+        virtual bool batchesMessages() const {
+            return false;
+        }
+        /**
+         * Return true to have messages passed to onFragment as they arrive rather than
+         * to onData once they're complete, so large ones needn't be buffered.
+         */
+        virtual bool streamsMessages() const {
+            return false;
+        }
+        /**
+         * The largest message clients may send, once its fragments are put together
+         * (and it's inflated, if compressed). Applies to streamed messages too.
+         * Connections sending bigger ones are closed with status 1009.
+         */
+        virtual size_t maxMessageSize() const {
+            return DefaultMaxMessageSize;
+        }
+        /**
+         * Whether text messages from clients of this endpoint are checked to be
+         * valid UTF-8. Connections sending invalid text are closed with status 1007.
+         */
+        virtual bool validatesUtf8() const {
+            return true;
+        }
+        /**
+         * Whether text given to send() or compose() for this endpoint is checked to
+         * be valid UTF-8 first, invalid text being logged and dropped. Off unless
+         * asked for, as it costs a pass over everything sent. Text published to a
+         * topic is never checked.
+         */
+        virtual bool validatesSentUtf8() const {
+            return false;
+        }
+        /**
+         * With the server auto-corking (see Server::setAutoCork), return false to
+         * have what's sent to this endpoint go straight away rather than at the end
+         * of the event loop's pass, for the lowest latency.
+         */
+        virtual bool corksWrites() const {
+            return true;
+        }
         /**
          * Called on the seasocks thread when the socket has been
          */
@@ -93,6 +310,16 @@ public:
         virtual ssize_t chooseProtocol(const std::vector<std::string>&) const {
             return 0;
         }
+        /**
+         * When the server runs multiple reactors (see Server::setReactorCount), decide
+         * whether connections to this handler may be serviced by the given reactor.
+         * Connections accepted on another reactor are handed over to one this returns
+         * true for before onConnect is called. Restricting a handler to a single reactor
+         * means it is only ever called from one thread.
+         */
+        virtual bool runsOnReactor(size_t /*reactorIndex*/) const {
+            return true;
+        }
     };
 
 protected:
@@ -115,9 +115,19 @@ struct ZlibContext::Impl {
         // Append 4 octets prior to decompression (see RFC 7692, section 7.2.2)
         uint8_t tail_end[4] = {0x00, 0x00, 0xff, 0xff};
         input.insert(input.end(), tail_end, tail_end + 4);
+        return inflateSome(input.data(), input.size(), output, zlibError);
+    }
+
+    bool inflate(const uint8_t* input, size_t inputLen, std::vector<uint8_t>& output, int& zlibError) {
+        // As above, but the 4 octets are fed in separately rather than appended.
+        uint8_t tail_end[4] = {0x00, 0x00, 0xff, 0xff};
+        return inflateSome(input, inputLen, output, zlibError)
+               && inflateSome(tail_end, sizeof(tail_end), output, zlibError);
+    }
 
-        inflateStream.next_in = input.data();
-        inflateStream.avail_in = input.size();
+    bool inflateSome(const uint8_t* input, size_t inputLen, std::vector<uint8_t>& output, int& zlibError) {
+        inflateStream.next_in = const_cast<uint8_t*>(input);
+        inflateStream.avail_in = inputLen;
 
         do {
             inflateStream.next_out = buffer;
@@ -153,4 +163,8 @@ bool ZlibContext::inflate(std::vector<uint8_t>& input, std::vector<uint8_t>& out
     return _impl->inflate(input, output, zlibError);
 }
 
+bool ZlibContext::inflate(const uint8_t* input, size_t inputLen, std::vector<uint8_t>& output, int& zlibError) {
+    return _impl->inflate(input, inputLen, output, zlibError);
+}
+
 }
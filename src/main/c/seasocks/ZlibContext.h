@@ -20,6 +20,8 @@ public:
 
     // WARNING: inflate() alters input
     bool inflate(std::vector<uint8_t>& input, std::vector<uint8_t>& output, int& zlibError);
+    // Appends the inflated message to 'output', leaving the input untouched.
+    bool inflate(const uint8_t* input, size_t inputLen, std::vector<uint8_t>& output, int& zlibError);
 
 private:
     struct Impl;
@@ -50,4 +50,8 @@ bool ZlibContext::inflate(std::vector<uint8_t>&, std::vector<uint8_t>&, int&) {
     throw std::runtime_error("Not compiled with zlib support");
 }
 
+bool ZlibContext::inflate(const uint8_t*, size_t, std::vector<uint8_t>&, int&) {
+    throw std::runtime_error("Not compiled with zlib support");
+}
+
 }
\ No newline at end of file
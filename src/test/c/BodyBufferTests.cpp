@@ -0,0 +1,76 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/BodyBuffer.h"
+
+#include <catch2/catch.hpp>
+
+#include <string>
+
+using namespace seasocks;
+
+namespace {
+
+bool add(BodyBuffer& buffer, const std::string& str) {
+    return buffer.append(reinterpret_cast<const uint8_t*>(str.data()), str.size());
+}
+
+std::string contents(BodyBuffer& buffer) {
+    const uint8_t* data = nullptr;
+    std::shared_ptr<const void> owner;
+    REQUIRE(buffer.finish(data, owner));
+    REQUIRE(owner);
+    return std::string(reinterpret_cast<const char*>(data), buffer.size());
+}
+
+}
+
+TEST_CASE("Bodies under the threshold stay in memory", "[BodyBufferTests]") {
+    BodyBuffer buffer(16);
+    CHECK(add(buffer, "hello, "));
+    CHECK(add(buffer, "world"));
+    CHECK(buffer.size() == 12);
+    CHECK_FALSE(buffer.spilled());
+    CHECK(contents(buffer) == "hello, world");
+}
+
+TEST_CASE("A zero threshold never spills", "[BodyBufferTests]") {
+    BodyBuffer buffer(0);
+    CHECK(add(buffer, std::string(100000, 'x')));
+    CHECK_FALSE(buffer.spilled());
+    CHECK(contents(buffer) == std::string(100000, 'x'));
+}
+
+TEST_CASE("Bodies over the threshold spill to a file", "[BodyBufferTests]") {
+    BodyBuffer buffer(8);
+    CHECK(add(buffer, "01234"));
+    CHECK_FALSE(buffer.spilled());
+    CHECK(add(buffer, "56789"));
+    CHECK(buffer.spilled());
+    std::string more(65536, 'y');
+    CHECK(add(buffer, more));
+    CHECK(buffer.size() == 10 + more.size());
+    CHECK(contents(buffer) == "0123456789" + more);
+}
@@ -0,0 +1,135 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/BodyDecoder.h"
+#include "internal/InputBuffer.h"
+
+#include <catch2/catch.hpp>
+
+#include <string>
+
+using namespace seasocks;
+
+namespace {
+
+void add(InputBuffer& input, const std::string& str) {
+    auto data = reinterpret_cast<const uint8_t*>(str.data());
+    input.append(data, data + str.size());
+}
+
+BodyDecoder::State decodeAll(BodyDecoder& decoder, InputBuffer& input, std::string& body) {
+    return decoder.decode(input, [&body](const uint8_t* data, size_t size) {
+        body.append(reinterpret_cast<const char*>(data), size);
+        return true;
+    });
+}
+
+}
+
+TEST_CASE("Fixed length bodies stop at the content length", "[BodyDecoderTests]") {
+    auto decoder = BodyDecoder::fixed(10);
+    InputBuffer input;
+    std::string body;
+    add(input, "01234");
+    CHECK(decodeAll(decoder, input, body) == BodyDecoder::State::Reading);
+    CHECK(body == "01234");
+    CHECK(input.empty());
+    add(input, "56789GET / HTTP/1.1");
+    CHECK(decodeAll(decoder, input, body) == BodyDecoder::State::Done);
+    CHECK(body == "0123456789");
+    CHECK(decoder.bodySize() == 10);
+    CHECK(std::string(reinterpret_cast<const char*>(input.data()), input.size()) == "GET / HTTP/1.1");
+}
+
+TEST_CASE("Chunked bodies are decoded however they arrive", "[BodyDecoderTests]") {
+    const std::string encoded = "5;name=value\r\nhello\r\n"
+                                "7\r\n, world\r\n"
+                                "1A \r\nabcdefghijklmnopqrstuvwxyz\r\n"
+                                "0\r\nX-Trailer: ignored\r\n\r\n"
+                                "next";
+    const std::string expected = "hello, worldabcdefghijklmnopqrstuvwxyz";
+
+    SECTION("all at once") {
+        auto decoder = BodyDecoder::chunked(1024);
+        InputBuffer input;
+        std::string body;
+        add(input, encoded);
+        CHECK(decodeAll(decoder, input, body) == BodyDecoder::State::Done);
+        CHECK(body == expected);
+        CHECK(decoder.bodySize() == expected.size());
+        CHECK(std::string(reinterpret_cast<const char*>(input.data()), input.size()) == "next");
+    }
+    SECTION("a byte at a time") {
+        auto decoder = BodyDecoder::chunked(1024);
+        InputBuffer input;
+        std::string body;
+        auto state = BodyDecoder::State::Reading;
+        size_t fed = 0;
+        while (state == BodyDecoder::State::Reading && fed < encoded.size()) {
+            add(input, encoded.substr(fed++, 1));
+            state = decodeAll(decoder, input, body);
+        }
+        CHECK(state == BodyDecoder::State::Done);
+        CHECK(body == expected);
+        CHECK(fed == encoded.size() - 4);
+    }
+}
+
+TEST_CASE("Broken chunked encoding is reported", "[BodyDecoderTests]") {
+    auto malformed = [](const std::string& encoded) {
+        auto decoder = BodyDecoder::chunked(1024);
+        InputBuffer input;
+        std::string body;
+        add(input, encoded);
+        return decodeAll(decoder, input, body) == BodyDecoder::State::Malformed;
+    };
+    CHECK(malformed("zz\r\n"));
+    CHECK(malformed("\r\n"));
+    CHECK(malformed("3\r\nabcXY"));
+    CHECK(malformed("1;" + std::string(BodyDecoder::MaxLineSize, 'x')));
+}
+
+TEST_CASE("Chunked bodies are held to their limit", "[BodyDecoderTests]") {
+    auto decoder = BodyDecoder::chunked(8);
+    InputBuffer input;
+    std::string body;
+    add(input, "5\r\nhello\r\n5\r\nworld\r\n0\r\n\r\n");
+    CHECK(decodeAll(decoder, input, body) == BodyDecoder::State::TooLarge);
+    CHECK(body == "hello");
+
+    auto huge = BodyDecoder::chunked(1024);
+    InputBuffer hugeInput;
+    add(hugeInput, "ffffffffffffffffffff\r\n");
+    CHECK(decodeAll(huge, hugeInput, body) == BodyDecoder::State::TooLarge);
+}
+
+TEST_CASE("The body's consumer can stop decoding", "[BodyDecoderTests]") {
+    auto decoder = BodyDecoder::fixed(4);
+    InputBuffer input;
+    add(input, "abcd");
+    auto state = decoder.decode(input, [](const uint8_t*, size_t) { return false; });
+    CHECK(state == BodyDecoder::State::Rejected);
+    CHECK(input.size() == 4);
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/ByteScan.h"
+
+#include <catch2/catch.hpp>
+
+#include <string>
+
+using namespace seasocks;
+
+namespace {
+
+const uint8_t* first(const std::string& str) {
+    return reinterpret_cast<const uint8_t*>(str.data());
+}
+
+const uint8_t* last(const std::string& str) {
+    return first(str) + str.size();
+}
+
+}
+
+TEST_CASE("findByte finds the first match at every offset", "[ByteScanTests]") {
+    for (size_t length = 0; length < 100; ++length) {
+        std::string haystack(length, 'a');
+        CHECK(findByte(first(haystack), last(haystack), 'b') == last(haystack));
+        for (size_t pos = 0; pos < length; ++pos) {
+            haystack[pos] = 'b';
+            if (pos + 1 < length) {
+                haystack[length - 1] = 'b';
+            }
+            CHECK(findByte(first(haystack), last(haystack), 'b') == first(haystack) + pos);
+            haystack.assign(length, 'a');
+        }
+    }
+}
+
+TEST_CASE("findByte stops at the end of the range", "[ByteScanTests]") {
+    std::string haystack(64, 'a');
+    haystack[40] = 'b';
+    CHECK(findByte(first(haystack), first(haystack) + 40, 'b') == first(haystack) + 40);
+    CHECK(findByte(first(haystack) + 41, last(haystack), 'b') == last(haystack));
+}
+
+TEST_CASE("findCrLf skips lone carriage returns", "[ByteScanTests]") {
+    std::string text = "a\rb\r\rc\r\nd";
+    CHECK(findCrLf(first(text), last(text)) == first(text) + 6);
+    std::string partial = "abc\r";
+    CHECK(findCrLf(first(partial), last(partial)) == last(partial));
+}
+
+TEST_CASE("findCrLfCrLf finds the end of the headers", "[ByteScanTests]") {
+    std::string request = "GET / HTTP/1.1\r\nHost: x\r\n\r\nbody";
+    CHECK(findCrLfCrLf(first(request), last(request)) == first(request) + 23);
+
+    std::string padded = std::string(100, 'x') + "\r\n\r\r\n\r\n";
+    CHECK(findCrLfCrLf(first(padded), last(padded)) == first(padded) + 103);
+
+    std::string incomplete = "GET / HTTP/1.1\r\nHost: x\r\n\r";
+    CHECK(findCrLfCrLf(first(incomplete), last(incomplete)) == last(incomplete));
+}
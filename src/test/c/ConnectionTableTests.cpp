@@ -0,0 +1,108 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/ConnectionTable.h"
+
+#include "MockServerImpl.h"
+#include "seasocks/IgnoringLogger.h"
+
+#include <catch2/catch.hpp>
+
+#include <set>
+
+using namespace seasocks;
+
+TEST_CASE("ConnectionTable", "[ConnectionTableTests]") {
+    auto logger = std::make_shared<IgnoringLogger>();
+    MockServerImpl mockServer;
+    sockaddr_in addr{};
+    ConnectionTable table;
+
+    auto first = table.create(logger, mockServer, -1, addr);
+    auto second = table.create(logger, mockServer, -1, addr);
+    CHECK(table.empty());
+    CHECK(table.find(first) == nullptr);
+
+    auto firstHandle = table.add(first, 123);
+    auto secondHandle = table.add(second, 456);
+    CHECK(table.size() == 2);
+    REQUIRE(table.find(first) != nullptr);
+    CHECK(table.find(first)->since == 123);
+    CHECK(table.find(firstHandle) == table.find(first));
+    CHECK(table.find(secondHandle)->connection == second);
+    CHECK(table.registered().size() == 2);
+
+    SECTION("removing makes handles stale") {
+        ConnectionTable::Entry removed;
+        REQUIRE(table.remove(first, removed));
+        CHECK(removed.connection == first);
+        CHECK(removed.since == 123);
+        CHECK_FALSE(table.remove(first, removed));
+        CHECK(table.find(firstHandle) == nullptr);
+        CHECK(table.size() == 1);
+        table.destroy(first);
+        table.destroy(second);
+        CHECK(table.empty());
+    }
+
+    SECTION("connections from elsewhere aren't found") {
+        Connection outsider(logger, mockServer, -1, addr);
+        CHECK(table.find(&outsider) == nullptr);
+        ConnectionTable::Entry removed;
+        CHECK_FALSE(table.remove(&outsider, removed));
+        table.destroy(&outsider);
+        CHECK(table.size() == 2);
+        table.destroy(first);
+        table.destroy(second);
+    }
+
+    SECTION("slots are recycled") {
+        table.destroy(first);
+        CHECK(table.size() == 1);
+        auto third = table.create(logger, mockServer, -1, addr);
+        CHECK(third == first);
+        auto thirdHandle = table.add(third, 789);
+        CHECK(thirdHandle.index == firstHandle.index);
+        CHECK(table.find(firstHandle) == nullptr);
+        CHECK(table.find(thirdHandle)->since == 789);
+        table.destroy(third);
+        table.destroy(second);
+    }
+
+    SECTION("grows beyond a slab") {
+        std::set<Connection*> connections;
+        for (int i = 0; i < 1000; ++i) {
+            auto connection = table.create(logger, mockServer, -1, addr);
+            table.add(connection, i);
+            connections.insert(connection);
+        }
+        CHECK(connections.size() == 1000);
+        CHECK(table.size() == 1002);
+        for (auto connection : table.registered()) {
+            table.destroy(connection);
+        }
+        CHECK(table.empty());
+    }
+}
@@ -0,0 +1,51 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "internal/ZeroCopySends.h"
+
+#include "seasocks/Connection.h"
+
+#include <cstddef>
+
+namespace seasocks {
+
+// Reads the counters Connections keep for tests.
+struct ConnectionTestAccess {
+    // System calls that have sent output, so as to see how well it's batched.
+    static size_t sendCalls(const Connection& connection) {
+        return connection._sendCalls;
+    }
+    // Sends made with MSG_ZEROCOPY, and how many of them the kernel has reported done.
+    static size_t zeroCopySends(const Connection& connection) {
+        return connection._zeroCopySends ? connection._zeroCopySends->sends() : 0;
+    }
+    static size_t zeroCopyCompletions(const Connection& connection) {
+        return connection._zeroCopySends ? connection._zeroCopySends->completions() : 0;
+    }
+};
+
+}
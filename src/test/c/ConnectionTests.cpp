@@ -24,11 +24,17 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include "MockServerImpl.h"
+#include "internal/InputBuffer.h"
 #include "seasocks/Connection.h"
 #include "seasocks/IgnoringLogger.h"
+#include "seasocks/Response.h"
+#include "seasocks/Server.h"
 
 #include <catch2/catch.hpp>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <iostream>
 #include <sstream>
 #include <cstring>
@@ -85,3 +91,311 @@ TEST_CASE("Connection tests", "[ConnectionTests]") {
         connection.handleNewData();
     }
 }
+
+namespace {
+
+class RecordingHandler : public WebSocket::Handler {
+public:
+    bool streams = false;
+    bool checksUtf8 = true;
+    size_t maxSize = WebSocket::DefaultMaxMessageSize;
+    std::vector<std::string> messages;
+    std::vector<std::pair<std::string, bool>> fragments;
+
+    void onConnect(WebSocket*) override {
+    }
+    void onData(WebSocket*, const char* data) override {
+        messages.emplace_back(data);
+    }
+    void onFragment(WebSocket*, bool, const uint8_t* data, size_t length, bool last) override {
+        fragments.emplace_back(std::string(data, data + length), last);
+    }
+    void onDisconnect(WebSocket*) override {
+    }
+    bool streamsMessages() const override {
+        return streams;
+    }
+    size_t maxMessageSize() const override {
+        return maxSize;
+    }
+    bool validatesUtf8() const override {
+        return checksUtf8;
+    }
+};
+
+void feed(Connection& connection, std::vector<uint8_t> bytes) {
+    auto& input = connection.getInputBuffer();
+    std::vector<uint8_t> all(input.data(), input.data() + input.size());
+    all.insert(all.end(), bytes.begin(), bytes.end());
+    input.assign(all.data(), all.data() + all.size());
+    connection.handleHybiWebSocket();
+}
+
+}
+
+TEST_CASE("Fragmented WebSocket messages", "[ConnectionTests]") {
+    sockaddr_in addr{};
+    auto logger = std::make_shared<IgnoringLogger>();
+    MockServerImpl mockServer;
+    Connection connection(logger, mockServer, -1, addr);
+    auto handler = std::make_shared<RecordingHandler>();
+    connection.setHandler(handler);
+
+    SECTION("are reassembled around control frames") {
+        feed(connection, {0x01, 0x02, 'a', 'b', 0x8a, 0x00, 0x00, 0x01});
+        CHECK(handler->messages.empty());
+        feed(connection, {'c', 0x80, 0x01, 'd', 0x81, 0x01, 'e'});
+        REQUIRE(handler->messages.size() == 2);
+        CHECK(handler->messages[0] == "abcd");
+        CHECK(handler->messages[1] == "e");
+        CHECK(connection.getInputBuffer().empty());
+    }
+    SECTION("are streamed to handlers that want them, a piece at a time") {
+        handler->streams = true;
+        // A masked four byte fragment, then the final one arriving in two reads.
+        feed(connection, {0x01, 0x84, 0x01, 0x02, 0x03, 0x04, 'a' ^ 1, 'b' ^ 2, 'c' ^ 3, 'd' ^ 4,
+                          0x80, 0x83, 0x01, 0x02, 0x03, 0x04, 'e' ^ 1});
+        feed(connection, {'f' ^ 2, 'g' ^ 3});
+        REQUIRE(handler->fragments.size() == 3);
+        CHECK(handler->fragments[0] == std::make_pair(std::string("abcd"), false));
+        CHECK(handler->fragments[1] == std::make_pair(std::string("e"), false));
+        CHECK(handler->fragments[2] == std::make_pair(std::string("fg"), true));
+        CHECK(handler->messages.empty());
+    }
+    SECTION("are limited in total size") {
+        handler->maxSize = 4;
+        feed(connection, {0x01, 0x03, 'a', 'b', 'c'});
+        feed(connection, {0x80, 0x02, 'd', 'e'});
+        CHECK(handler->messages.empty());
+    }
+    SECTION("can't start a message in the middle of another") {
+        feed(connection, {0x01, 0x01, 'a', 0x81, 0x01, 'b', 0x80, 0x01, 'c'});
+        CHECK(handler->messages.empty());
+    }
+}
+
+namespace {
+
+class ViewHandler : public WebSocket::Handler {
+public:
+    std::vector<std::string> texts;
+    std::vector<std::vector<uint8_t>> binaries;
+
+    void onConnect(WebSocket*) override {
+    }
+    void onData(WebSocket*, std::string_view text) override {
+        CHECK(text.data()[text.size()] == 0);
+        texts.emplace_back(text);
+    }
+    void onData(WebSocket*, Span<const uint8_t> data) override {
+        binaries.emplace_back(data.begin(), data.end());
+    }
+    void onDisconnect(WebSocket*) override {
+    }
+};
+
+}
+
+TEST_CASE("WebSocket messages are delivered in place", "[ConnectionTests]") {
+    sockaddr_in addr{};
+    auto logger = std::make_shared<IgnoringLogger>();
+    MockServerImpl mockServer;
+    Connection connection(logger, mockServer, -1, addr);
+    auto handler = std::make_shared<ViewHandler>();
+    connection.setHandler(handler);
+
+    feed(connection, {0x81, 0x82, 0x01, 0x02, 0x03, 0x04, 'h' ^ 1, 'i' ^ 2,
+                      0x82, 0x02, 0x00, 0x01,
+                      0x81, 0x01, 'x'});
+    REQUIRE(handler->texts.size() == 2);
+    CHECK(handler->texts[0] == "hi");
+    CHECK(handler->texts[1] == "x");
+    REQUIRE(handler->binaries.size() == 1);
+    CHECK(handler->binaries[0] == std::vector<uint8_t>{0x00, 0x01});
+    CHECK(connection.getInputBuffer().empty());
+}
+
+namespace {
+
+class BatchHandler : public WebSocket::Handler {
+public:
+    std::vector<std::vector<std::string>> batches;
+
+    void onConnect(WebSocket*) override {
+    }
+    void onData(WebSocket*, const char*) override {
+        FAIL("should be batched");
+    }
+    void onDataBatch(WebSocket*, Span<const WebSocket::MessageView> messages) override {
+        std::vector<std::string> batch;
+        for (auto& message : messages) {
+            CHECK(message.isText);
+            CHECK(message.text().data()[message.text().size()] == 0);
+            batch.emplace_back(message.text());
+        }
+        batches.push_back(batch);
+    }
+    bool batchesMessages() const override {
+        return true;
+    }
+    void onDisconnect(WebSocket*) override {
+    }
+};
+
+}
+
+TEST_CASE("WebSocket messages can be delivered in batches", "[ConnectionTests]") {
+    sockaddr_in addr{};
+    auto logger = std::make_shared<IgnoringLogger>();
+    MockServerImpl mockServer;
+    Connection connection(logger, mockServer, -1, addr);
+    auto handler = std::make_shared<BatchHandler>();
+    connection.setHandler(handler);
+
+    feed(connection, {0x81, 0x01, 'a', 0x01, 0x01, 'b', 0x80, 0x01, 'c', 0x81, 0x00, 0x81, 0x01, 'd', 0x81});
+    REQUIRE(handler->batches.size() == 1);
+    CHECK(handler->batches[0] == std::vector<std::string>{"a", "bc", "", "d"});
+    // The partial frame left over is intact.
+    REQUIRE(connection.getInputBuffer().size() == 1);
+    CHECK(connection.getInputBuffer()[0] == 0x81);
+    feed(connection, {0x01, 'e'});
+    REQUIRE(handler->batches.size() == 2);
+    CHECK(handler->batches[1] == std::vector<std::string>{"e"});
+}
+
+TEST_CASE("WebSocket text is checked to be UTF-8", "[ConnectionTests]") {
+    sockaddr_in addr{};
+    auto logger = std::make_shared<IgnoringLogger>();
+    MockServerImpl mockServer;
+    Connection connection(logger, mockServer, -1, addr);
+    auto handler = std::make_shared<RecordingHandler>();
+    connection.setHandler(handler);
+
+    SECTION("even when a character is split between fragments") {
+        feed(connection, {0x01, 0x02, 'a', 0xc3, 0x80, 0x01, 0xa9});
+        REQUIRE(handler->messages.size() == 1);
+        CHECK(handler->messages[0] == "a\xc3\xa9");
+    }
+    SECTION("and invalid text isn't delivered") {
+        feed(connection, {0x81, 0x02, 0xc0, 0xaf, 0x81, 0x01, 'a'});
+        CHECK(handler->messages.empty());
+    }
+    SECTION("nor text stopping part way through a character") {
+        feed(connection, {0x81, 0x02, 'a', 0xe2});
+        CHECK(handler->messages.empty());
+    }
+    SECTION("unless the handler doesn't want it checked") {
+        handler->checksUtf8 = false;
+        feed(connection, {0x81, 0x02, 0xc0, 0xaf});
+        CHECK(handler->messages.size() == 1);
+    }
+    SECTION("as it's streamed") {
+        handler->streams = true;
+        feed(connection, {0x81, 0x04, 'a', 'b'});
+        feed(connection, {0xff});
+        REQUIRE(handler->fragments.size() == 1);
+        CHECK(handler->fragments[0].first == "ab");
+    }
+}
+
+TEST_CASE("Edge-triggered reads drain the socket a wakeup at a time", "[ConnectionTests]") {
+    // A pipe stands in for the socket; big enough to queue more than one wakeup's worth.
+    int fds[2];
+    REQUIRE(::pipe2(fds, O_NONBLOCK) == 0);
+    const size_t capacity = 1024 * 1024;
+    REQUIRE(::fcntl(fds[1], F_SETPIPE_SZ, capacity) >= static_cast<int>(capacity));
+    sockaddr_in addr{};
+    auto logger = std::make_shared<IgnoringLogger>();
+    Server server(logger);
+    MockServerImpl mockServer;
+    mockServer.realServer = &server;
+    mockServer.spillThreshold = 1024 * 1024 * 1024;
+    Connection connection(logger, mockServer, fds[0], addr);
+    // A body too big to finish, so nothing is answered.
+    std::string headers = "POST / HTTP/1.1\r\nContent-Length: 100000000\r\n\r\n";
+    auto queue = [&](size_t size) {
+        std::string data(size, 'x');
+        if (connection.bytesReceived() == 0) {
+            data.replace(0, headers.size(), headers);
+        }
+        REQUIRE(::write(fds[1], data.data(), data.size()) == static_cast<ssize_t>(data.size()));
+    };
+
+    SECTION("reading everything queued") {
+        mockServer.edgeTriggeredReads = true;
+        queue(300 * 1024);
+        connection.handleDataReadyForRead();
+        CHECK(connection.bytesReceived() == 300 * 1024);
+        CHECK(mockServer.deferredReads == 0);
+    }
+    SECTION("unlike level-triggered reads") {
+        queue(300 * 1024);
+        connection.handleDataReadyForRead();
+        CHECK(connection.bytesReceived() < 300 * 1024);
+    }
+    SECTION("stopping at a budget, to carry on next pass") {
+        mockServer.edgeTriggeredReads = true;
+        queue(capacity);
+        connection.handleDataReadyForRead();
+        CHECK(connection.bytesReceived() == capacity);
+        CHECK(mockServer.deferredReads == 1);
+        queue(100 * 1024);
+        connection.handleDataReadyForRead();
+        CHECK(connection.bytesReceived() == capacity + 100 * 1024);
+        CHECK(mockServer.deferredReads == 1);
+    }
+    ::close(fds[1]);
+}
+
+namespace {
+
+// Never answers, leaving the connection waiting on it.
+struct PendingResponse : Response {
+    void handle(std::shared_ptr<ResponseWriter> /*writer*/) override {
+    }
+    void cancel() override {
+    }
+};
+
+}
+
+TEST_CASE("Input behind a pending response is only read while it can be pipelined", "[ConnectionTests]") {
+    int fds[2];
+    REQUIRE(::pipe2(fds, O_NONBLOCK) == 0);
+    REQUIRE(::fcntl(fds[1], F_SETPIPE_SZ, 1024 * 1024) > 0);
+    sockaddr_in addr{};
+    auto logger = std::make_shared<IgnoringLogger>();
+    Server server(logger);
+    MockServerImpl mockServer;
+    mockServer.realServer = &server;
+    mockServer.response = std::make_shared<PendingResponse>();
+    Connection connection(logger, mockServer, fds[0], addr);
+    auto queue = [&](const std::string& data) {
+        REQUIRE(::write(fds[1], data.data(), data.size()) == static_cast<ssize_t>(data.size()));
+    };
+    const std::string request = "GET / HTTP/1.1\r\n\r\n";
+
+    SECTION("carrying on while there's room") {
+        queue(request + request + request);
+        connection.handleDataReadyForRead();
+        CHECK(mockServer.readInterest);
+    }
+    SECTION("stopping once the pipeline's full") {
+        std::string requests;
+        for (size_t i = 0; i < 2 + mockServer.pipelineDepth(); ++i) {
+            requests += request;
+        }
+        queue(requests);
+        connection.handleDataReadyForRead();
+        CHECK_FALSE(mockServer.readInterest);
+    }
+    SECTION("stopping once the next request's headers are too big") {
+        queue(request + "GET / HTTP/1.1\r\nX-Big: " + std::string(100 * 1024, 'x'));
+        for (int i = 0; i < 10; ++i) {
+            connection.handleDataReadyForRead();
+        }
+        CHECK_FALSE(mockServer.readInterest);
+        CHECK(connection.bytesReceived() < 100 * 1024);
+    }
+    ::close(fds[1]);
+}
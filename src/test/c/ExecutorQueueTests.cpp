@@ -0,0 +1,148 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/ExecutorQueue.h"
+
+#include <catch2/catch.hpp>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace seasocks;
+
+TEST_CASE("Task stores small callables inline and large ones on the heap", "[ExecutorQueueTests]") {
+    int calls = 0;
+    auto counter = std::make_shared<int>(0);
+
+    Task small([&calls, counter] { ++calls; });
+    std::array<char, 2 * Task::InlineSize> big{};
+    Task large([&calls, counter, big] { calls += 1 + big[0]; });
+    CHECK(counter.use_count() == 3);
+
+    Task moved(std::move(large));
+    CHECK_FALSE(large);
+    REQUIRE(moved);
+    small();
+    moved();
+    CHECK(calls == 2);
+
+    small.reset();
+    moved = Task();
+    CHECK(counter.use_count() == 1);
+}
+
+TEST_CASE("ExecutorQueue", "[ExecutorQueueTests]") {
+    ExecutorQueue queue(8);
+    std::vector<int> ran;
+
+    SECTION("only the first push needs a wakeup") {
+        CHECK(queue.push(Task([&] { ran.push_back(1); })));
+        CHECK_FALSE(queue.push(Task([&] { ran.push_back(2); })));
+        CHECK(queue.depth() == 2);
+        CHECK_FALSE(queue.runBatch(100));
+        CHECK(ran == std::vector<int>({1, 2}));
+        CHECK(queue.push(Task([&] { ran.push_back(3); })));
+        CHECK(queue.executed() == 2);
+    }
+
+    SECTION("runs in batches") {
+        for (int i = 0; i < 5; ++i) {
+            queue.push(Task([&ran, i] { ran.push_back(i); }));
+        }
+        CHECK(queue.runBatch(3));
+        CHECK(ran == std::vector<int>({0, 1, 2}));
+        // Still considered woken while tasks remain.
+        CHECK_FALSE(queue.push(Task([&] { ran.push_back(5); })));
+        CHECK_FALSE(queue.runBatch(3));
+        CHECK(ran == std::vector<int>({0, 1, 2, 3, 4, 5}));
+        CHECK(queue.depth() == 0);
+    }
+
+    SECTION("overflows in order") {
+        for (int i = 0; i < 20; ++i) {
+            queue.push(Task([&ran, i] { ran.push_back(i); }));
+        }
+        CHECK(queue.overflowed() == 12);
+        CHECK(queue.depth() == 20);
+        CHECK(queue.runBatch(10));
+        queue.push(Task([&] { ran.push_back(20); }));
+        CHECK_FALSE(queue.runBatch(100));
+        REQUIRE(ran.size() == 21);
+        for (int i = 0; i < 21; ++i) {
+            CHECK(ran[i] == i);
+        }
+    }
+
+    SECTION("tasks can queue more tasks") {
+        queue.push(Task([&] {
+            ran.push_back(1);
+            queue.push(Task([&] { ran.push_back(2); }));
+        }));
+        CHECK_FALSE(queue.runBatch(100));
+        CHECK(ran == std::vector<int>({1, 2}));
+    }
+}
+
+TEST_CASE("ExecutorQueue with many producers", "[ExecutorQueueTests]") {
+    constexpr int NumProducers = 4;
+    constexpr int PerProducer = 20000;
+    ExecutorQueue queue(64);
+    std::array<int, NumProducers> lastSeen;
+    lastSeen.fill(-1);
+    std::atomic<bool> outOfOrder(false);
+    std::atomic<int> wakeups(0);
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < NumProducers; ++p) {
+        producers.emplace_back([&, p] {
+            for (int i = 0; i < PerProducer; ++i) {
+                // Only touched by the consumer.
+                auto task = [&lastSeen, &outOfOrder, p, i] {
+                    if (lastSeen[p] != i - 1) {
+                        outOfOrder = true;
+                    }
+                    lastSeen[p] = i;
+                };
+                if (queue.push(Task(task))) {
+                    wakeups++;
+                }
+            }
+        });
+    }
+    while (queue.executed() < static_cast<uint64_t>(NumProducers * PerProducer)) {
+        queue.runBatch(256);
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    CHECK_FALSE(queue.runBatch(256));
+    CHECK_FALSE(outOfOrder);
+    CHECK(queue.depth() == 0);
+    CHECK(wakeups > 0);
+    CHECK(wakeups <= NumProducers * PerProducer);
+}
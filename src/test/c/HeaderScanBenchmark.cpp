@@ -0,0 +1,143 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Measures how quickly request headers can be scanned: finding the end of the
+// headers, splitting them into lines, and coping with a header that trickles in
+// a few bytes at a time. Run it from a release build:
+//   make benchmark
+
+#include "internal/ByteScan.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+using namespace seasocks;
+
+namespace {
+
+const std::string request =
+    "GET /some/reasonably/long/path?with=a&query=string HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:109.0) Gecko/20100101 Firefox/115.0\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+    "Accept-Language: en-GB,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Connection: keep-alive\r\n"
+    "Cookie: session=0123456789abcdef0123456789abcdef; preferences=dark-mode; tracking=no\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "Sec-Fetch-Dest: document\r\n"
+    "Sec-Fetch-Mode: navigate\r\n"
+    "Sec-Fetch-Site: none\r\n"
+    "\r\n";
+
+const uint8_t* first(const std::string& str) {
+    return reinterpret_cast<const uint8_t*>(str.data());
+}
+
+const uint8_t* last(const std::string& str) {
+    return first(str) + str.size();
+}
+
+// How the headers were found before: a byte at a time, from the start.
+const uint8_t* naiveFindCrLfCrLf(const uint8_t* first, const uint8_t* last) {
+    for (auto ptr = first; ptr + 3 < last; ++ptr) {
+        if (ptr[0] == '\r' && ptr[1] == '\n' && ptr[2] == '\r' && ptr[3] == '\n') {
+            return ptr;
+        }
+    }
+    return last;
+}
+
+size_t splitLines(const uint8_t* first, const uint8_t* last) {
+    size_t colons = 0;
+    while (first < last) {
+        auto lineEnd = findCrLf(first, last);
+        colons += findByte(first, lineEnd, ':') != lineEnd;
+        first = lineEnd + 2;
+    }
+    return colons;
+}
+
+template <typename Fn>
+void report(const char* name, size_t bytesPerRun, Fn&& fn) {
+    using namespace std::chrono;
+    size_t runs = 0;
+    size_t sink = 0;
+    auto start = steady_clock::now();
+    auto elapsed = steady_clock::duration::zero();
+    while (elapsed < milliseconds(500)) {
+        for (int i = 0; i < 64; ++i) {
+            sink += fn();
+        }
+        runs += 64;
+        elapsed = steady_clock::now() - start;
+    }
+    auto seconds = duration<double>(elapsed).count();
+    std::printf("%-40s %10.1f MB/s  (%zu)\n", name, runs * bytesPerRun / seconds / 1e6, sink % 10);
+}
+
+// Feeds a 60KB header in 'step' byte pieces, searching after each piece either
+// from the start or from where the previous search stopped.
+size_t trickle(const std::string& headers, size_t step, bool incremental) {
+    size_t found = 0;
+    size_t scanned = 0;
+    for (size_t available = 0; available < headers.size();) {
+        available = std::min(available + step, headers.size());
+        auto limit = first(headers) + available;
+        if (incremental) {
+            auto from = scanned > 3 ? scanned - 3 : 0;
+            found += findCrLfCrLf(first(headers) + from, limit) != limit;
+            scanned = available;
+        } else {
+            found += naiveFindCrLfCrLf(first(headers), limit) != limit;
+        }
+    }
+    return found;
+}
+
+}
+
+int main() {
+    report("end of headers, byte at a time", request.size(), [] {
+        return naiveFindCrLfCrLf(first(request), last(request)) - first(request);
+    });
+    report("end of headers, vectorised", request.size(), [] {
+        return findCrLfCrLf(first(request), last(request)) - first(request);
+    });
+    report("split into header lines", request.size(), [] {
+        return splitLines(first(request), last(request) - 2);
+    });
+
+    std::string longHeaders = "GET / HTTP/1.1\r\nX-Padding: " + std::string(60 * 1024, 'x') + "\r\n\r\n";
+    report("60KB header in 256B pieces, rescanning", longHeaders.size(), [&] {
+        return trickle(longHeaders, 256, false);
+    });
+    report("60KB header in 256B pieces, resuming", longHeaders.size(), [&] {
+        return trickle(longHeaders, 256, true);
+    });
+    return 0;
+}
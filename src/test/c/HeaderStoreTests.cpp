@@ -0,0 +1,93 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/HeaderStore.h"
+
+#include <catch2/catch.hpp>
+
+#include <string>
+
+using namespace seasocks;
+
+namespace {
+
+// Parses "name: value" lines the simple way, for the tests' benefit.
+HeaderStore parse(const std::string& text) {
+    auto data = reinterpret_cast<const uint8_t*>(text.data());
+    HeaderStore store(data, data + text.size());
+    std::string_view block(reinterpret_cast<const char*>(store.begin()), text.size());
+    while (!block.empty()) {
+        auto lineEnd = block.find('\n');
+        auto line = block.substr(0, lineEnd);
+        auto colon = line.find(':');
+        store.add(line.substr(0, colon), line.substr(colon + 2));
+        block.remove_prefix(lineEnd == std::string_view::npos ? block.size() : lineEnd + 1);
+    }
+    return store;
+}
+
+}
+
+TEST_CASE("Known headers are found by slot and by name", "[HeaderStoreTests]") {
+    auto store = parse("host: example.com\nContent-Length: 12\nX-Custom: yes");
+    CHECK(store.has(KnownHeader::Host));
+    CHECK(store.get(KnownHeader::Host) == "example.com");
+    CHECK(store.get("HOST") == "example.com");
+    CHECK(store.get(KnownHeader::ContentLength) == "12");
+    CHECK_FALSE(store.has(KnownHeader::Upgrade));
+    CHECK(store.get(KnownHeader::Upgrade).empty());
+}
+
+TEST_CASE("Other headers are found by name", "[HeaderStoreTests]") {
+    auto store = parse("X-Custom: yes\nAccept: */*");
+    CHECK(store.has("x-custom"));
+    CHECK(store.get("X-CUSTOM") == "yes");
+    CHECK(store.get("Accept") == "*/*");
+    CHECK_FALSE(store.has("X-Custo"));
+    CHECK(store.get("Missing").empty());
+}
+
+TEST_CASE("Values point into the store's copy", "[HeaderStoreTests]") {
+    std::string text = "Cookie: a=b";
+    auto store = parse(text);
+    text.assign(text.size(), '?');
+    auto value = store.get(KnownHeader::Cookie);
+    CHECK(value == "a=b");
+    CHECK(reinterpret_cast<const uint8_t*>(value.data()) >= store.begin());
+    CHECK(reinterpret_cast<const uint8_t*>(value.data()) < store.end());
+}
+
+TEST_CASE("The first of a repeated header wins", "[HeaderStoreTests]") {
+    auto store = parse("Upgrade: first\nX-Thing: one\nupgrade: second\nx-thing: two");
+    CHECK(store.get(KnownHeader::Upgrade) == "first");
+    CHECK(store.get("X-Thing") == "one");
+    CHECK(store.headers().size() == 4);
+}
+
+TEST_CASE("Moving keeps the views valid", "[HeaderStoreTests]") {
+    auto store = parse("Range: bytes=0-10");
+    HeaderStore moved(std::move(store));
+    CHECK(moved.get(KnownHeader::Range) == "bytes=0-10");
+}
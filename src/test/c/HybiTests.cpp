@@ -24,6 +24,7 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include "internal/HybiAccept.h"
+#include "internal/HybiFrame.h"
 #include "internal/HybiPacketDecoder.h"
 
 #include "seasocks/IgnoringLogger.h"
@@ -147,3 +148,55 @@ TEST_CASE("pings and pongs", "[HybiTests]") {
     testSingleString(HybiPacketDecoder::MessageState::Ping, "Hello", {0x89, 0x05, 0x48, 0x65, 0x6c, 0x6c, 0x6f});
     testSingleString(HybiPacketDecoder::MessageState::Pong, "Hello", {0x8a, 0x05, 0x48, 0x65, 0x6c, 0x6c, 0x6f});
 }
+
+TEST_CASE("encoded frames decode", "[HybiTests]") {
+    for (size_t length : {0u, 125u, 126u, 65535u, 65536u}) {
+        std::string payload(length, 'x');
+        auto frame = SharedFrame::encode(static_cast<uint8_t>(HybiPacketDecoder::Opcode::Text), payload.data(), payload.size());
+        CHECK(frame->payloadSize() == length);
+        HybiPacketDecoder decoder(ignore, frame->bytes);
+        std::vector<uint8_t> decoded;
+        CHECK(decoder.decodeNextMessage(decoded) == HybiPacketDecoder::MessageState::TextMessage);
+        CHECK(decoded.size() == length);
+        CHECK(decoder.numBytesDecoded() == frame->bytes.size());
+    }
+}
+
+TEST_CASE("fragmented messages", "[HybiTests]") {
+    std::vector<uint8_t> data{0x01, 0x03, 'H', 'e', 'l', 0x89, 0x00, 0x80, 0x02, 'l', 'o'};
+    HybiPacketDecoder decoder(ignore, data);
+    std::vector<uint8_t> decoded;
+    bool deflateNeeded;
+    bool fin;
+    CHECK(decoder.decodeNextMessage(decoded, deflateNeeded, fin) == HybiPacketDecoder::MessageState::TextMessage);
+    CHECK(!fin);
+    CHECK(decoder.decodeNextMessage(decoded, deflateNeeded, fin) == HybiPacketDecoder::MessageState::Ping);
+    CHECK(fin);
+    CHECK(decoder.decodeNextMessage(decoded, deflateNeeded, fin) == HybiPacketDecoder::MessageState::Continuation);
+    CHECK(fin);
+    CHECK(std::string(decoded.begin(), decoded.end()) == "lo");
+    CHECK(decoder.numBytesDecoded() == data.size());
+}
+
+TEST_CASE("control frames can't be fragmented", "[HybiTests]") {
+    std::vector<uint8_t> data{0x09, 0x00};
+    HybiPacketDecoder decoder(ignore, data);
+    std::vector<uint8_t> decoded;
+    CHECK(decoder.decodeNextMessage(decoded) == HybiPacketDecoder::MessageState::Error);
+}
+
+TEST_CASE("frame headers are peeked before their payload arrives", "[HybiTests]") {
+    std::vector<uint8_t> data{0x82, 0xfe, 0x01, 0x00, 0x01, 0x02, 0x03, 0x04, 0xaa};
+    HybiPacketDecoder decoder(ignore, data);
+    HybiPacketDecoder::FrameHeader header;
+    CHECK(decoder.peekNextFrame(header) == HybiPacketDecoder::MessageState::BinaryMessage);
+    CHECK(header.fin);
+    CHECK(header.headerSize == 8);
+    CHECK(header.payloadLength == 256);
+    std::vector<uint8_t> decoded;
+    CHECK(decoder.decodeNextMessage(decoded) == HybiPacketDecoder::MessageState::NoMessage);
+    CHECK(decoder.numBytesDecoded() == 0);
+    std::vector<uint8_t> truncated{0x82, 0x7e, 0x01};
+    HybiPacketDecoder truncatedDecoder(ignore, truncated);
+    CHECK(truncatedDecoder.peekNextFrame(header) == HybiPacketDecoder::MessageState::NoMessage);
+}
@@ -0,0 +1,93 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/InputBuffer.h"
+
+#include <catch2/catch.hpp>
+
+#include <cstring>
+#include <string>
+
+using namespace seasocks;
+
+namespace {
+
+std::string contents(const InputBuffer& buffer) {
+    return std::string(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+}
+
+void appendString(InputBuffer& buffer, const std::string& str) {
+    auto data = reinterpret_cast<const uint8_t*>(str.data());
+    buffer.append(data, data + str.size());
+}
+
+}
+
+TEST_CASE("Reads are committed onto the end", "[InputBufferTests]") {
+    InputBuffer buffer;
+    CHECK(buffer.empty());
+    auto space = buffer.prepare(16);
+    memcpy(space, "hello", 5);
+    buffer.commit(5);
+    CHECK(contents(buffer) == "hello");
+    appendString(buffer, " world");
+    CHECK(contents(buffer) == "hello world");
+    CHECK(buffer[6] == 'w');
+}
+
+TEST_CASE("Consuming advances without moving", "[InputBufferTests]") {
+    InputBuffer buffer;
+    appendString(buffer, "abcdef");
+    auto start = buffer.data();
+    buffer.consume(2);
+    CHECK(buffer.data() == start + 2);
+    CHECK(contents(buffer) == "cdef");
+    buffer.consume(4);
+    CHECK(buffer.empty());
+    appendString(buffer, "xyz");
+    CHECK(buffer.data() == start);
+}
+
+TEST_CASE("Unconsumed data survives compaction and growth", "[InputBufferTests]") {
+    InputBuffer buffer;
+    buffer.prepare(64);
+    std::string data(64, 'a');
+    appendString(buffer, data);
+    buffer.consume(60);
+    // Fits once the consumed space is reclaimed.
+    appendString(buffer, std::string(40, 'b'));
+    CHECK(contents(buffer) == "aaaa" + std::string(40, 'b'));
+    // Needs more room than there is.
+    appendString(buffer, std::string(100, 'c'));
+    CHECK(contents(buffer) == "aaaa" + std::string(40, 'b') + std::string(100, 'c'));
+}
+
+TEST_CASE("Assign replaces the contents", "[InputBufferTests]") {
+    InputBuffer buffer;
+    appendString(buffer, "old");
+    const uint8_t fresh[] = {'n', 'e', 'w'};
+    buffer.assign(fresh, fresh + 3);
+    CHECK(contents(buffer) == "new");
+}
@@ -25,8 +25,13 @@
 
 #pragma once
 
+#include "internal/Task.h"
+#include "internal/ZeroCopySends.h"
+
 #include "seasocks/ServerImpl.h"
 
+#include <unistd.h>
+
 #include <stdexcept>
 #include <unordered_map>
 
@@ -38,14 +43,23 @@ public:
 
     std::string staticPath;
     std::unordered_map<std::string, std::shared_ptr<WebSocket::Handler>> handlers;
+    bool edgeTriggeredReads = false;
+    int deferredReads = 0;
+    bool readInterest = true;
+    // What every page request is answered with.
+    std::shared_ptr<Response> response;
+    size_t spillThreshold = 0;
+    // For tests that need requests to be parsed.
+    Server* realServer = nullptr;
 
     void remove(Connection* /*connection*/) override {
     }
-    bool subscribeToWriteEvents(Connection* /*connection*/) override {
-        return false;
-    };
-    bool unsubscribeFromWriteEvents(Connection* /*connection*/) override {
-        return false;
+    void lingerZeroCopy(int fd, std::unique_ptr<ZeroCopySends> /*sends*/) override {
+        ::close(fd);
+    }
+    bool setInterest(Connection* /*connection*/, bool reading, bool /*writing*/) override {
+        readInterest = reading;
+        return true;
     }
     const std::string& getStaticPath() const override {
         return staticPath;
@@ -59,20 +73,66 @@ public:
     bool isCrossOriginAllowed(const std::string& /*endpoint*/) const override {
         return false;
     }
-    std::shared_ptr<Response> handle(const Request& /*request*/) override {
-        return std::shared_ptr<Response>();
+    std::shared_ptr<Response> handle(const std::shared_ptr<Request>& /*request*/, size_t /*firstHandler*/) override {
+        return response;
+    }
+    std::shared_ptr<BodyHandler> bodyHandler(const Request& /*request*/) override {
+        return nullptr;
     }
     std::string getStatsDocument() const override {
         return "";
     }
     void checkThread() const override {
     }
+    void post(Task&& task) override {
+        task();
+    }
     Server& server() override {
-        throw std::runtime_error("not supported");
+        if (!realServer) {
+            throw std::runtime_error("not supported");
+        }
+        return *realServer;
     };
     size_t clientBufferSize() const override {
         return 512 * 1024;
     }
+    size_t pipelineDepth() const override {
+        return 16;
+    }
+    size_t maxRequestBodySize() const override {
+        return 1024 * 1024 * 1024u;
+    }
+    size_t requestBodySpillThreshold() const override {
+        return spillThreshold;
+    }
+    bool edgeTriggered() const override {
+        return edgeTriggeredReads;
+    }
+    size_t zeroCopyThreshold() const override {
+        return 0;
+    }
+    bool autoCork() const override {
+        return false;
+    }
+    WorkerPool* filePool() override {
+        return nullptr;
+    }
+    void deferFlush(Connection* /*connection*/) override {
+    }
+    void cancelDeferredFlush(Connection* /*connection*/) override {
+    }
+    void deferRead(Connection* /*connection*/) override {
+        ++deferredReads;
+    }
+    void cancelDeferredRead(Connection* /*connection*/) override {
+    }
+    bool runsOnThisReactor(const WebSocket::Handler& /*handler*/) const override {
+        return true;
+    }
+    bool handOff(Connection* /*connection*/, const WebSocket::Handler& /*handler*/,
+                 std::vector<uint8_t>&& /*input*/) override {
+        return false;
+    }
 };
 
 }
@@ -0,0 +1,206 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/OutputChain.h"
+
+#include <catch2/catch.hpp>
+
+#include <cstring>
+#include <string>
+
+using namespace seasocks;
+
+namespace {
+
+std::string contents(const OutputChain& chain) {
+    iovec iov[64];
+    auto count = chain.gather(iov, 64);
+    std::string result;
+    for (int i = 0; i < count; ++i) {
+        result.append(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+    }
+    return result;
+}
+
+}
+
+TEST_CASE("Appends are copied across blocks", "[OutputChainTests]") {
+    OutputChain chain;
+    CHECK(chain.empty());
+    std::string data(OutputChain::BlockSize * 2 + 100, 'x');
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<char>('a' + i % 26);
+    }
+    chain.append(data.data(), 10);
+    chain.append(data.data() + 10, data.size() - 10);
+    CHECK(chain.size() == data.size());
+    iovec iov[8];
+    CHECK(chain.gather(iov, 8) == 3);
+    CHECK(contents(chain) == data);
+}
+
+TEST_CASE("Consuming drops from the front", "[OutputChainTests]") {
+    OutputChain chain;
+    std::string data(OutputChain::BlockSize + 10, 'y');
+    data[0] = 'a';
+    data[OutputChain::BlockSize] = 'b';
+    chain.append(data.data(), data.size());
+    chain.consume(1);
+    CHECK(contents(chain) == data.substr(1));
+    chain.consume(OutputChain::BlockSize - 1);
+    CHECK(chain.size() == 10);
+    CHECK(contents(chain) == data.substr(OutputChain::BlockSize));
+    chain.consume(10);
+    CHECK(chain.empty());
+    chain.append("more", 4);
+    CHECK(contents(chain) == "more");
+}
+
+TEST_CASE("Borrowed segments aren't copied", "[OutputChainTests]") {
+    OutputChain chain;
+    static const char borrowed[] = "borrowed";
+    auto owner = std::make_shared<int>(0);
+    std::weak_ptr<int> watcher = owner;
+
+    chain.append("head:", 5);
+    chain.appendBorrowed(borrowed, 8, std::move(owner));
+    chain.append(":tail", 5);
+    CHECK(contents(chain) == "head:borrowed:tail");
+
+    iovec iov[3];
+    REQUIRE(chain.gather(iov, 3) == 3);
+    CHECK(iov[1].iov_base == borrowed);
+    CHECK(chain.gather(iov, 2) == 2);
+
+    chain.consume(9);
+    CHECK(contents(chain) == "owed:tail");
+    CHECK_FALSE(watcher.expired());
+    chain.consume(4);
+    CHECK(watcher.expired());
+    CHECK(contents(chain) == ":tail");
+}
+
+TEST_CASE("Clearing releases borrowed data", "[OutputChainTests]") {
+    auto owner = std::make_shared<int>(0);
+    std::weak_ptr<int> watcher = owner;
+    {
+        OutputChain chain;
+        chain.appendBorrowed("abc", 3, std::move(owner));
+        chain.clear();
+        CHECK(chain.empty());
+        CHECK(watcher.expired());
+    }
+}
+
+TEST_CASE("Writing in place", "[OutputChainTests]") {
+    OutputChain chain;
+    chain.append("head:", 5);
+    size_t room = 0;
+    auto space = chain.reserve(4, room);
+    CHECK(room == OutputChain::BlockSize - 5);
+    memcpy(space, "body", 4);
+    chain.commit(4);
+    CHECK(contents(chain) == "head:body");
+
+    // Asking for more than the block has left starts another.
+    chain.reserve(OutputChain::BlockSize, room);
+    CHECK(room == OutputChain::BlockSize);
+    chain.commit(0);
+    CHECK(chain.size() == 9);
+}
+
+TEST_CASE("Headers are filled in afterwards", "[OutputChainTests]") {
+    OutputChain chain;
+    chain.append("first", 5);
+    auto mark = chain.reserveHeader(4);
+    chain.append("payload", 7);
+    CHECK(chain.size() == 16);
+    chain.setHeader(mark, 4, "<>", 2);
+    CHECK(chain.size() == 14);
+    CHECK(contents(chain) == "first<>payload");
+
+    // The block the segments share is only released once both are consumed.
+    chain.consume(5);
+    CHECK(contents(chain) == "<>payload");
+    chain.append("!", 1);
+    CHECK(contents(chain) == "<>payload!");
+    chain.consume(10);
+    CHECK(chain.empty());
+}
+
+TEST_CASE("Truncating drops from the end", "[OutputChainTests]") {
+    OutputChain chain;
+    std::string data(OutputChain::BlockSize + 10, 'x');
+    chain.append("head:", 5);
+    chain.reserveHeader(10);
+    chain.append(data.data(), data.size());
+    chain.appendBorrowed("borrowed", 8, nullptr);
+    chain.truncate(5 + 10 + data.size() + 3);
+    CHECK(chain.size() == 5 + 10 + data.size() + 3);
+    CHECK(contents(chain).substr(15) == data + "bor");
+    chain.truncate(5);
+    CHECK(contents(chain) == "head:");
+    chain.append("tail", 4);
+    CHECK(contents(chain) == "head:tail");
+    chain.truncate(0);
+    CHECK(chain.empty());
+}
+
+TEST_CASE("Parts of files are sent separately", "[OutputChainTests]") {
+    OutputChain chain;
+    auto owner = std::make_shared<int>(0);
+    std::weak_ptr<int> watcher = owner;
+
+    chain.append("head:", 5);
+    chain.appendFile(42, 100, 1000, std::move(owner));
+    chain.append(":tail", 5);
+    CHECK(chain.size() == 1010);
+    CHECK(chain.fileBytes() == 1000);
+    CHECK(chain.memoryBytes() == 10);
+    CHECK(contents(chain) == "head:");
+
+    int fd = -1;
+    uint64_t offset = 0;
+    CHECK(chain.file(0, fd, offset) == 0);
+    CHECK(chain.file(1, fd, offset) == 1000);
+    CHECK(fd == 42);
+    CHECK(offset == 100);
+
+    chain.consume(5 + 400);
+    CHECK(chain.file(0, fd, offset) == 600);
+    CHECK(offset == 500);
+    CHECK(chain.fileBytes() == 600);
+    CHECK_FALSE(watcher.expired());
+    chain.consume(600);
+    CHECK(watcher.expired());
+    CHECK(chain.fileBytes() == 0);
+    CHECK(contents(chain) == ":tail");
+
+    chain.appendFile(42, 0, 10, nullptr);
+    chain.truncate(8);
+    CHECK(chain.fileBytes() == 3);
+    chain.clear();
+    CHECK(chain.fileBytes() == 0);
+}
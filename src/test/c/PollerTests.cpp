@@ -0,0 +1,145 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/Poller.h"
+
+#include <catch2/catch.hpp>
+
+#include <cerrno>
+#include <unistd.h>
+
+using namespace seasocks;
+
+namespace {
+
+std::unique_ptr<Poller> makePoller(bool ioUring) {
+    return ioUring ? makeIoUringPoller() : makeEpollPoller();
+}
+
+// The io_uring backend may interrupt a blocking wait on its descriptor when it
+// has completion work to do; the Server loop ignores such interruptions too.
+int waitIgnoringInterrupts(Poller& poller, epoll_event (&events)[4], int millis) {
+    int result;
+    do {
+        result = poller.wait(events, 4, millis);
+    } while (result == -1 && errno == EINTR);
+    return result;
+}
+
+struct Pipe {
+    int read;
+    int write;
+    Pipe() {
+        int fds[2];
+        REQUIRE(::pipe(fds) == 0);
+        read = fds[0];
+        write = fds[1];
+    }
+    ~Pipe() {
+        ::close(read);
+        ::close(write);
+    }
+};
+
+void pollerTests(bool ioUring) {
+    auto poller = makePoller(ioUring);
+    if (!poller) {
+        WARN("Poller unavailable on this system");
+        return;
+    }
+    Pipe pipe;
+    int tag;
+    epoll_event events[4];
+
+    SECTION("nothing ready times out") {
+        REQUIRE(poller->add(pipe.read, EPOLLIN, &tag));
+        CHECK(poller->wait(events, 4, 10) == 0);
+    }
+
+    SECTION("reports readable data, level triggered") {
+        REQUIRE(poller->add(pipe.read, EPOLLIN, &tag));
+        REQUIRE(::write(pipe.write, "x", 1) == 1);
+        REQUIRE(poller->wait(events, 4, 1000) == 1);
+        CHECK(events[0].data.ptr == &tag);
+        CHECK((events[0].events & EPOLLIN) != 0);
+        // Not consumed, so it should be reported again.
+        REQUIRE(poller->wait(events, 4, 1000) == 1);
+        CHECK(events[0].data.ptr == &tag);
+        char c;
+        REQUIRE(::read(pipe.read, &c, 1) == 1);
+        CHECK(poller->wait(events, 4, 10) == 0);
+    }
+
+    SECTION("modify changes interest and data") {
+        int otherTag;
+        REQUIRE(poller->add(pipe.write, EPOLLIN, &tag));
+        CHECK(poller->wait(events, 4, 10) == 0);
+        REQUIRE(poller->modify(pipe.write, EPOLLIN | EPOLLOUT, &otherTag));
+        REQUIRE(poller->wait(events, 4, 1000) == 1);
+        CHECK(events[0].data.ptr == &otherTag);
+        CHECK((events[0].events & EPOLLOUT) != 0);
+    }
+
+    SECTION("removed descriptors are not reported") {
+        REQUIRE(poller->add(pipe.read, EPOLLIN, &tag));
+        REQUIRE(::write(pipe.write, "x", 1) == 1);
+        REQUIRE(poller->remove(pipe.read));
+        CHECK(poller->wait(events, 4, 10) == 0);
+        CHECK_FALSE(poller->remove(pipe.read));
+    }
+
+    SECTION("fd signals pending events") {
+        auto outer = makeEpollPoller();
+        REQUIRE(outer);
+        REQUIRE(outer->add(poller->fd(), EPOLLIN, &tag));
+        REQUIRE(poller->add(pipe.read, EPOLLIN, &tag));
+        REQUIRE(poller->submit());
+        CHECK(waitIgnoringInterrupts(*outer, events, 10) == 0);
+        REQUIRE(::write(pipe.write, "x", 1) == 1);
+        CHECK(waitIgnoringInterrupts(*outer, events, 1000) == 1);
+    }
+}
+
+}
+
+TEST_CASE("epoll poller", "[PollerTests]") {
+    pollerTests(false);
+}
+
+TEST_CASE("io_uring poller", "[PollerTests]") {
+    pollerTests(true);
+}
+
+TEST_CASE("io_uring can't wait exclusively", "[PollerTests]") {
+    auto poller = makeIoUringPoller();
+    if (!poller) {
+        WARN("Poller unavailable on this system");
+        return;
+    }
+    Pipe pipe;
+    int tag;
+    CHECK_FALSE(poller->add(pipe.read, EPOLLIN | EPOLLEXCLUSIVE, &tag));
+    CHECK(errno == EINVAL);
+}
@@ -26,8 +26,52 @@
 #include <catch2/catch.hpp>
 #include "seasocks/Request.h"
 
+#include <map>
+#include <stdexcept>
+
 using seasocks::Request;
 
+namespace {
+
+// A request written before getHeaderView() was added.
+struct HeadersOnlyRequest : Request {
+    std::map<std::string, std::string> headers;
+
+    seasocks::Server& server() const override {
+        throw std::runtime_error("not supported");
+    }
+    Verb verb() const override {
+        return Verb::Get;
+    }
+    std::shared_ptr<seasocks::Credentials> credentials() const override {
+        return nullptr;
+    }
+    const sockaddr_in& getRemoteAddress() const override {
+        return address;
+    }
+    const std::string& getRequestUri() const override {
+        return uri;
+    }
+    size_t contentLength() const override {
+        return 0;
+    }
+    const uint8_t* content() const override {
+        return nullptr;
+    }
+    bool hasHeader(const std::string& name) const override {
+        return headers.count(name) > 0;
+    }
+    std::string getHeader(const std::string& name) const override {
+        auto found = headers.find(name);
+        return found == headers.end() ? std::string() : found->second;
+    }
+
+    sockaddr_in address{};
+    std::string uri = "/";
+};
+
+}
+
 TEST_CASE("request verb to name", "[RequestTest]") {
     using Catch::Matchers::Equals;
     using V = Request::Verb;
@@ -56,3 +100,13 @@ TEST_CASE("request verb from string", "[RequestTest]") {
     CHECK(Request::verb("invalid") == V::Invalid);
     CHECK(Request::verb("abc") == V::Invalid);
 }
+
+TEST_CASE("header views default to copies of headers", "[RequestTest]") {
+    HeadersOnlyRequest request;
+    request.headers["Host"] = "example.com";
+    auto view = request.getHeaderView("Host");
+    CHECK(view == "example.com");
+    CHECK(request.getHeaderView("Missing").empty());
+    // Asking again leaves earlier views valid.
+    CHECK(request.getHeaderView("Host").data() == view.data());
+}
@@ -23,32 +23,366 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include "ConnectionTestAccess.h"
 #include "seasocks/Server.h"
 #include "seasocks/Connection.h"
 #include "seasocks/IgnoringLogger.h"
+#include "seasocks/PageHandler.h"
+#include "seasocks/Request.h"
+#include "seasocks/Response.h"
+#include "seasocks/ResponseWriter.h"
 
 #include <catch2/catch.hpp>
 
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <thread>
 #include <chrono>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 using namespace seasocks;
 
 
+namespace {
+
+int findFreePort() {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    socklen_t len = sizeof(addr);
+    ::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len);
+    ::close(fd);
+    return ntohs(addr.sin_port);
+}
+
+int connectTo(int port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Runs a Server's loop on a thread of its own for the length of a test. Catch
+// can only be used on the test's thread, so the loop's result is checked there,
+// by stop().
+class TestServer {
+public:
+    Server server{std::make_shared<IgnoringLogger>()};
+    int port = 0;
+
+    ~TestServer() {
+        stop();
+    }
+
+    // Listens on a free port and runs the loop.
+    bool start() {
+        port = findFreePort();
+        return server.startListening(port) && run();
+    }
+    bool startUnix(const std::string& path) {
+        return server.startListeningUnix(path.c_str()) && run();
+    }
+
+    std::thread::id loopThread() const {
+        return _thread.get_id();
+    }
+
+    // Stops the loop, returning whether it ran without error.
+    bool stop() {
+        if (_thread.joinable()) {
+            server.terminate();
+            _thread.join();
+        }
+        return _loopResult;
+    }
+
+private:
+    bool run() {
+        _thread = std::thread([this] { _loopResult = server.loop(); });
+        return true;
+    }
+
+    std::thread _thread;
+    std::atomic<bool> _loopResult{false};
+};
+
+// Connects a WebSocket to the endpoint, returning the socket once the handshake
+// is done, and the response headers in 'response' if given.
+int openWebSocket(int port, const std::string& endpoint, std::string* response = nullptr) {
+    int fd = connectTo(port);
+    if (fd == -1) {
+        return -1;
+    }
+    std::string request = "GET " + endpoint + " HTTP/1.1\r\n"
+                                              "Host: localhost\r\n"
+                                              "Connection: Upgrade\r\n"
+                                              "Upgrade: websocket\r\n"
+                                              "Sec-WebSocket-Version: 13\r\n"
+                                              "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n\r\n";
+    ::send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+    // Read a byte at a time so as not to consume any frames.
+    std::string headers;
+    char c;
+    while (headers.find("\r\n\r\n") == std::string::npos && ::read(fd, &c, 1) == 1) {
+        headers += c;
+    }
+    if (response) {
+        *response = std::move(headers);
+    }
+    return fd;
+}
+
+// Reads a single unmasked frame, returning its payload.
+std::string readFrame(int fd, uint8_t& firstByte) {
+    auto readFully = [fd](void* data, size_t size) {
+        auto bytes = static_cast<char*>(data);
+        while (size) {
+            auto numRead = ::read(fd, bytes, size);
+            if (numRead <= 0) {
+                return false;
+            }
+            bytes += numRead;
+            size -= numRead;
+        }
+        return true;
+    };
+    uint8_t header[2];
+    if (!readFully(header, 2)) {
+        return "";
+    }
+    firstByte = header[0];
+    uint64_t length = header[1];
+    if (length >= 126) {
+        uint8_t extended[8];
+        auto lengthBytes = length == 126 ? 2u : 8u;
+        readFully(extended, lengthBytes);
+        length = 0;
+        for (auto i = 0u; i < lengthBytes; ++i) {
+            length = (length << 8) | extended[i];
+        }
+    }
+    std::string payload(length, '\0');
+    readFully(&payload[0], length);
+    return payload;
+}
+
+
+// Performs a WebSocket handshake and hangs up, returning the response headers.
+std::string webSocketHandshake(int port, const std::string& endpoint) {
+    std::string response;
+    int fd = openWebSocket(port, endpoint, &response);
+    if (fd != -1) {
+        ::close(fd);
+    }
+    return response;
+}
+
+struct PinnedHandler : WebSocket::Handler {
+    std::atomic<int> connects{0};
+    std::atomic<int> wrongReactor{0};
+
+    void onConnect(WebSocket* connection) override {
+        if (connection->server().reactorIndex() != 1) {
+            wrongReactor++;
+        }
+        connects++;
+    }
+    void onDisconnect(WebSocket*) override {
+    }
+    bool runsOnReactor(size_t reactorIndex) const override {
+        return reactorIndex == 1;
+    }
+};
+
+// Answers with the index of the reactor that served the request.
+struct ReactorHandler : PageHandler {
+    std::shared_ptr<Response> handle(const Request& request) override {
+        if (request.getRequestUri() != "/reactor") {
+            return Response::unhandled();
+        }
+        return Response::textResponse("reactor=" + std::to_string(request.server().reactorIndex()) + ";");
+    }
+};
+
+struct ContentLengthHandler : PageHandler {
+    std::shared_ptr<Response> handle(const Request& request) override {
+        if (request.verb() != Request::Verb::Post) {
+            return Response::unhandled();
+        }
+        return Response::textResponse("length=" + std::to_string(request.contentLength()) + ";");
+    }
+};
+
+// Sends a GET for 'path', returning the response up to and including the first ';' in it.
+std::string getUntilSemicolon(int fd, const std::string& path) {
+    std::string request = "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    ::send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+    std::string response;
+    char buf[1024];
+    while (response.find(';') == std::string::npos) {
+        auto numRead = ::read(fd, buf, sizeof(buf));
+        if (numRead <= 0) {
+            break;
+        }
+        response.append(buf, numRead);
+    }
+    return response;
+}
+
+// Serves "/slow" from the worker pool once released, declining anything else.
+struct SlowHandler : PageHandler {
+    std::atomic<bool> release{false};
+    std::atomic<int> running{0};
+    std::atomic<int> onLoopThread{0};
+    std::thread::id loopThread;
+
+    std::shared_ptr<Response> handle(const Request& request) override {
+        if (std::this_thread::get_id() == loopThread) {
+            onLoopThread++;
+        }
+        if (request.getRequestUri() != "/slow") {
+            return Response::unhandled();
+        }
+        running++;
+        while (!release) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return Response::textResponse("slow;");
+    }
+    bool offloaded() const override {
+        return true;
+    }
+};
+
+// A response that throws, after beginning if 'late' is set.
+struct ThrowingResponse : Response {
+    bool late;
+    explicit ThrowingResponse(bool l)
+            : late(l) {
+    }
+    void handle(std::shared_ptr<ResponseWriter> writer) override {
+        if (late) {
+            writer->begin(ResponseCode::Ok);
+            writer->header("Content-Length", "100");
+            writer->payload("partial;", 8, true);
+        }
+        throw std::runtime_error("response failed");
+    }
+    void cancel() override {
+    }
+};
+
+// Serves "/throws" and "/throws-late" from the worker pool with a ThrowingResponse.
+struct ThrowingHandler : PageHandler {
+    std::shared_ptr<Response> handle(const Request& request) override {
+        if (request.getRequestUri() == "/throws") {
+            return std::make_shared<ThrowingResponse>(false);
+        }
+        if (request.getRequestUri() == "/throws-late") {
+            return std::make_shared<ThrowingResponse>(true);
+        }
+        return Response::unhandled();
+    }
+    bool offloaded() const override {
+        return true;
+    }
+};
+
+struct PathHandler : PageHandler {
+    std::atomic<int> offLoopThread{0};
+    std::thread::id loopThread;
+
+    std::shared_ptr<Response> handle(const Request& request) override {
+        if (std::this_thread::get_id() != loopThread) {
+            offLoopThread++;
+        }
+        return Response::textResponse("path=" + request.getRequestUri() + ";");
+    }
+};
+
+void edgeTriggeredTests(Server::LoopBackend backend) {
+    TestServer running;
+    auto& server = running.server;
+    server.setLoopBackend(backend);
+    server.setEdgeTriggered(true);
+    CHECK(server.edgeTriggered());
+    server.addPageHandler(std::make_shared<ContentLengthHandler>());
+    auto handler = std::make_shared<PinnedHandler>();
+    server.addWebSocketHandler("/pinned", handler);
+    REQUIRE(running.start());
+    auto port = running.port;
+
+    SECTION("handshakes") {
+        for (auto i = 0; i < 4; ++i) {
+            auto response = webSocketHandshake(port, "/pinned");
+            CHECK(response.compare(0, 12, "HTTP/1.1 101") == 0);
+        }
+    }
+
+    SECTION("reads bodies bigger than one wakeup's worth") {
+        // Several wakeups' reads, so the rest has to be picked up on later passes.
+        const size_t bodySize = 4 * 1024 * 1024;
+        std::string request = "POST /upload HTTP/1.1\r\n"
+                              "Host: localhost\r\n"
+                              "Content-Length: " +
+                              std::to_string(bodySize) + "\r\n\r\n" + std::string(bodySize, 'x');
+        int fd = connectTo(port);
+        REQUIRE(fd != -1);
+        size_t sent = 0;
+        while (sent < request.size()) {
+            auto numSent = ::send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+            REQUIRE(numSent > 0);
+            sent += numSent;
+        }
+        std::string response;
+        char buf[1024];
+        while (response.find(';') == std::string::npos) {
+            auto numRead = ::read(fd, buf, sizeof(buf));
+            if (numRead <= 0) {
+                break;
+            }
+            response.append(buf, numRead);
+        }
+        ::close(fd);
+        CHECK(response.compare(0, 12, "HTTP/1.1 200") == 0);
+        CHECK(response.find("length=" + std::to_string(bodySize) + ";") != std::string::npos);
+    }
+
+    CHECK(running.stop());
+}
+
+}
+
 TEST_CASE("Server tests", "[ServerTests]") {
-    auto logger = std::make_shared<IgnoringLogger>();
-    Server server(logger);
-    REQUIRE(server.startListening(0));
-    std::thread seasocksThread([&] {
-        REQUIRE(server.loop());
-    });
+    TestServer running;
+    auto& server = running.server;
+    REQUIRE(running.start());
 
     std::atomic<int> test(0);
     SECTION("execute should work") {
-        server.execute([&] {
-            CHECK(test == 0);
-            test++;
-        });
+        // Checked here rather than in the task, which runs on the loop's thread.
+        server.execute([&] { test++; });
         for (int i = 0; i < 1000 * 1000 * 1000; ++i) {
             if (test)
                 break;
@@ -74,8 +408,1097 @@ TEST_CASE("Server tests", "[ServerTests]") {
         }
         CHECK(latch == 1);
         CHECK(test == 10000);
+        auto stats = server.executorStats();
+        CHECK(stats.executed >= 10001);
+        CHECK(stats.wakeups > 0);
+        CHECK(stats.wakeups <= stats.executed);
+        CHECK(stats.queueDepth == 0);
+    }
+
+    CHECK(running.stop());
+}
+
+TEST_CASE("Server timers", "[ServerTests]") {
+    using namespace std::literals::chrono_literals;
+
+    TestServer running;
+    auto& server = running.server;
+    server.setLameConnectionTimeoutSeconds(1);
+    REQUIRE(running.start());
+    auto port = running.port;
+
+    SECTION("timers fire, unless cancelled") {
+        std::atomic<int> fired(0);
+        std::atomic<bool> cancelled(false);
+        server.execute([&] {
+            server.schedule(20ms, [&] { fired++; });
+            auto timer = server.schedule(10ms, [&] { fired += 100; });
+            cancelled = server.cancel(timer);
+        });
+        for (int i = 0; i < 1000 && !fired; ++i) {
+            std::this_thread::sleep_for(1ms);
+        }
+        std::this_thread::sleep_for(20ms);
+        CHECK(cancelled);
+        CHECK(fired == 1);
+    }
+
+    SECTION("lame connections are closed") {
+        int fd = connectTo(port);
+        REQUIRE(fd != -1);
+        auto start = std::chrono::steady_clock::now();
+        char buf[16];
+        // Blocks until the server closes the connection.
+        CHECK(::read(fd, buf, sizeof(buf)) == 0);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        CHECK(elapsed >= 900ms);
+        CHECK(elapsed < 5s);
+        ::close(fd);
+    }
+
+    CHECK(running.stop());
+}
+
+TEST_CASE("Edge-triggered epoll", "[ServerTests]") {
+    edgeTriggeredTests(Server::LoopBackend::Epoll);
+}
+
+TEST_CASE("Edge-triggered io_uring", "[ServerTests]") {
+    edgeTriggeredTests(Server::LoopBackend::IoUring);
+}
+
+TEST_CASE("Multiple reactors", "[ServerTests]") {
+    TestServer running;
+    auto& server = running.server;
+    server.setReactorCount(3);
+    auto handler = std::make_shared<PinnedHandler>();
+    server.addWebSocketHandler("/pinned", handler);
+    server.addPageHandler(std::make_shared<ReactorHandler>());
+    REQUIRE(running.start());
+    auto port = running.port;
+
+    SECTION("handlers run only on the reactors they ask for") {
+        for (auto i = 0; i < 12; ++i) {
+            auto response = webSocketHandshake(port, "/pinned");
+            CHECK(response.compare(0, 12, "HTTP/1.1 101") == 0);
+        }
+        // onConnect is called just after the handshake response is sent.
+        for (int i = 0; i < 1000 && handler->connects != 12; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        CHECK(handler->connects == 12);
+        CHECK(handler->wrongReactor == 0);
+    }
+
+    SECTION("connections are spread across the reactors") {
+        // The kernel picks a reactor by hashing each connection's addresses, so
+        // with this many every reactor is all but certain to get some.
+        std::set<std::string> reactors;
+        for (auto i = 0; i < 48; ++i) {
+            int fd = connectTo(port);
+            REQUIRE(fd != -1);
+            auto response = getUntilSemicolon(fd, "/reactor");
+            auto pos = response.find("reactor=");
+            REQUIRE(pos != std::string::npos);
+            reactors.insert(response.substr(pos));
+            ::close(fd);
+        }
+        CHECK(reactors == std::set<std::string>{"reactor=0;", "reactor=1;", "reactor=2;"});
+    }
+
+    CHECK(running.stop());
+}
+
+TEST_CASE("Reactors sharing a unix socket", "[ServerTests]") {
+    auto backend = GENERATE(Server::LoopBackend::Epoll, Server::LoopBackend::IoUring);
+    TestServer running;
+    auto& server = running.server;
+    server.setLoopBackend(backend);
+    server.setReactorCount(2);
+    server.addPageHandler(std::make_shared<ReactorHandler>());
+    char dir[] = "/tmp/seasocksXXXXXX";
+    REQUIRE(::mkdtemp(dir));
+    std::string path = std::string(dir) + "/socket";
+    REQUIRE(running.startUnix(path));
+
+    // Only one reactor is woken for each connection, which it alone accepts.
+    for (auto i = 0; i < 8; ++i) {
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        REQUIRE(::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+        auto response = getUntilSemicolon(fd, "/reactor");
+        CHECK(response.compare(0, 12, "HTTP/1.1 200") == 0);
+        CHECK(response.find("reactor=") != std::string::npos);
+        ::close(fd);
+    }
+
+    CHECK(running.stop());
+    ::unlink(path.c_str());
+    ::rmdir(dir);
+}
+
+TEST_CASE("io_uring event loop", "[ServerTests]") {
+    TestServer running;
+    auto& server = running.server;
+    server.setLoopBackend(Server::LoopBackend::IoUring);
+    server.setReactorCount(2);
+    auto handler = std::make_shared<PinnedHandler>();
+    server.addWebSocketHandler("/pinned", handler);
+    REQUIRE(running.start());
+    auto port = running.port;
+
+    SECTION("serves connections") {
+        for (auto i = 0; i < 8; ++i) {
+            auto response = webSocketHandshake(port, "/pinned");
+            CHECK(response.compare(0, 12, "HTTP/1.1 101") == 0);
+        }
+        for (int i = 0; i < 1000 && handler->connects != 8; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        CHECK(handler->connects == 8);
+        CHECK(handler->wrongReactor == 0);
+    }
+
+    SECTION("execute should work") {
+        std::atomic<bool> done(false);
+        server.execute([&] { done = true; });
+        for (int i = 0; i < 1000 && !done; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        CHECK(done);
+    }
+
+    CHECK(running.stop());
+}
+
+TEST_CASE("Offloaded page handlers", "[ServerTests]") {
+    TestServer running;
+    auto& server = running.server;
+    server.setWorkerThreads(2);
+    CHECK(server.workerThreads() == 2);
+    auto slow = std::make_shared<SlowHandler>();
+    auto path = std::make_shared<PathHandler>();
+    server.addPageHandler(slow);
+    server.addPageHandler(std::make_shared<ThrowingHandler>());
+    server.addPageHandler(path);
+    REQUIRE(running.start());
+    auto port = running.port;
+    slow->loopThread = path->loopThread = running.loopThread();
+
+    SECTION("a blocked handler doesn't hold up the loop") {
+        int slowFd = connectTo(port);
+        REQUIRE(slowFd != -1);
+        std::string request = "GET /slow HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        ::send(slowFd, request.data(), request.size(), MSG_NOSIGNAL);
+        for (int i = 0; i < 1000 && slow->running == 0; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        REQUIRE(slow->running == 1);
+
+        int fd = connectTo(port);
+        REQUIRE(fd != -1);
+        auto response = getUntilSemicolon(fd, "/other");
+        CHECK(response.compare(0, 12, "HTTP/1.1 200") == 0);
+        CHECK(response.find("path=/other;") != std::string::npos);
+        ::close(fd);
+
+        slow->release = true;
+        std::string slowResponse;
+        char buf[1024];
+        while (slowResponse.find(';') == std::string::npos) {
+            auto numRead = ::read(slowFd, buf, sizeof(buf));
+            if (numRead <= 0) {
+                break;
+            }
+            slowResponse.append(buf, numRead);
+        }
+        CHECK(slowResponse.compare(0, 12, "HTTP/1.1 200") == 0);
+        CHECK(slowResponse.find("slow;") != std::string::npos);
+        ::close(slowFd);
+    }
+
+    SECTION("declined requests continue down the chain on the loop") {
+        int fd = connectTo(port);
+        REQUIRE(fd != -1);
+        for (auto i = 0; i < 4; ++i) {
+            auto response = getUntilSemicolon(fd, "/page" + std::to_string(i));
+            CHECK(response.compare(0, 12, "HTTP/1.1 200") == 0);
+            CHECK(response.find("path=/page" + std::to_string(i) + ";") != std::string::npos);
+        }
+        ::close(fd);
+        CHECK(slow->onLoopThread == 0);
+        CHECK(path->offLoopThread == 0);
+    }
+
+    SECTION("a response that throws is answered with an error") {
+        int fd = connectTo(port);
+        REQUIRE(fd != -1);
+        auto response = getUntilSemicolon(fd, "/throws");
+        CHECK(response.compare(0, 12, "HTTP/1.1 500") == 0);
+        ::close(fd);
+    }
+
+    SECTION("a response that throws part way through is cut short") {
+        int fd = connectTo(port);
+        REQUIRE(fd != -1);
+        auto response = getUntilSemicolon(fd, "/throws-late");
+        CHECK(response.compare(0, 12, "HTTP/1.1 200") == 0);
+        CHECK(response.find("partial;") != std::string::npos);
+        char buf[1024];
+        ssize_t numRead;
+        while ((numRead = ::read(fd, buf, sizeof(buf))) > 0) {
+        }
+        CHECK(numRead == 0);
+        ::close(fd);
+    }
+
+    slow->release = true;
+    CHECK(running.stop());
+}
+
+namespace {
+
+// Reads until 'count' semicolon-terminated responses have arrived.
+std::string readResponses(int fd, size_t count) {
+    std::string response;
+    char buf[1024];
+    while (static_cast<size_t>(std::count(response.begin(), response.end(), ';')) < count) {
+        auto numRead = ::read(fd, buf, sizeof(buf));
+        if (numRead <= 0) {
+            break;
+        }
+        response.append(buf, numRead);
+    }
+    return response;
+}
+
+bool inOrder(const std::string& response, const std::vector<std::string>& parts) {
+    size_t pos = 0;
+    for (auto& part : parts) {
+        pos = response.find(part, pos);
+        if (pos == std::string::npos) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+TEST_CASE("Pipelined requests", "[ServerTests]") {
+    TestServer running;
+    auto& server = running.server;
+    server.setWorkerThreads(1);
+    auto slow = std::make_shared<SlowHandler>();
+    server.addPageHandler(slow);
+    server.addPageHandler(std::make_shared<PathHandler>());
+    REQUIRE(running.start());
+    auto port = running.port;
+
+    int fd = connectTo(port);
+    REQUIRE(fd != -1);
+
+    SECTION("are answered in order without waiting for more input") {
+        std::string requests = "GET /a HTTP/1.1\r\nHost: localhost\r\n\r\n"
+                               "POST /b HTTP/1.1\r\nHost: localhost\r\nContent-Length: 3\r\n\r\nxyz"
+                               "GET /c HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        ::send(fd, requests.data(), requests.size(), MSG_NOSIGNAL);
+        auto response = readResponses(fd, 3);
+        CHECK(inOrder(response, {"path=/a;", "path=/b;", "path=/c;"}));
+    }
+
+    SECTION("wait behind an offloaded response") {
+        std::string requests = "GET /slow HTTP/1.1\r\nHost: localhost\r\n\r\n"
+                               "GET /x HTTP/1.1\r\nHost: localhost\r\n\r\n"
+                               "GET /y HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        ::send(fd, requests.data(), requests.size(), MSG_NOSIGNAL);
+        for (int i = 0; i < 1000 && slow->running == 0; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        REQUIRE(slow->running == 1);
+        slow->release = true;
+        auto response = readResponses(fd, 3);
+        CHECK(inOrder(response, {"slow;", "path=/x;", "path=/y;"}));
+    }
+
+    SECTION("stop being read once too much input waits on a response") {
+        std::string requests = "GET /slow HTTP/1.1\r\nHost: localhost\r\n\r\n"
+                               "POST /b HTTP/1.1\r\nHost: localhost\r\nContent-Length: 100000000\r\n\r\n";
+        ::send(fd, requests.data(), requests.size(), MSG_NOSIGNAL);
+        // Far more than the socket buffers hold: it only all goes if the server keeps reading.
+        const size_t bodySize = 64 * 1024 * 1024;
+        std::string chunk(64 * 1024, 'x');
+        size_t sent = 0;
+        auto lastProgress = std::chrono::steady_clock::now();
+        while (sent < bodySize && std::chrono::steady_clock::now() - lastProgress < std::chrono::milliseconds(200)) {
+            auto numSent = ::send(fd, chunk.data(), chunk.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (numSent > 0) {
+                sent += numSent;
+                lastProgress = std::chrono::steady_clock::now();
+            }
+        }
+        CHECK(sent < bodySize);
+        slow->release = true;
+        CHECK(readResponses(fd, 1).find("slow;") != std::string::npos);
+    }
+
+    SECTION("are still answered in turn without reading ahead") {
+        server.setPipelineDepth(0);
+        CHECK(server.pipelineDepth() == 0);
+        std::string requests = "GET /slow HTTP/1.1\r\nHost: localhost\r\n\r\n"
+                               "GET /z HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        ::send(fd, requests.data(), requests.size(), MSG_NOSIGNAL);
+        slow->release = true;
+        auto response = readResponses(fd, 2);
+        CHECK(inOrder(response, {"slow;", "path=/z;"}));
+    }
+
+    ::close(fd);
+    slow->release = true;
+    CHECK(running.stop());
+}
+
+namespace {
+
+struct EchoHandler : PageHandler {
+    std::shared_ptr<Response> handle(const Request& request) override {
+        auto content = reinterpret_cast<const char*>(request.content());
+        return Response::textResponse("body=" + std::string(content ? content : "", request.contentLength()) + ";");
     }
+};
+
+// Streams the bodies of requests to "/stream", counting them.
+struct StreamingHandler : PageHandler {
+    struct Counter : BodyHandler {
+        size_t size = 0;
+        void onBodyChunk(const uint8_t* /*data*/, size_t chunkSize) override {
+            size += chunkSize;
+        }
+        std::shared_ptr<Response> onBodyEnd() override {
+            return Response::textResponse("streamed=" + std::to_string(size) + ";");
+        }
+    };
+
+    std::shared_ptr<Response> handle(const Request& /*request*/) override {
+        return Response::unhandled();
+    }
+    std::shared_ptr<BodyHandler> bodyHandler(const Request& request) override {
+        if (request.getRequestUri() != "/stream") {
+            return nullptr;
+        }
+        return std::make_shared<Counter>();
+    }
+};
+
+// Reads until the end of the headers of a response.
+std::string readHeaders(int fd) {
+    std::string response;
+    char c;
+    while (response.find("\r\n\r\n") == std::string::npos && ::read(fd, &c, 1) == 1) {
+        response += c;
+    }
+    return response;
+}
+
+}
+
+TEST_CASE("Request bodies", "[ServerTests]") {
+    TestServer running;
+    auto& server = running.server;
+    server.addPageHandler(std::make_shared<StreamingHandler>());
+    server.addPageHandler(std::make_shared<EchoHandler>());
+    REQUIRE(running.start());
+    auto port = running.port;
+
+    int fd = connectTo(port);
+    REQUIRE(fd != -1);
+    auto sendAll = [fd](const std::string& data) {
+        ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+    };
+
+    SECTION("can be chunked, with requests after them") {
+        sendAll("POST /echo HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: chunked\r\n\r\n"
+                "5;ext=1\r\nhello\r\n6\r\n world\r\n0\r\nX-Trailer: 1\r\n\r\n"
+                "GET /next HTTP/1.1\r\nHost: localhost\r\n\r\n");
+        auto response = readResponses(fd, 2);
+        CHECK(inOrder(response, {"body=hello world;", "body=;"}));
+    }
+
+    SECTION("are asked for when the client expects to continue") {
+        sendAll("POST /echo HTTP/1.1\r\nHost: localhost\r\nContent-Length: 4\r\nExpect: 100-continue\r\n\r\n");
+        CHECK(readHeaders(fd) == "HTTP/1.1 100 Continue\r\n\r\n");
+        sendAll("abcd");
+        CHECK(readResponses(fd, 1).find("body=abcd;") != std::string::npos);
+    }
+
+    SECTION("can be streamed to a BodyHandler") {
+        const size_t bodySize = 200 * 1024;
+        sendAll("POST /stream HTTP/1.1\r\nHost: localhost\r\nContent-Length: " + std::to_string(bodySize) + "\r\n\r\n");
+        sendAll(std::string(bodySize, 'x'));
+        CHECK(readResponses(fd, 1).find("streamed=" + std::to_string(bodySize) + ";") != std::string::npos);
+    }
+
+    SECTION("can be spilled to disk") {
+        server.setRequestBodySpillThreshold(16);
+        CHECK(server.requestBodySpillThreshold() == 16);
+        std::string body(100, 'z');
+        sendAll("POST /echo HTTP/1.1\r\nHost: localhost\r\nContent-Length: 100\r\n\r\n" + body);
+        CHECK(readResponses(fd, 1).find("body=" + body + ";") != std::string::npos);
+    }
+
+    SECTION("too big to buffer are refused") {
+        sendAll("POST /echo HTTP/1.1\r\nHost: localhost\r\nContent-Length: " +
+                std::to_string(Server::DefaultClientBufferSize + 1) + "\r\n\r\n");
+        CHECK(readHeaders(fd).compare(0, 12, "HTTP/1.1 413") == 0);
+    }
+
+    SECTION("too big in chunks are refused") {
+        sendAll("POST /echo HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: chunked\r\n\r\n"
+                "5\r\nhello\r\n40000000\r\n");
+        CHECK(readHeaders(fd).compare(0, 12, "HTTP/1.1 413") == 0);
+    }
+
+    SECTION("with unknown transfer encodings are refused") {
+        sendAll("POST /echo HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: gzip\r\n\r\n");
+        CHECK(readHeaders(fd).compare(0, 12, "HTTP/1.1 501") == 0);
+    }
+
+    ::close(fd);
+    CHECK(running.stop());
+}
+
+namespace {
+
+struct SenderHandler : WebSocket::Handler {
+    std::mutex mutex;
+    WebSocket::Sender sender;
+    std::atomic<bool> connected{false};
+    std::atomic<bool> disconnected{false};
+
+    void onConnect(WebSocket* connection) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        sender = connection->sender();
+        connected = true;
+    }
+    void onDisconnect(WebSocket*) override {
+        disconnected = true;
+    }
+};
+
+}
+
+TEST_CASE("WebSocket senders", "[ServerTests]") {
+    TestServer running;
+    auto& server = running.server;
+    auto handler = std::make_shared<SenderHandler>();
+    server.addWebSocketHandler("/send", handler);
+    REQUIRE(running.start());
+    auto port = running.port;
+
+    int fd = connectTo(port);
+    REQUIRE(fd != -1);
+    std::string request = "GET /send HTTP/1.1\r\n"
+                          "Host: localhost\r\n"
+                          "Connection: Upgrade\r\n"
+                          "Upgrade: websocket\r\n"
+                          "Sec-WebSocket-Version: 13\r\n"
+                          "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n\r\n";
+    ::send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+    std::string input;
+    char buf[4096];
+    while (input.find("\r\n\r\n") == std::string::npos) {
+        auto numRead = ::read(fd, buf, sizeof(buf));
+        REQUIRE(numRead > 0);
+        input.append(buf, numRead);
+    }
+    CHECK(input.compare(0, 12, "HTTP/1.1 101") == 0);
+    input.erase(0, input.find("\r\n\r\n") + 4);
+    for (int i = 0; i < 1000 && !handler->connected; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(handler->connected);
+    WebSocket::Sender sender;
+    {
+        std::lock_guard<std::mutex> lock(handler->mutex);
+        sender = handler->sender;
+    }
+    CHECK(sender.connected());
+
+    SECTION("messages from another thread arrive in order") {
+        const int numMessages = 5000;
+        std::thread producer([&] {
+            for (int i = 0; i < numMessages; ++i) {
+                auto message = "m" + std::to_string(i);
+                // The queue may fill while the loop catches up.
+                while (!sender.send(message)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        int received = 0;
+        bool inOrder = true;
+        while (received < numMessages) {
+            // Every message is short enough for a two byte header.
+            while (input.size() < 2 || input.size() < 2u + static_cast<uint8_t>(input[1])) {
+                auto numRead = ::read(fd, buf, sizeof(buf));
+                REQUIRE(numRead > 0);
+                input.append(buf, numRead);
+            }
+            auto length = static_cast<uint8_t>(input[1]);
+            CHECK(static_cast<uint8_t>(input[0]) == 0x81);
+            inOrder = inOrder && input.substr(2, length) == "m" + std::to_string(received);
+            input.erase(0, 2 + length);
+            ++received;
+        }
+        producer.join();
+        CHECK(inOrder);
+    }
+
+    SECTION("senders fail once the connection has gone") {
+        ::close(fd);
+        fd = -1;
+        for (int i = 0; i < 1000 && !handler->disconnected; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        REQUIRE(handler->disconnected);
+        CHECK_FALSE(sender.connected());
+        CHECK_FALSE(sender.send(std::string("too late")));
+    }
+
+    if (fd != -1) {
+        ::close(fd);
+    }
+    CHECK(running.stop());
+}
+
+namespace {
+
+// Subscribes connections to "/news?topic" to that topic.
+struct TopicHandler : WebSocket::Handler {
+    std::atomic<int> connects{0};
+
+    void onConnect(WebSocket* connection) override {
+        auto uri = connection->getRequestUri();
+        auto topic = uri.find('?') == std::string::npos ? std::string() : uri.substr(uri.find('?') + 1);
+        if (!topic.empty()) {
+            connection->server().subscribe(connection, topic);
+        }
+        connects++;
+    }
+    void onDisconnect(WebSocket*) override {
+    }
+};
+
+}
+
+TEST_CASE("Topics", "[ServerTests]") {
+    TestServer running;
+    auto& server = running.server;
+    server.setReactorCount(2);
+    auto handler = std::make_shared<TopicHandler>();
+    server.addWebSocketHandler("/news", handler);
+    REQUIRE(running.start());
+    auto port = running.port;
+
+    // Enough connections that both reactors should have some.
+    std::vector<int> subscribers;
+    for (int i = 0; i < 6; ++i) {
+        subscribers.push_back(openWebSocket(port, "/news?sport"));
+        REQUIRE(subscribers.back() != -1);
+    }
+    int other = openWebSocket(port, "/news?weather");
+    REQUIRE(other != -1);
+    for (int i = 0; i < 1000 && handler->connects != 7; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(handler->connects == 7);
+
+    SECTION("published messages reach every subscriber") {
+        // More than fits in a socket buffer, so some of it is queued by reference.
+        const std::string big(4 * 1024 * 1024, 'x');
+        server.execute([&] {
+            server.publish("sport", "goal!");
+            server.publish("sport", big);
+            server.publish("weather", "rain");
+            const uint8_t binary[] = {1, 2, 3};
+            server.publish("sport", binary, sizeof(binary));
+        });
+        for (auto fd : subscribers) {
+            uint8_t firstByte = 0;
+            CHECK(readFrame(fd, firstByte) == "goal!");
+            CHECK(firstByte == 0x81);
+            CHECK(readFrame(fd, firstByte) == big);
+            CHECK(readFrame(fd, firstByte) == std::string("\x01\x02\x03"));
+            CHECK(firstByte == 0x82);
+        }
+        uint8_t firstByte = 0;
+        CHECK(readFrame(other, firstByte) == "rain");
+    }
+
+    for (auto fd : subscribers) {
+        ::close(fd);
+    }
+    ::close(other);
+    CHECK(running.stop());
+}
+
+namespace {
+
+// Composes messages of various sizes as soon as it's connected to.
+struct ComposingHandler : WebSocket::Handler {
+    std::string big = std::string(70000, 'z');
+    bool checksSent = false;
+
+    void onConnect(WebSocket* connection) override {
+        connection->compose(WebSocket::Opcode::Text, 5, [](WebSocket::Composer& composer) {
+            composer.append("hel");
+            composer.append("lo");
+        });
+        // Outgrowing the hint moves to a longer header.
+        connection->compose(WebSocket::Opcode::Binary, 16, [](WebSocket::Composer& composer) {
+            for (int i = 0; i < 3; ++i) {
+                auto bytes = composer.reserve(100);
+                memset(bytes, 'a' + i, 100);
+                composer.advance(100);
+            }
+        });
+        connection->compose(WebSocket::Opcode::Text, 0, [this](WebSocket::Composer& composer) {
+            composer.append(big);
+        });
+        connection->compose(WebSocket::Opcode::Text, 2, [](WebSocket::Composer& composer) {
+            composer.append("\xc3\x28");
+        });
+        connection->compose(WebSocket::Opcode::Binary, 0, [](WebSocket::Composer&) {
+        });
+    }
+    void onDisconnect(WebSocket*) override {
+    }
+    bool validatesSentUtf8() const override {
+        return checksSent;
+    }
+};
+
+}
+
+TEST_CASE("Composed WebSocket messages", "[ServerTests]") {
+    TestServer running;
+    auto& server = running.server;
+    auto handler = std::make_shared<ComposingHandler>();
+    handler->checksSent = GENERATE(true, false);
+    server.addWebSocketHandler("/compose", handler);
+    REQUIRE(running.start());
+    auto port = running.port;
+
+    int fd = openWebSocket(port, "/compose");
+    REQUIRE(fd != -1);
+    uint8_t firstByte = 0;
+    CHECK(readFrame(fd, firstByte) == "hello");
+    CHECK(firstByte == 0x81);
+    CHECK(readFrame(fd, firstByte) == std::string(100, 'a') + std::string(100, 'b') + std::string(100, 'c'));
+    CHECK(firstByte == 0x82);
+    CHECK(readFrame(fd, firstByte) == handler->big);
+    CHECK(firstByte == 0x81);
+    if (handler->checksSent) {
+        // The invalid text isn't sent.
+        CHECK(readFrame(fd, firstByte).empty());
+        CHECK(firstByte == 0x82);
+    } else {
+        CHECK(readFrame(fd, firstByte) == "\xc3\x28");
+        CHECK(firstByte == 0x81);
+    }
+
+    ::close(fd);
+    CHECK(running.stop());
+}
+
+namespace {
+
+// Sends a burst of messages as soon as it's connected to.
+struct BurstHandler : WebSocket::Handler {
+    explicit BurstHandler(bool corks)
+            : corks(corks) {
+    }
+
+    bool corks;
+    std::atomic<WebSocket*> connection{nullptr};
+    // Send calls made before the burst.
+    size_t sendCallsBefore = 0;
+
+    void onConnect(WebSocket* webSocket) override {
+        sendCallsBefore = ConnectionTestAccess::sendCalls(*dynamic_cast<Connection*>(webSocket));
+        for (int i = 0; i < 50; ++i) {
+            webSocket->send("m" + std::to_string(i));
+        }
+        connection = webSocket;
+    }
+    void onDisconnect(WebSocket*) override {
+    }
+    bool corksWrites() const override {
+        return corks;
+    }
+};
+
+}
+
+TEST_CASE("Auto-corked writes", "[ServerTests]") {
+    TestServer running;
+    auto& server = running.server;
+    auto flushWindow = std::chrono::microseconds::zero();
+    bool corks = true;
+    SECTION("at the end of each pass") {
+    }
+    SECTION("after a flush window") {
+        flushWindow = std::chrono::microseconds(500);
+    }
+    SECTION("unless the endpoint opts out") {
+        corks = false;
+    }
+    server.setAutoCork(true, flushWindow);
+    auto handler = std::make_shared<BurstHandler>(corks);
+    server.addWebSocketHandler("/burst", handler);
+    REQUIRE(running.start());
+    auto port = running.port;
+
+    int fd = openWebSocket(port, "/burst");
+    REQUIRE(fd != -1);
+    uint8_t firstByte = 0;
+    bool inOrder = true;
+    for (int i = 0; i < 50; ++i) {
+        inOrder = inOrder && readFrame(fd, firstByte) == "m" + std::to_string(i);
+    }
+    CHECK(inOrder);
+    std::promise<size_t> burstCalls;
+    server.execute([&] {
+        auto connection = dynamic_cast<Connection*>(handler->connection.load());
+        burstCalls.set_value(ConnectionTestAccess::sendCalls(*connection) - handler->sendCallsBefore);
+    });
+    if (corks) {
+        // All in one call, at the end of the pass.
+        CHECK(burstCalls.get_future().get() == 1);
+    } else {
+        CHECK(burstCalls.get_future().get() == 50);
+    }
+
+    // From an executed task, with enough between the small messages to be sent early.
+    const std::string big(Server::AutoCorkFlushBytes * 3, 'x');
+    server.execute([&] {
+        auto connection = handler->connection.load();
+        connection->send("before");
+        connection->send(big);
+        connection->send("after");
+    });
+    CHECK(readFrame(fd, firstByte) == "before");
+    CHECK(readFrame(fd, firstByte) == big);
+    CHECK(readFrame(fd, firstByte) == "after");
+
+    ::close(fd);
+    CHECK(running.stop());
+}
+
+namespace {
+
+struct ZeroCopyHandler : WebSocket::Handler {
+    const std::string big = std::string(1024 * 1024, 'z');
+    Server* server = nullptr;
+    std::atomic<WebSocket*> connection{nullptr};
+
+    void onConnect(WebSocket* webSocket) override {
+        // Published frames are sent from buffers of their own, so may go zero-copy.
+        server->subscribe(webSocket, "zero");
+        connection = webSocket;
+    }
+    void onDisconnect(WebSocket*) override {
+    }
+};
+
+}
+
+TEST_CASE("Zero-copy sends", "[ServerTests]") {
+    TestServer running;
+    auto& server = running.server;
+    server.setZeroCopyThreshold(64 * 1024);
+    auto handler = std::make_shared<ZeroCopyHandler>();
+    handler->server = &server;
+    server.addWebSocketHandler("/zero", handler);
+    REQUIRE(running.start());
+    auto port = running.port;
+
+    int fd = openWebSocket(port, "/zero");
+    REQUIRE(fd != -1);
+    server.execute([&] {
+        handler->connection.load()->send("small");
+        for (int i = 0; i < 4; ++i) {
+            server.publish("zero", handler->big);
+        }
+        handler->connection.load()->send("end");
+    });
+    uint8_t firstByte = 0;
+    CHECK(readFrame(fd, firstByte) == "small");
+    for (int i = 0; i < 4; ++i) {
+        CHECK(readFrame(fd, firstByte) == handler->big);
+    }
+    CHECK(readFrame(fd, firstByte) == "end");
+
+    // The kernel reports each zero-copy send done on the socket's error queue
+    // (loopback copies them anyway, but still says so).
+    auto zeroCopyCounts = [&] {
+        std::promise<std::pair<size_t, size_t>> counts;
+        server.execute([&] {
+            auto& connection = dynamic_cast<Connection&>(*handler->connection.load());
+            counts.set_value({ConnectionTestAccess::zeroCopySends(connection),
+                              ConnectionTestAccess::zeroCopyCompletions(connection)});
+        });
+        return counts.get_future().get();
+    };
+    auto counts = zeroCopyCounts();
+    for (int i = 0; i < 1000 && counts.second < counts.first; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        counts = zeroCopyCounts();
+    }
+    CHECK(counts.first > 0);
+    CHECK(counts.second == counts.first);
+
+    // Completions arriving on the error queue don't close the connection.
+    server.execute([&] {
+        server.publish("zero", handler->big);
+        handler->connection.load()->send("again");
+    });
+    CHECK(readFrame(fd, firstByte) == handler->big);
+    CHECK(readFrame(fd, firstByte) == "again");
+
+    // What was sent before the connection closed arrives intact.
+    server.execute([&] {
+        for (int i = 0; i < 4; ++i) {
+            server.publish("zero", handler->big);
+        }
+        handler->connection.load()->close();
+    });
+    std::string received;
+    char buf[64 * 1024];
+    ssize_t numRead;
+    while ((numRead = ::read(fd, buf, sizeof(buf))) > 0) {
+        received.append(buf, numRead);
+    }
+    CHECK(!received.empty());
+    const size_t headerSize = 10;
+    for (size_t offset = 0; offset + headerSize < received.size(); offset += headerSize + handler->big.size()) {
+        auto payload = received.substr(offset + headerSize, handler->big.size());
+        CHECK(payload.find_first_not_of('z') == std::string::npos);
+    }
+
+    ::close(fd);
+    CHECK(running.stop());
+}
+
+namespace {
+
+// Reads one response, returning its headers and as much body as Content-Length says.
+std::string readResponse(int fd, std::string& body) {
+    std::string response;
+    char buf[16 * 1024];
+    size_t headerEnd;
+    while ((headerEnd = response.find("\r\n\r\n")) == std::string::npos) {
+        auto numRead = ::read(fd, buf, sizeof(buf));
+        if (numRead <= 0) {
+            return response;
+        }
+        response.append(buf, numRead);
+    }
+    auto headers = response.substr(0, headerEnd + 4);
+    body = response.substr(headerEnd + 4);
+    auto lengthPos = headers.find("Content-Length: ");
+    size_t length = lengthPos == std::string::npos ? 0 : std::stoul(headers.substr(lengthPos + 16));
+    while (body.size() < length) {
+        auto numRead = ::read(fd, buf, sizeof(buf));
+        if (numRead <= 0) {
+            break;
+        }
+        body.append(buf, numRead);
+    }
+    return headers;
+}
+
+struct FileResponse : Response {
+    std::string path;
+    explicit FileResponse(std::string p)
+            : path(std::move(p)) {
+    }
+    void handle(std::shared_ptr<ResponseWriter> writer) override {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        writer->begin(ResponseCode::Ok);
+        writer->header("Content-Length", "1000");
+        writer->payload("<", 1, false);
+        writer->payloadFile(fd, 1000, 998, false);
+        ::close(fd);
+        writer->payload(">", 1);
+        writer->finish(true);
+    }
+    void cancel() override {
+    }
+};
+
+struct FileHandler : PageHandler {
+    std::string path;
+    bool offload = false;
+    std::shared_ptr<Response> handle(const Request& request) override {
+        if (request.getRequestUri() != "/payload") {
+            return Response::unhandled();
+        }
+        return std::make_shared<FileResponse>(path);
+    }
+    bool offloaded() const override {
+        return offload;
+    }
+};
+
+}
+
+TEST_CASE("Sending files", "[ServerTests]") {
+    char dir[] = "/tmp/seasocksXXXXXX";
+    REQUIRE(::mkdtemp(dir));
+    std::string path = std::string(dir) + "/big.bin";
+    std::string contents(1024 * 1024, 0);
+    for (size_t i = 0; i < contents.size(); ++i) {
+        contents[i] = static_cast<char>('a' + i % 23);
+    }
+    {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        REQUIRE(fd != -1);
+        REQUIRE(::write(fd, contents.data(), contents.size()) == static_cast<ssize_t>(contents.size()));
+        ::close(fd);
+    }
+
+    TestServer running;
+    auto& server = running.server;
+    server.setWorkerThreads(1);
+    server.setFileThreads(GENERATE(size_t(2), size_t(0)));
+    // Files aren't held in memory, so may be far bigger than the client buffer.
+    server.setClientBufferSize(64 * 1024);
+    server.setStaticPath(dir);
+    auto handler = std::make_shared<FileHandler>();
+    handler->path = path;
+    server.addPageHandler(handler);
+    REQUIRE(running.start());
+    auto port = running.port;
+
+    int fd = connectTo(port);
+    REQUIRE(fd != -1);
+    std::string body;
+
+    SECTION("whole static files") {
+        std::string request = "GET /big.bin HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        ::send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+        auto headers = readResponse(fd, body);
+        CHECK(headers.compare(0, 12, "HTTP/1.1 200") == 0);
+        CHECK(body == contents);
+    }
+
+    SECTION("ranges of static files") {
+        std::string request = "GET /big.bin HTTP/1.1\r\nHost: localhost\r\nRange: bytes=100-199,-50\r\n\r\n";
+        ::send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+        auto headers = readResponse(fd, body);
+        CHECK(headers.compare(0, 12, "HTTP/1.1 206") == 0);
+        CHECK(body == contents.substr(100, 100) + contents.substr(contents.size() - 50));
+
+        // Whitespace is allowed after the commas.
+        request = "GET /big.bin HTTP/1.1\r\nHost: localhost\r\nRange: bytes=100-199, -50\r\n\r\n";
+        ::send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+        headers = readResponse(fd, body);
+        CHECK(headers.compare(0, 12, "HTTP/1.1 206") == 0);
+        CHECK(body == contents.substr(100, 100) + contents.substr(contents.size() - 50));
+
+        // Ends past 4GB are clamped to the file rather than rejected.
+        request = "GET /big.bin HTTP/1.1\r\nHost: localhost\r\nRange: bytes=1000-8589934592\r\n\r\n";
+        ::send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+        headers = readResponse(fd, body);
+        CHECK(headers.find("Content-Range: bytes 1000-1048575/1048576") != std::string::npos);
+        CHECK(body == contents.substr(1000));
+    }
+
+    SECTION("bad ranges of static files") {
+        // A missing file is reported as such, whatever the Range header says.
+        std::string request = "GET /missing.bin HTTP/1.1\r\nHost: localhost\r\nRange: bytes=x-y\r\n\r\n";
+        ::send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+        auto headers = readResponse(fd, body);
+        CHECK(headers.compare(0, 12, "HTTP/1.1 404") == 0);
+
+        // Errors close the connection.
+        ::close(fd);
+        fd = connectTo(port);
+        REQUIRE(fd != -1);
+        request = "GET /big.bin HTTP/1.1\r\nHost: localhost\r\nRange: bytes=x-y\r\n\r\n";
+        ::send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+        headers = readResponse(fd, body);
+        CHECK(headers.compare(0, 12, "HTTP/1.1 400") == 0);
+    }
+
+    SECTION("file payloads") {
+        handler->offload = GENERATE(false, true);
+        std::string request = "GET /payload HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        ::send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+        auto headers = readResponse(fd, body);
+        CHECK(headers.compare(0, 12, "HTTP/1.1 200") == 0);
+        CHECK(body == "<" + contents.substr(1000, 998) + ">");
+    }
+
+    ::close(fd);
+    CHECK(running.stop());
+    ::unlink(path.c_str());
+    ::rmdir(dir);
+}
+
+TEST_CASE("Static files slow to open", "[ServerTests]") {
+    char dir[] = "/tmp/seasocksXXXXXX";
+    REQUIRE(::mkdtemp(dir));
+    // Opening a FIFO waits for a writer, much like a file on a stalled disk.
+    std::string fifo = std::string(dir) + "/slow";
+    REQUIRE(::mkfifo(fifo.c_str(), 0644) == 0);
+    std::string path = std::string(dir) + "/fast.txt";
+    {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        REQUIRE(fd != -1);
+        REQUIRE(::write(fd, "fast", 4) == 4);
+        ::close(fd);
+    }
+
+    TestServer running;
+    auto& server = running.server;
+    server.setStaticPath(dir);
+    REQUIRE(running.start());
+    auto port = running.port;
+
+    int slowFd = connectTo(port);
+    REQUIRE(slowFd != -1);
+    std::string request = "GET /slow HTTP/1.1\r\nHost: localhost\r\n\r\n"
+                          "GET /fast.txt HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    ::send(slowFd, request.data(), request.size(), MSG_NOSIGNAL);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    // Other connections are answered meanwhile.
+    int fd = connectTo(port);
+    std::string body;
+    request = "GET /fast.txt HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    ::send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+    auto headers = readResponse(fd, body);
+    CHECK(headers.compare(0, 12, "HTTP/1.1 200") == 0);
+    CHECK(body == "fast");
+    ::close(fd);
+
+    // Once it opens, its connection carries on in order.
+    int writer = ::open(fifo.c_str(), O_RDWR);
+    headers = readResponse(slowFd, body);
+    CHECK(headers.compare(0, 12, "HTTP/1.1 200") == 0);
+    CHECK(body.empty());
+    headers = readResponse(slowFd, body);
+    CHECK(headers.compare(0, 12, "HTTP/1.1 200") == 0);
+    CHECK(body == "fast");
+    ::close(writer);
+    ::close(slowFd);
 
-    server.terminate();
-    seasocksThread.join();
+    CHECK(running.stop());
+    ::unlink(fifo.c_str());
+    ::unlink(path.c_str());
+    ::rmdir(dir);
 }
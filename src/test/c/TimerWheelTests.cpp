@@ -0,0 +1,160 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/TimerWheel.h"
+
+#include <catch2/catch.hpp>
+
+#include <functional>
+#include <random>
+#include <vector>
+
+using namespace seasocks;
+
+namespace {
+
+constexpr uint64_t Start = 1000000;
+
+}
+
+TEST_CASE("TimerWheel runs timers when due", "[TimerWheelTests]") {
+    TimerWheel wheel(Start);
+    CHECK(wheel.nextTick() == TimerWheel::Never);
+    CHECK(wheel.advance(Start + 100000) == 0);
+
+    std::vector<int> fired;
+    auto now = wheel.now();
+    wheel.schedule(now + 5, Task([&] { fired.push_back(5); }));
+    wheel.schedule(now, Task([&] { fired.push_back(0); }));
+    wheel.schedule(now + 70, Task([&] { fired.push_back(70); }));
+    CHECK(wheel.size() == 3);
+    CHECK(wheel.nextTick() == now);
+
+    CHECK(wheel.advance(now) == 1);
+    CHECK(wheel.advance(now + 4) == 0);
+    CHECK(fired == std::vector<int>({0}));
+    CHECK(wheel.advance(now + 69) == 1);
+    CHECK(fired == std::vector<int>({0, 5}));
+    CHECK(wheel.advance(now + 70) == 1);
+    CHECK(fired == std::vector<int>({0, 5, 70}));
+    CHECK(wheel.size() == 0);
+}
+
+TEST_CASE("TimerWheel cancels", "[TimerWheelTests]") {
+    TimerWheel wheel(Start);
+    int fired = 0;
+    auto first = wheel.schedule(Start + 10, Task([&] { fired++; }));
+    auto second = wheel.schedule(Start + 10000, Task([&] { fired++; }));
+    CHECK(first != 0);
+    CHECK(wheel.cancel(first));
+    CHECK_FALSE(wheel.cancel(first));
+    CHECK_FALSE(wheel.cancel(0));
+    // Reuses the entry, but the old identifier stays dead.
+    auto third = wheel.schedule(Start + 20, Task([&] { fired++; }));
+    CHECK(third != first);
+    CHECK_FALSE(wheel.cancel(first));
+    wheel.advance(Start + 20);
+    CHECK(fired == 1);
+    CHECK_FALSE(wheel.cancel(third));
+    CHECK(wheel.cancel(second));
+    wheel.advance(Start + 20000);
+    CHECK(fired == 1);
+}
+
+TEST_CASE("TimerWheel timers can schedule and cancel timers", "[TimerWheelTests]") {
+    TimerWheel wheel(Start);
+    int runs = 0;
+    TimerWheel::Id victim = 0;
+    std::function<void()> again = [&] {
+        if (++runs < 5) {
+            wheel.schedule(wheel.now(), Task(again));
+        }
+    };
+    wheel.schedule(Start + 1, Task([&] { CHECK(wheel.cancel(victim)); }));
+    victim = wheel.schedule(Start + 1, Task([&] { FAIL("cancelled timer ran"); }));
+    wheel.schedule(Start, Task(again));
+    // Each rescheduled for "now" waits for the next tick, rather than looping.
+    CHECK(wheel.advance(Start) == 1);
+    CHECK(runs == 1);
+    CHECK(wheel.advance(Start + 10) == 5);
+    CHECK(runs == 5);
+    CHECK(wheel.size() == 0);
+}
+
+TEST_CASE("TimerWheel handles long and very long timers", "[TimerWheelTests]") {
+    TimerWheel wheel(Start);
+    const uint64_t day = 24 * 60 * 60 * 1000;
+    bool fired = false;
+    wheel.schedule(Start + day, Task([&] { fired = true; }));
+    CHECK(wheel.nextTick() > Start);
+    CHECK(wheel.nextTick() <= Start + day);
+    wheel.advance(Start + day - 1);
+    CHECK_FALSE(fired);
+    wheel.advance(Start + day);
+    CHECK(fired);
+}
+
+TEST_CASE("TimerWheel matches a naive implementation", "[TimerWheelTests]") {
+    std::mt19937_64 random(1234);
+    TimerWheel wheel(Start);
+    struct Expected {
+        uint64_t deadline;
+        TimerWheel::Id id;
+        bool cancelled;
+        uint64_t firedAt;
+    };
+    std::vector<Expected> timers;
+    uint64_t now = Start;
+    for (int round = 0; round < 2000; ++round) {
+        for (int i = 0; i < 5; ++i) {
+            // A spread of delays exercising every level.
+            auto delay = random() % (uint64_t(1) << (4 + random() % 22));
+            auto index = timers.size();
+            timers.push_back({now + delay, 0, false, 0});
+            timers[index].id = wheel.schedule(now + delay, Task([&, index] { timers[index].firedAt = wheel.now(); }));
+        }
+        if (random() % 3 == 0) {
+            auto& victim = timers[random() % timers.size()];
+            victim.cancelled = wheel.cancel(victim.id) || victim.cancelled;
+        }
+        now += random() % 5000;
+        wheel.advance(now);
+        // Occasionally skip a long way ahead.
+        if (random() % 100 == 0) {
+            now += random() % 10000000;
+            wheel.advance(now);
+        }
+    }
+    now += 100000000;
+    wheel.advance(now);
+    CHECK(wheel.size() == 0);
+    for (auto& timer : timers) {
+        if (timer.cancelled) {
+            CHECK(timer.firedAt == 0);
+        } else {
+            CHECK(timer.firedAt == timer.deadline);
+        }
+    }
+}
@@ -0,0 +1,97 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Measures how quickly masked WebSocket payloads are unmasked, from tiny
+// messages up to a megabyte, comparing the byte at a time loop HybiPacketDecoder
+// used to have with unmask() into a new buffer and in place. Run it from a
+// release build:
+//   make benchmark
+
+#include "internal/Unmask.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace seasocks;
+
+namespace {
+
+// How payloads were unmasked before: a shift and a push_back per byte.
+void naiveUnmask(std::vector<uint8_t>& out, const uint8_t* source, size_t size, uint32_t mask) {
+    out.clear();
+    out.reserve(size);
+    for (auto i = 0u; i < size; ++i) {
+        auto byteShift = (3 - (i & 3)) * 8;
+        out.push_back(static_cast<uint8_t>((source[i] ^ (mask >> byteShift)) & 0xff));
+    }
+}
+
+template <typename Fn>
+void report(const std::string& name, size_t bytesPerRun, Fn&& fn) {
+    using namespace std::chrono;
+    size_t runs = 0;
+    size_t sink = 0;
+    auto start = steady_clock::now();
+    auto elapsed = steady_clock::duration::zero();
+    while (elapsed < milliseconds(200)) {
+        for (int i = 0; i < 64; ++i) {
+            sink += fn();
+        }
+        runs += 64;
+        elapsed = steady_clock::now() - start;
+    }
+    auto seconds = duration<double>(elapsed).count();
+    std::printf("%-40s %10.1f MB/s  (%zu)\n", name.c_str(), runs * bytesPerRun / seconds / 1e6, sink % 10);
+}
+
+}
+
+int main() {
+    const uint8_t keyBytes[4] = {0x37, 0xfa, 0x21, 0x3d};
+    uint32_t key;
+    memcpy(&key, keyBytes, sizeof(key));
+    for (size_t size : {16u, 128u, 1024u, 16u * 1024, 256u * 1024, 1024u * 1024}) {
+        std::vector<uint8_t> source(size, 0x55);
+        std::vector<uint8_t> out;
+        auto label = std::to_string(size) + "B";
+        report(label + ", byte at a time", size, [&] {
+            naiveUnmask(out, source.data(), size, key);
+            return out[size / 2];
+        });
+        report(label + ", into a new buffer", size, [&] {
+            out.resize(size);
+            unmask(out.data(), source.data(), size, key);
+            return out[size / 2];
+        });
+        report(label + ", in place", size, [&] {
+            unmask(source.data(), source.data(), size, key);
+            return source[size / 2];
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/Unmask.h"
+
+#include <catch2/catch.hpp>
+
+#include <cstring>
+#include <vector>
+
+using namespace seasocks;
+
+namespace {
+
+const uint8_t keyBytes[4] = {0x37, 0xfa, 0x21, 0x3d};
+
+uint32_t wireKey() {
+    uint32_t key;
+    memcpy(&key, keyBytes, sizeof(key));
+    return key;
+}
+
+std::vector<uint8_t> payload(size_t size) {
+    std::vector<uint8_t> result(size);
+    for (size_t i = 0; i < size; ++i) {
+        result[i] = static_cast<uint8_t>(i * 7 + 3);
+    }
+    return result;
+}
+
+std::vector<uint8_t> masked(const std::vector<uint8_t>& plain) {
+    auto result = plain;
+    for (size_t i = 0; i < result.size(); ++i) {
+        result[i] ^= keyBytes[i % 4];
+    }
+    return result;
+}
+
+}
+
+TEST_CASE("unmask matches byte at a time unmasking at every size", "[UnmaskTests]") {
+    // Covers every tail length after each of the vector and word loops.
+    for (size_t size = 0; size < 200; ++size) {
+        auto plain = payload(size);
+        auto source = masked(plain);
+        std::vector<uint8_t> dest(size);
+        unmask(dest.data(), source.data(), size, wireKey());
+        CHECK(dest == plain);
+    }
+}
+
+TEST_CASE("unmask copes with unaligned buffers", "[UnmaskTests]") {
+    auto plain = payload(1000);
+    for (size_t offset = 1; offset < 32; ++offset) {
+        std::vector<uint8_t> source(offset);
+        auto maskedPlain = masked(plain);
+        source.insert(source.end(), maskedPlain.begin(), maskedPlain.end());
+        std::vector<uint8_t> dest(plain.size() + 3);
+        unmask(dest.data() + 3, source.data() + offset, plain.size(), wireKey());
+        CHECK(std::vector<uint8_t>(dest.begin() + 3, dest.end()) == plain);
+    }
+}
+
+TEST_CASE("unmask works in place", "[UnmaskTests]") {
+    auto plain = payload(4097);
+    auto buffer = masked(plain);
+    unmask(buffer.data(), buffer.data(), buffer.size(), wireKey());
+    CHECK(buffer == plain);
+}
+
+TEST_CASE("unmask with no key copies", "[UnmaskTests]") {
+    auto plain = payload(100);
+    std::vector<uint8_t> dest(plain.size());
+    unmask(dest.data(), plain.data(), plain.size(), 0);
+    CHECK(dest == plain);
+    unmask(nullptr, plain.data(), 0, 0);
+}
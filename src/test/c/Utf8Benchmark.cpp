@@ -0,0 +1,108 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// Measures how quickly text is checked to be UTF-8, for ASCII and for text
+// with a mix of two, three and four byte characters, comparing validating
+// alone with unmasking and validating in one pass and one after the other.
+// Run it from a release build:
+//   make benchmark
+
+#include "internal/Unmask.h"
+#include "internal/Utf8.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace seasocks;
+
+namespace {
+
+template <typename Fn>
+void report(const std::string& name, size_t bytesPerRun, Fn&& fn) {
+    using namespace std::chrono;
+    size_t runs = 0;
+    size_t sink = 0;
+    auto start = steady_clock::now();
+    auto elapsed = steady_clock::duration::zero();
+    while (elapsed < milliseconds(200)) {
+        for (int i = 0; i < 64; ++i) {
+            sink += fn();
+        }
+        runs += 64;
+        elapsed = steady_clock::now() - start;
+    }
+    auto seconds = duration<double>(elapsed).count();
+    std::printf("%-40s %10.1f MB/s  (%zu)\n", name.c_str(), runs * bytesPerRun / seconds / 1e6, sink % 10);
+}
+
+std::vector<uint8_t> text(size_t size, bool ascii) {
+    // "a", "é", "€" and an emoji, in turn.
+    static const std::string pieces[] = {"a", "\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80"};
+    std::string result;
+    for (size_t i = 0; result.size() < size; ++i) {
+        result += ascii ? pieces[0] : pieces[i % 4];
+    }
+    result.resize(size);
+    while (!result.empty() && (result.back() & 0xc0) == 0x80) {
+        result.back() = 'a';
+    }
+    if (!result.empty() && static_cast<uint8_t>(result.back()) >= 0xc0) {
+        result.back() = 'a';
+    }
+    return std::vector<uint8_t>(result.begin(), result.end());
+}
+
+}
+
+int main() {
+    const uint8_t keyBytes[4] = {0x37, 0xfa, 0x21, 0x3d};
+    uint32_t key;
+    memcpy(&key, keyBytes, sizeof(key));
+    for (auto ascii : {true, false}) {
+        for (size_t size : {128u, 16u * 1024, 1024u * 1024}) {
+            auto plain = text(size, ascii);
+            auto masked = plain;
+            for (size_t i = 0; i < size; ++i) {
+                masked[i] ^= keyBytes[i % 4];
+            }
+            std::vector<uint8_t> out(size);
+            auto label = std::to_string(size) + (ascii ? "B ASCII" : "B mixed");
+            report(label + ", validate", size, [&] {
+                return isValidUtf8(plain.data(), size);
+            });
+            report(label + ", unmask then validate", size, [&] {
+                unmask(out.data(), masked.data(), size, key);
+                return isValidUtf8(out.data(), size);
+            });
+            report(label + ", unmask and validate", size, [&] {
+                Utf8Validator validator;
+                return unmaskUtf8(out.data(), masked.data(), size, key, validator) && validator.complete();
+            });
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,188 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "internal/Utf8.h"
+
+#include <catch2/catch.hpp>
+
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace seasocks;
+
+namespace {
+
+// Decodes a character at a time, straight from RFC 3629.
+bool referenceValid(const std::vector<uint8_t>& text) {
+    size_t i = 0;
+    while (i < text.size()) {
+        auto lead = text[i];
+        size_t length;
+        uint32_t codePoint;
+        if (lead < 0x80) {
+            ++i;
+            continue;
+        } else if ((lead & 0xe0) == 0xc0) {
+            length = 2;
+            codePoint = lead & 0x1f;
+        } else if ((lead & 0xf0) == 0xe0) {
+            length = 3;
+            codePoint = lead & 0x0f;
+        } else if ((lead & 0xf8) == 0xf0) {
+            length = 4;
+            codePoint = lead & 0x07;
+        } else {
+            return false;
+        }
+        if (i + length > text.size()) {
+            return false;
+        }
+        for (size_t j = 1; j < length; ++j) {
+            if ((text[i + j] & 0xc0) != 0x80) {
+                return false;
+            }
+            codePoint = (codePoint << 6) | (text[i + j] & 0x3f);
+        }
+        static const uint32_t minimum[5] = {0, 0, 0x80, 0x800, 0x10000};
+        if (codePoint < minimum[length] || codePoint > 0x10ffff || (codePoint >= 0xd800 && codePoint <= 0xdfff)) {
+            return false;
+        }
+        i += length;
+    }
+    return true;
+}
+
+std::vector<uint8_t> bytes(const std::string& text) {
+    return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+void appendCodePoint(std::vector<uint8_t>& text, uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        text.push_back(codePoint);
+    } else if (codePoint < 0x800) {
+        text.push_back(0xc0 | (codePoint >> 6));
+        text.push_back(0x80 | (codePoint & 0x3f));
+    } else if (codePoint < 0x10000) {
+        text.push_back(0xe0 | (codePoint >> 12));
+        text.push_back(0x80 | ((codePoint >> 6) & 0x3f));
+        text.push_back(0x80 | (codePoint & 0x3f));
+    } else {
+        text.push_back(0xf0 | (codePoint >> 18));
+        text.push_back(0x80 | ((codePoint >> 12) & 0x3f));
+        text.push_back(0x80 | ((codePoint >> 6) & 0x3f));
+        text.push_back(0x80 | (codePoint & 0x3f));
+    }
+}
+
+}
+
+TEST_CASE("utf8 accepts valid text", "[Utf8Tests]") {
+    CHECK(isValidUtf8(nullptr, 0));
+    for (auto text : {"hello", "caf\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80", "\xef\xbf\xbf", "\xf4\x8f\xbf\xbf",
+                      "\xed\x9f\xbf", "\xee\x80\x80"}) {
+        auto data = bytes(text);
+        CHECK(isValidUtf8(data.data(), data.size()));
+    }
+}
+
+TEST_CASE("utf8 rejects invalid text", "[Utf8Tests]") {
+    // Stray continuation, overlong forms, surrogates, beyond U+10FFFF,
+    // truncated and interrupted sequences, and bytes that never appear.
+    for (auto text : {"\x80", "\xc0\xaf", "\xc1\xbf", "\xe0\x80\xaf", "\xf0\x80\x80\xaf", "\xed\xa0\x80",
+                      "\xed\xbf\xbf", "\xf4\x90\x80\x80", "\xf5\x80\x80\x80", "\xc3", "\xe2\x82", "\xe2\x82x",
+                      "\xf0\x9f\x98", "\xfe", "\xff"}) {
+        auto data = bytes(text);
+        CHECK(!isValidUtf8(data.data(), data.size()));
+    }
+}
+
+TEST_CASE("utf8 matches a reference decoder wherever a problem is", "[Utf8Tests]") {
+    std::mt19937 random(1234);
+    const uint32_t samples[] = {'a', 0x7f, 0x80, 0x7ff, 0x800, 0xd7ff, 0xe000, 0xffff, 0x10000, 0x10ffff};
+    for (int round = 0; round < 3000; ++round) {
+        std::vector<uint8_t> text;
+        auto characters = random() % 80;
+        auto ascii = random() % 2 == 0;
+        for (size_t i = 0; i < characters; ++i) {
+            appendCodePoint(text, ascii && random() % 8 ? 'a' + random() % 26 : samples[random() % 10]);
+        }
+        if (!text.empty() && round % 3 != 0) {
+            text[random() % text.size()] = static_cast<uint8_t>(random());
+        }
+        auto expected = referenceValid(text);
+        CHECK(isValidUtf8(text.data(), text.size()) == expected);
+        // Any split into two pieces gives the same answer.
+        auto split = text.empty() ? 0 : random() % text.size();
+        Utf8Validator validator;
+        validator.feed(text.data(), split);
+        validator.feed(text.data() + split, text.size() - split);
+        CHECK(validator.complete() == expected);
+    }
+}
+
+TEST_CASE("utf8 checks long runs, whatever their alignment", "[Utf8Tests]") {
+    std::vector<uint8_t> text;
+    for (int i = 0; i < 1000; ++i) {
+        appendCodePoint(text, i % 5 == 0 ? 0x1f600 : 'a' + i % 26);
+    }
+    for (size_t offset = 0; offset < 40; ++offset) {
+        std::vector<uint8_t> shifted(offset, 'x');
+        shifted.insert(shifted.end(), text.begin(), text.end());
+        CHECK(isValidUtf8(shifted.data(), shifted.size()));
+        shifted[shifted.size() - 2 - offset * 3] = 0xc0;
+        CHECK(!isValidUtf8(shifted.data(), shifted.size()));
+    }
+}
+
+TEST_CASE("utf8 unmasks and validates together", "[Utf8Tests]") {
+    const uint8_t keyBytes[4] = {0x37, 0xfa, 0x21, 0x3d};
+    uint32_t key;
+    memcpy(&key, keyBytes, sizeof(key));
+    std::vector<uint8_t> plain;
+    for (int i = 0; i < 20000; ++i) {
+        appendCodePoint(plain, i % 3 ? 'q' : 0xe9);
+    }
+    auto masked = plain;
+    for (size_t i = 0; i < masked.size(); ++i) {
+        masked[i] ^= keyBytes[i % 4];
+    }
+    Utf8Validator validator;
+    CHECK(unmaskUtf8(masked.data(), masked.data(), masked.size(), key, validator));
+    CHECK(validator.complete());
+    CHECK(masked == plain);
+}
+
+TEST_CASE("utf8 validators start afresh when reset", "[Utf8Tests]") {
+    // Stopping after a lead byte that narrows the next byte's range...
+    const uint8_t narrowing[] = {0xe0};
+    const uint8_t text[] = {0xc3, 0x80};
+    Utf8Validator validator;
+    validator.feed(narrowing, sizeof(narrowing));
+    validator.reset();
+    // ...mustn't narrow it for the next character.
+    CHECK(validator.feed(text, sizeof(text)));
+    CHECK(validator.complete());
+}
@@ -0,0 +1,93 @@
+// Copyright (c) 2013-2017, Matt Godbolt
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "internal/WorkerPool.h"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace seasocks;
+
+TEST_CASE("WorkerPool runs everything submitted", "[WorkerPoolTests]") {
+    std::atomic<int> ran(0);
+    {
+        WorkerPool pool(3);
+        CHECK(pool.size() == 3);
+        for (int i = 0; i < 1000; ++i) {
+            pool.submit(Task([&ran] { ran++; }));
+        }
+        // Stopping runs whatever's still queued.
+    }
+    CHECK(ran == 1000);
+}
+
+TEST_CASE("WorkerPool steals from busy workers", "[WorkerPoolTests]") {
+    WorkerPool pool(2);
+    std::atomic<bool> release(false);
+    std::atomic<int> ran(0);
+    // Submissions alternate between the workers: the first blocks one of them,
+    // so the other must take the tasks queued behind it.
+    pool.submit(Task([&release] {
+        while (!release) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }));
+    for (int i = 0; i < 10; ++i) {
+        pool.submit(Task([&ran] { ran++; }));
+    }
+    for (int i = 0; i < 5000 && ran != 10; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(ran == 10);
+    release = true;
+}
+
+TEST_CASE("WorkerPool runs tasks inline once stopped", "[WorkerPoolTests]") {
+    WorkerPool pool(1);
+    pool.stop();
+    auto caller = std::this_thread::get_id();
+    std::thread::id ranOn;
+    pool.submit(Task([&ranOn] { ranOn = std::this_thread::get_id(); }));
+    CHECK(ranOn == caller);
+}
+
+TEST_CASE("WorkerPool runs tasks submitted while it stops", "[WorkerPoolTests]") {
+    for (int round = 0; round < 100; ++round) {
+        std::atomic<int> ran(0);
+        int submitted = 0;
+        WorkerPool pool(2);
+        std::thread submitter([&] {
+            for (; submitted < 2000; ++submitted) {
+                pool.submit(Task([&ran] { ran++; }));
+            }
+        });
+        pool.stop();
+        submitter.join();
+        REQUIRE(ran == submitted);
+    }
+}